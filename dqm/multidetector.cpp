@@ -0,0 +1,345 @@
+#include "DQMProcess.h"
+#include "DQMEngine.h"
+#include "TimeDifference.h"
+#include "GastofCanvas.h"
+#include "QuarticCanvas.h"
+#include "PPSCanvas.h"
+
+#include "TH1.h"
+#include "TH2.h"
+
+#include <fstream>
+#include <cstdlib>
+
+#include "RVersion.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+#include "TROOT.h"
+#endif
+
+using namespace std;
+
+DQM::DQMEngine gEngine;
+DQM::SamplingController gSampling;
+
+/**
+ * \brief Per-channel occupancy, time over threshold and multiplicity of one detector's boards
+ */
+class ChannelsModule : public DQM::DetectorModule
+{
+  public:
+    ChannelsModule(const char* det_type) : DQM::DetectorModule(det_type), fNumTriggers(0) {;}
+
+    void BeginBurst(const DQM::BurstContext&) {
+      fStats = DQM::BoardStatistics();
+      fNumTriggers = 0;
+    }
+    void ProcessTrigger(const DQM::BurstContext&, const DQM::TriggerHits& trigger) {
+      unsigned int num_hits[ACC_NUM_CHANNELS];
+      double sum_tot[ACC_NUM_CHANNELS], sum_tot2[ACC_NUM_CHANNELS];
+      for (unsigned int i=0; i<ACC_NUM_CHANNELS; i++) { num_hits[i] = 0; sum_tot[i] = sum_tot2[i] = 0.; }
+      for (vector<DQM::Hit>::const_iterator h=trigger.hits.begin(); h!=trigger.hits.end(); h++) {
+        if (h->channel_id>=ACC_NUM_CHANNELS) continue;
+        const double tot = h->tot*25./1.e3;
+        num_hits[h->channel_id]++;
+        sum_tot[h->channel_id] += tot; sum_tot2[h->channel_id] += tot*tot;
+      }
+      for (unsigned int i=0; i<ACC_NUM_CHANNELS; i++) fStats.Fill(i, num_hits[i], sum_tot[i], sum_tot2[i]);
+      fNumTriggers++;
+    }
+    bool EndBurst(const DQM::BurstContext& burst, vector<string>* outputs) {
+      fStats.Scale(burst.weight);
+      return Draw(burst, outputs);
+    }
+
+  protected:
+    virtual bool Draw(const DQM::BurstContext& burst, vector<string>* outputs) = 0;
+    /// Date and sampling information to display on the plots
+    static TString RunInfo(const DQM::BurstContext& burst) {
+      TString info = TDatime().AsString();
+      if (burst.sampling>1) info += Form(" - sampled 1/%d", burst.sampling);
+      return info;
+    }
+
+    DQM::BoardStatistics fStats;
+    unsigned long fNumTriggers;
+};
+
+class GastofModule : public ChannelsModule
+{
+  public:
+    GastofModule() : ChannelsModule("gastof") {;}
+
+  protected:
+    bool Draw(const DQM::BurstContext& burst, vector<string>* outputs) {
+      const unsigned int run_id = burst.header.run_id, burst_id = burst.header.spill_id, address = burst.board_address;
+      DQM::GastofCanvas* canv[2];
+      canv[0] = new DQM::GastofCanvas(Form("gastof_%d_%d_%d_channels_density", run_id, burst_id, address), "Channels density");
+      canv[1] = new DQM::GastofCanvas(Form("gastof_%d_%d_%d_mean_tot", run_id, burst_id, address), "Mean ToT (ns)");
+      for (unsigned int i=0; i<ACC_NUM_CHANNELS; i++) {
+        canv[0]->FillChannel(1, i, fStats[i].MeanMultiplicity());
+        canv[1]->FillChannel(1, i, fStats[i].MeanToT());
+      }
+      for (unsigned int i=0; i<2; i++) {
+        canv[i]->SetRunInfo(address, run_id, burst_id, RunInfo(burst));
+        canv[i]->Save("png", DQM_OUTPUT_DIR);
+        outputs->push_back(canv[i]->GetName());
+        delete canv[i];
+      }
+      return true;
+    }
+};
+
+class QuarticModule : public ChannelsModule
+{
+  public:
+    QuarticModule() : ChannelsModule("quartic") {;}
+
+  protected:
+    bool Draw(const DQM::BurstContext& burst, vector<string>* outputs) {
+      const unsigned int run_id = burst.header.run_id, burst_id = burst.header.spill_id, address = burst.board_address;
+      DQM::QuarticCanvas* canv = new DQM::QuarticCanvas(Form("quartic_%d_%d_%d_channels_density", run_id, burst_id, address>>16), "Channels density");
+      for (unsigned int i=0; i<ACC_NUM_CHANNELS; i++) canv->FillChannel(i, fStats[i].num_triggers);
+      canv->SetRunInfo(address, run_id, burst_id, RunInfo(burst));
+      canv->Save("png", DQM_OUTPUT_DIR);
+      outputs->push_back(canv->GetName());
+      delete canv;
+      return true;
+    }
+};
+
+class TimingReferenceModule : public ChannelsModule
+{
+  public:
+    TimingReferenceModule() : ChannelsModule("timingref") {;}
+
+  protected:
+    bool Draw(const DQM::BurstContext& burst, vector<string>* outputs) {
+      const unsigned int run_id = burst.header.run_id, burst_id = burst.header.spill_id;
+      DQM::PPSCanvas* canv = new DQM::PPSCanvas(Form("timingref_%d_%d_%d_hits", run_id, burst_id, burst.board_address>>16), "Timing reference hits");
+      canv->SetRunInfo(run_id, RunInfo(burst));
+      TH1D* hist = new TH1D(Form("hist_%s", canv->GetName()), "", ACC_NUM_CHANNELS, -0.5, ACC_NUM_CHANNELS-0.5);
+      for (unsigned int i=0; i<ACC_NUM_CHANNELS; i++) hist->SetBinContent(i+1, fStats[i].num_hits);
+      hist->Draw();
+      hist->GetXaxis()->SetTitle("Channel");
+      hist->GetYaxis()->SetTitle("Hits");
+      canv->Save("png", DQM_OUTPUT_DIR);
+      outputs->push_back(canv->GetName());
+      delete hist;
+      delete canv;
+      return true;
+    }
+};
+
+/**
+ * \brief Correlation of the number of hits recorded by the Quartic and GasToF boards for each trigger
+ */
+class CorrelationModule : public DQM::DetectorModule
+{
+  public:
+    CorrelationModule() : DQM::DetectorModule("quartic"), fRunId(0), fBurstId(0) { AddDetectorType("gastof"); }
+
+    void BeginBurst(const DQM::BurstContext& burst) {
+      if (burst.header.run_id==fRunId and burst.header.spill_id==fBurstId) return;
+      // only the boards of the same burst may be correlated
+      fRunId = burst.header.run_id; fBurstId = burst.header.spill_id;
+      fQuartic.clear(); fGastof.clear();
+    }
+    void ProcessTrigger(const DQM::BurstContext& burst, const DQM::TriggerHits& trigger) {
+      map<uint32_t, unsigned int>& hits = (burst.detector.find("quartic")!=string::npos) ? fQuartic : fGastof;
+      hits[trigger.event_count] += trigger.hits.size();
+    }
+    bool EndBurst(const DQM::BurstContext& burst, vector<string>* outputs) {
+      if (fQuartic.size()==0 or fGastof.size()==0) return false;
+      DQM::PPSCanvas* canv = new DQM::PPSCanvas(Form("correlation_%d_%d_quartic_gastof_hits", fRunId, fBurstId), "Hits per trigger");
+      canv->SetRunInfo(fRunId, TDatime().AsString());
+      TH2D* hist = new TH2D(Form("hist_%s", canv->GetName()), "", 50, -0.5, 49.5, 50, -0.5, 49.5);
+      for (map<uint32_t, unsigned int>::const_iterator q=fQuartic.begin(); q!=fQuartic.end(); q++) {
+        map<uint32_t, unsigned int>::const_iterator g = fGastof.find(q->first);
+        if (g!=fGastof.end()) hist->Fill(q->second, g->second);
+      }
+      hist->Draw("colz");
+      hist->GetXaxis()->SetTitle("Quartic hits");
+      hist->GetYaxis()->SetTitle("GasToF hits");
+      canv->Save("png", DQM_OUTPUT_DIR);
+      outputs->push_back(canv->GetName());
+      delete hist;
+      delete canv;
+      return true;
+    }
+
+  private:
+    unsigned int fRunId, fBurstId;
+    /// Number of hits for each trigger counter
+    map<uint32_t, unsigned int> fQuartic, fGastof;
+};
+
+/**
+ * \brief Time difference distributions between pairs of channels, on any boards
+ */
+class TimingModule : public DQM::DetectorModule
+{
+  public:
+    TimingModule() : DQM::DetectorModule("quartic"), fRunId(0), fBurstId(0) {
+      AddDetectorType("timingref");
+      AddDetectorType("gastof");
+    }
+    ~TimingModule() {
+      for (vector<Pair>::iterator p=fPairs.begin(); p!=fPairs.end(); p++) delete p->dt;
+    }
+
+    /**
+     * \brief Load the channel pairs and time walk corrections from a configuration file
+     * \note Each line is either "pair <board1> <channel1> <board2> <channel2>" or
+     *  "walk <board> <channel> <offset> <coefficient>" (in ns)
+     */
+    void LoadConfiguration(const char* path) {
+      ifstream in(path);
+      if (!in.is_open()) {
+        ostringstream os; os << "Failed to open the timing configuration file \"" << path << "\"! No time difference will be computed.";
+        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 42300);
+      }
+      string line, type, b1, b2;
+      unsigned int ch1, ch2;
+      while (getline(in, line)) {
+        if (line.size()==0 or line[0]=='#') continue;
+        istringstream is(line);
+        is >> type;
+        if (type=="pair" and (is >> b1 >> ch1 >> b2 >> ch2)) AddPair(strtoul(b1.c_str(), 0, 0), ch1, strtoul(b2.c_str(), 0, 0), ch2);
+        else if (type=="walk") {
+          double offset, coefficient;
+          if (is >> b1 >> ch1 >> offset >> coefficient) fWalk[Channel(strtoul(b1.c_str(), 0, 0), ch1)] = DQM::WalkCorrection(offset, coefficient);
+        }
+        else {
+          ostringstream os; os << "Invalid line in the timing configuration file: \"" << line << "\"";
+          throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 42301);
+        }
+      }
+      cout << "Computing the time differences for " << fPairs.size() << " channel pair(s)" << endl;
+    }
+    void AddPair(uint32_t board1, unsigned int channel1, uint32_t board2, unsigned int channel2) {
+      Pair p;
+      p.ch1 = Channel(board1, channel1); p.ch2 = Channel(board2, channel2);
+      p.dt = new DQM::TimeDifference;
+      fPairs.push_back(p);
+      fChannels.insert(p.ch1); fChannels.insert(p.ch2);
+    }
+
+    void BeginBurst(const DQM::BurstContext& burst) {
+      if (burst.header.run_id!=fRunId) {
+        for (vector<Pair>::iterator p=fPairs.begin(); p!=fPairs.end(); p++) p->dt->Reset();
+      }
+      if (burst.header.run_id!=fRunId or burst.header.spill_id!=fBurstId) {
+        // only the boards of the same burst may be paired
+        fRunId = burst.header.run_id; fBurstId = burst.header.spill_id;
+        fTimes.clear(); fBoards.clear();
+      }
+    }
+    void ProcessTrigger(const DQM::BurstContext& burst, const DQM::TriggerHits& trigger) {
+      for (vector<DQM::Hit>::const_iterator h=trigger.hits.begin(); h!=trigger.hits.end(); h++) {
+        const Channel ch(burst.board_address, h->channel_id);
+        if (fChannels.count(ch)==0) continue;
+        fTimes[ch][trigger.event_count].Add(h->leading_time, h->tot, fWalk[ch]);
+      }
+    }
+    bool EndBurst(const DQM::BurstContext& burst, vector<string>* outputs) {
+      fBoards.insert(burst.board_address);
+      bool filled = false;
+      for (vector<Pair>::iterator p=fPairs.begin(); p!=fPairs.end(); p++) {
+        // each pair is computed once both its boards are decoded
+        if (p->ch1.first!=burst.board_address and p->ch2.first!=burst.board_address) continue;
+        if (fBoards.count(p->ch1.first)==0 or fBoards.count(p->ch2.first)==0) continue;
+        const TriggerTimes& t1 = fTimes[p->ch1], t2 = fTimes[p->ch2];
+        for (TriggerTimes::const_iterator it1=t1.begin(); it1!=t1.end(); it1++) {
+          TriggerTimes::const_iterator it2 = t2.find(it1->first);
+          if (it2!=t2.end()) p->dt->Fill(it1->second, it2->second);
+        }
+        Draw(*p, outputs);
+        filled = true;
+      }
+      return filled;
+    }
+
+  private:
+    typedef pair<uint32_t, unsigned int> Channel;
+    /// Hits times of one channel for each trigger counter
+    typedef map<uint32_t, DQM::ChannelTimes> TriggerTimes;
+    struct Pair {
+      Channel ch1, ch2;
+      DQM::TimeDifference* dt;
+    };
+    void Draw(const Pair& p, vector<string>* outputs) {
+      const DQM::Histogram1D& h = p.dt->GetHistogram();
+      DQM::PPSCanvas* canv = new DQM::PPSCanvas(Form("timing_%d_dt_%d_%d_%d_%d", fRunId, p.ch1.first>>16, p.ch1.second, p.ch2.first>>16, p.ch2.second),
+                                                Form("#mu = %.3f ns, #sigma = %.3f ns", p.dt->GetMean(), p.dt->GetSigma()));
+      canv->SetRunInfo(fRunId, TDatime().AsString());
+      TH1D* hist = new TH1D(Form("hist_%s", canv->GetName()), "", h.GetNumBins(), h.GetMin(), h.GetMax());
+      for (unsigned int i=1; i<=h.GetNumBins(); i++) hist->SetBinContent(i, h.GetBinContent(i));
+      hist->Draw();
+      hist->GetXaxis()->SetTitle(Form("t(0x%x ch.%d) - t(0x%x ch.%d) (ns)", p.ch2.first>>16, p.ch2.second, p.ch1.first>>16, p.ch1.second));
+      hist->GetYaxis()->SetTitle("Hits pairs");
+      canv->Save("png", DQM_OUTPUT_DIR);
+      outputs->push_back(canv->GetName());
+      delete hist;
+      delete canv;
+    }
+
+    unsigned int fRunId, fBurstId;
+    vector<Pair> fPairs;
+    set<Channel> fChannels;
+    map<Channel, DQM::WalkCorrection> fWalk;
+    map<Channel, TriggerTimes> fTimes;
+    /// Boards already decoded for the current burst
+    set<uint32_t> fBoards;
+};
+
+bool
+MultiDetectorDQM(unsigned int address, string filename, vector<string>* outputs)
+{
+  return gEngine.Process(address, filename, outputs, gSampling.GetFactor());
+}
+
+int
+main(int argc, char* argv[])
+{
+  GastofModule gastof;
+  QuarticModule quartic;
+  TimingReferenceModule timingref;
+  CorrelationModule correlation;
+  TimingModule timing;
+  const char* path = getenv("PPS_PATH");
+  try { timing.LoadConfiguration((string(path ? path : ".")+"/config/timing_pairs.txt").c_str()); } catch (Exception& e) { e.Dump(); }
+  gEngine.Register(&gastof);
+  gEngine.Register(&quartic);
+  gEngine.Register(&timingref);
+  gEngine.Register(&correlation);
+  gEngine.Register(&timing);
+
+  if (argc==1) {
+    // all boards of the run are processed in this single client
+    DQM::DQMProcess dqm(1987, 1);
+    dqm.SetSamplingController(&gSampling);
+    dqm.Run(MultiDetectorDQM);
+  }
+  else if (string(argv[1])=="--parallel") {
+    // the files are decoded concurrently, the modules are called one at a time
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+    ROOT::EnableThreadSafety();
+    const unsigned int num_workers = (argc>2) ? atoi(argv[2]) : DQM_NUM_WORKERS;
+#else
+    const unsigned int num_workers = 1;
+#endif
+    DQM::DQMProcess dqm(1987, 1);
+    dqm.SetSamplingController(&gSampling);
+    dqm.RunParallel(MultiDetectorDQM, DQM::DQMProcess::NewPlot, num_workers);
+  }
+  else {
+    if (argc<3) {
+      cerr << "Usage: " << argv[0] << " [--parallel [num_workers] | <file> <detector>]" << endl;
+      return -1;
+    }
+    gEngine.SetDetector(0, argv[2]);
+    vector<string> out;
+    MultiDetectorDQM(0, argv[1], &out);
+  }
+  return 0;
+}
@@ -2,8 +2,17 @@
 #include "DQMProcess.h"
 #include "QuarticCanvas.h"
 
+#include "RVersion.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+#include "TROOT.h"
+#endif
+
 using namespace std;
 
+DQM::RunAccumulator gAccumulator("quartic", DQM_OUTPUT_DIR);
+DQM::RenderScheduler gRenderer(DQM_OUTPUT_DIR);
+DQM::SamplingController gSampling;
+
 bool
 QuarticDQM(unsigned int address, string filename, vector<string>* outputs)
 {
@@ -11,6 +20,9 @@ QuarticDQM(unsigned int address, string filename, vector<string>* outputs)
   try { reader.Open(filename); } catch (Exception& e) { throw e; }
   if (!reader.IsOpen()) throw Exception(__PRETTY_FUNCTION__, "Failed to build FileReader", JustWarning);
   cout << "Run/Burst Id = " << reader.GetRunId() << " / " << reader.GetBurstId() << endl;
+  // under high load, only a fraction of the triggers is decoded
+  reader.SetSampling(gSampling.GetFactor());
+  double weight = 1.;
 
   const unsigned int num_channels = 32;
   double mean_num_events[num_channels], mean_tot[num_channels];
@@ -24,11 +36,11 @@ QuarticDQM(unsigned int address, string filename, vector<string>* outputs)
     kNumPlots
   };
   const unsigned short num_plots = kNumPlots;
-  DQM::QuarticCanvas* canv[num_plots];
-  canv[kDensity] = new DQM::QuarticCanvas(Form("quartic_%d_%d_%d_channels_density", reader.GetRunId(), reader.GetBurstId(), address>>16), "Channels density");
-  //canv[kMeanToT] = new DQM::QuarticCanvas(Form("quartic_%d_%d_%d_mean_tot", reader.GetRunId(), reader.GetBurstId(), address), "Mean ToT (ns)");
-  //canv[kTriggerTimeDiff] = new DQM::QuarticCanvas(Form("quartic_%d_%d_%d_trigger_time_difference", reader.GetRunId(), reader.GetBurstId(), address), "Time btw. each trigger (ns)");
+  DQM::Histogram1D burst_plots[num_plots];
+  for (unsigned int i=0; i<num_plots; i++) burst_plots[i] = DQM::Histogram1D(num_channels, 0., num_channels);
 
+  DQM::BoardStatistics burst_stats;
+  DQM::Histogram2D burst_tot(num_channels, 0., num_channels, DQM_TOT_NUM_BINS, 0., DQM_TOT_MAX);
   VME::TDCMeasurement m;
   for (unsigned int i=0; i<num_channels; i++) {
     mean_num_events[i] = mean_tot[i] = 0.;
@@ -44,13 +56,16 @@ QuarticDQM(unsigned int address, string filename, vector<string>* outputs)
         }
         mean_num_events[i] += m.NumEvents();
         if (m.NumEvents()!=0) num_events[i] += 1;
+        burst_stats.Fill(i, m);
+        for (unsigned int j=0; j<m.NumEvents(); j++) burst_tot.FillChannel(i, m.GetToT(j)*25./1.e3);
       }
+      weight = reader.GetSamplingWeight();
       if (num_events[i]>0) {
         mean_num_events[i] /= num_events[i];
         mean_tot[i] /= num_events[i];
       }
-      canv[kDensity]->FillChannel(i, num_events[i]);
-      //canv[kMeanToT]->FillChannel(i, mean_tot[i]);
+      burst_plots[kDensity].FillBin(i, num_events[i]*weight);
+      //burst_plots[kMeanToT].FillBin(i, mean_tot[i]);
       cout << dec;
       cout << "Finished extracting channel " << i << ": " << num_events[i] << " measurements, "
            << "mean number of hits: " << mean_num_events[i] << ", "
@@ -61,21 +76,154 @@ QuarticDQM(unsigned int address, string filename, vector<string>* outputs)
       if (e.ErrorNumber()<41000) throw e;
     }
   }
+  // one persistent set of burst and run-level maps per board, rendered by the scheduler
+  // (created once, whatever the number of workers processing this board's files)
+  static map<unsigned int, vector<DQM::QuarticCanvas*> > burst_canv, run_canv;
+  static pthread_mutex_t canv_mutex = PTHREAD_MUTEX_INITIALIZER;
+  const char* burst_names[num_plots] = { "channels_density" }, *burst_titles[num_plots] = { "Channels density" };
+  pthread_mutex_lock(&canv_mutex);
+  vector<DQM::QuarticCanvas*>& bc = burst_canv[address];
+  if (bc.size()==0) {
+    for (unsigned int i=0; i<num_plots; i++) {
+      bc.push_back(new DQM::QuarticCanvas(Form("quartic_%d_%d_%d_%s", reader.GetRunId(), reader.GetBurstId(), address>>16, burst_names[i]), burst_titles[i]));
+      gRenderer.Register(bc[i]);
+    }
+  }
+  vector<DQM::QuarticCanvas*>& rc = run_canv[address];
+  if (rc.size()==0) {
+    rc.push_back(new DQM::QuarticCanvas(Form("quartic_%d_%d_run_occupancy", reader.GetRunId(), address>>16), "Hits (run)"));
+    rc.push_back(new DQM::QuarticCanvas(Form("quartic_%d_%d_run_mean_tot", reader.GetRunId(), address>>16), "Mean ToT (ns, run)"));
+    rc.push_back(new DQM::QuarticCanvas(Form("quartic_%d_%d_run_mean_multiplicity", reader.GetRunId(), address>>16), "Mean hits per trigger (run)"));
+    for (unsigned int i=0; i<rc.size(); i++) gRenderer.Register(rc[i]);
+  }
+  pthread_mutex_unlock(&canv_mutex);
+
+  TString info = TDatime().AsString();
+  if (reader.GetSampling()>1) info += Form(" - sampled 1/%d", reader.GetSampling());
   for (unsigned int i=0; i<num_plots; i++) {
-    canv[i]->SetRunInfo(address, reader.GetRunId(), reader.GetBurstId(), TDatime().AsString());
-    canv[i]->Save("png", DQM_OUTPUT_DIR);
-    outputs->push_back(canv[i]->GetName());
+    DQM::RenderLock lock(bc[i]);
+    gRenderer.Flush(bc[i]); // the previous burst's map is output before being replaced
+    bc[i]->SetName(Form("quartic_%d_%d_%d_%s", reader.GetRunId(), reader.GetBurstId(), address>>16, burst_names[i]));
+    bc[i]->FillChannels(burst_plots[i]);
+    bc[i]->SetRunInfo(address, reader.GetRunId(), reader.GetBurstId(), info);
+  }
+
+  // run-integrated view, only updated with this burst's content
+  burst_stats.Scale(weight);
+  if (!gAccumulator.Add(reader.GetRunId(), address, reader.GetBurstId(), burst_stats)) { gRenderer.Poll(); return true; } // burst of a previous run, or already merged
+  {
+    // per-channel ToT distributions of the run, merged by each worker into its own shard
+    static map<unsigned int, pair<unsigned int, DQM::ShardedHistogram<DQM::Histogram2D>*> > run_tot;
+    pthread_mutex_lock(&canv_mutex);
+    pair<unsigned int, DQM::ShardedHistogram<DQM::Histogram2D>*>& rt = run_tot[address];
+    if (!rt.second) rt = make_pair(reader.GetRunId(), new DQM::ShardedHistogram<DQM::Histogram2D>(burst_tot));
+    else if (rt.first!=reader.GetRunId()) { rt.second->Reset(); rt.first = reader.GetRunId(); }
+    DQM::ShardedHistogram<DQM::Histogram2D>* tot_dist = rt.second;
+    pthread_mutex_unlock(&canv_mutex);
+    tot_dist->Local().Add(burst_tot);
+    try { tot_dist->SaveSnapshot(Form("%squartic_%d_%d_run_tot.hist", DQM_OUTPUT_DIR, reader.GetRunId(), address>>16)); } catch (Exception& e) { e.Dump(); }
   }
+  unsigned int num_bursts = 0;
+  const DQM::BoardStatistics run_stats = gAccumulator.GetStatistics(address, &num_bursts);
+  DQM::Histogram1D occupancy(num_channels, 0., num_channels), tot(num_channels, 0., num_channels), multiplicity(num_channels, 0., num_channels);
+  for (unsigned int i=0; i<num_channels; i++) {
+    occupancy.FillBin(i, run_stats[i].num_hits);
+    tot.FillBin(i, run_stats[i].MeanToT());
+    multiplicity.FillBin(i, run_stats[i].MeanMultiplicity());
+  }
+  {
+    DQM::RenderLock l0(rc[0]), l1(rc[1]), l2(rc[2]);
+    rc[0]->SetName(Form("quartic_%d_%d_run_occupancy", reader.GetRunId(), address>>16));
+    rc[1]->SetName(Form("quartic_%d_%d_run_mean_tot", reader.GetRunId(), address>>16));
+    rc[2]->SetName(Form("quartic_%d_%d_run_mean_multiplicity", reader.GetRunId(), address>>16));
+    rc[0]->FillChannels(occupancy);
+    rc[1]->FillChannels(tot);
+    rc[2]->FillChannels(multiplicity);
+    for (unsigned int i=0; i<rc.size(); i++) rc[i]->SetRunInfo(address, reader.GetRunId(), reader.GetBurstId(), (reader.GetSampling()>1) ? Form("%d bursts - last sampled 1/%d", num_bursts, reader.GetSampling()) : Form("%d bursts", num_bursts));
+  }
+  gRenderer.Poll();
   return true;
 }
 
+bool
+QuarticLiveDQM(unsigned int address, const file_header_t& header, const VME::TDCEventCollection& events, vector<string>* outputs)
+{
+  // one occupancy map per board, reset at each new burst and rendered by the scheduler
+  static map<unsigned int, DQM::QuarticCanvas*> canv;
+  static map<unsigned int, unsigned int> num_triggers;
+  static map<unsigned int, DQM::Histogram1D> hits;
+  map<unsigned int, DQM::QuarticCanvas*>::iterator it = canv.find(address);
+  const TString name = Form("quartic_%d_%d_%d_live_occupancy", header.run_id, header.spill_id, address>>16);
+  if (it==canv.end()) {
+    it = canv.insert(pair<unsigned int, DQM::QuarticCanvas*>(address, new DQM::QuarticCanvas(name, "Hits (burst in progress)"))).first;
+    gRenderer.Register(it->second);
+  }
+  if (name!=it->second->GetName() or hits.count(address)==0) {
+    DQM::RenderLock lock(it->second);
+    gRenderer.Flush(it->second); // last state of the previous burst
+    it->second->SetName(name);
+    num_triggers[address] = 0;
+    hits[address] = DQM::Histogram1D(32, 0., 32.);
+  }
+  DQM::Histogram1D& board_hits = hits[address];
+  for (VME::TDCEventCollection::const_iterator e=events.begin(); e!=events.end(); e++) {
+    if (e->GetType()==VME::TDCEvent::GlobalHeader) num_triggers[address]++;
+    else if (e->GetType()==VME::TDCEvent::TDCMeasurement and !e->IsTrailing()) board_hits.FillBin(e->GetChannelId());
+  }
+  {
+    DQM::RenderLock lock(it->second);
+    it->second->FillChannels(board_hits);
+    it->second->SetRunInfo(address, header.run_id, header.spill_id, Form("%d triggers so far", num_triggers[address]));
+  }
+  gRenderer.Poll();
+  return false; // outputs are published by the render scheduler
+}
+
+/// Allow the ROOT objects to be handled from several threads
+bool
+EnableThreadSafety()
+{
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+  ROOT::EnableThreadSafety();
+  return true;
+#else
+  return false;
+#endif
+}
+
 int
 main(int argc, char* argv[])
 {
+  const bool thread_safe = EnableThreadSafety();
   if (argc==1) {
     DQM::DQMProcess dqm(1987, 2, "quartic");
+    dqm.SetAccumulator(&gAccumulator);
+    dqm.SetRenderScheduler(&gRenderer, thread_safe);
+    dqm.SetSamplingController(&gSampling);
     dqm.Run(QuarticDQM);
   }
+  else if (string(argv[1])=="--live") {
+    DQM::DQMProcess dqm(1987, 2, "quartic");
+    dqm.SetRenderScheduler(&gRenderer, thread_safe);
+    dqm.RunLive(QuarticLiveDQM);
+  }
+  else if (string(argv[1])=="--parallel") {
+    unsigned int num_workers = (argc>2) ? atoi(argv[2]) : DQM_NUM_WORKERS;
+    if (!thread_safe) {
+      cout << "ROOT version does not allow concurrent plotting, using one single worker" << endl;
+      num_workers = 1;
+    }
+    DQM::DQMProcess dqm(1987, 2, "quartic");
+    dqm.SetAccumulator(&gAccumulator);
+    dqm.SetRenderScheduler(&gRenderer, thread_safe);
+    dqm.SetSamplingController(&gSampling);
+    dqm.RunParallel(QuarticDQM, DQM::DQMProcess::NewPlot, num_workers);
+  }
+  else if (string(argv[1])=="--tap") {
+    DQM::DQMProcess dqm(1987, 2, "quartic");
+    dqm.SetRenderScheduler(&gRenderer, thread_safe);
+    dqm.RunTap(QuarticLiveDQM);
+  }
   else {
     vector<string> out;
     QuarticDQM(0, argv[1], &out);
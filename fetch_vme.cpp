@@ -1,5 +1,7 @@
 #include "VMEReader.h"
 #include "FileConstants.h"
+#include "SharedMemoryTap.h"
+#include "BurstSummary.h"
 
 #include <iostream>
 #include <fstream>
@@ -42,6 +44,8 @@ int main(int argc, char *argv[]) {
   unsigned int num_events[num_tdc];  
 
   VME::TDCEventCollection ec;
+  SharedMemoryTap tap;
+  vector<BurstSummary> summaries;
 
   VME::AcquisitionMode acq_mode = VME::TRIG_MATCH;
   VME::DetectionMode det_mode = VME::TRAILEAD;
@@ -106,6 +110,7 @@ int main(int argc, char *argv[]) {
       exit(0);
     }
     fstream out_file[num_tdc];
+    summaries.resize(num_tdc);
     string acqmode[num_tdc], detmode[num_tdc];
     int num_triggers_in_files;
 
@@ -137,6 +142,12 @@ int main(int argc, char *argv[]) {
     cerr << endl 
          << "Local time: " << asctime(localtime(&t_beg));
     
+    // Publish the data words to the live DQM consumers
+    try { tap.Create(num_tdc); } catch (Exception& e) {
+      if (vme->UseSocket()) vme->Send(e);
+      e.Dump();
+    }
+
     if (use_fpga) {
       fpga->StartScaler();
     }
@@ -172,7 +183,11 @@ int main(int argc, char *argv[]) {
           throw Exception(__PRETTY_FUNCTION__, "Error opening file", Fatal);
         }
         out_file[i].write((char*)&fh, sizeof(file_header_t));
-        
+        // let the live DQM follow this file while it is being written
+        out_file[i].flush();
+        vme->SendLiveOutputFile(atdc->first);
+        tap.SetStream(i, atdc->first, fh);
+        summaries[i].Reset(fh, atdc->first, time(0));
       }
       
       // Pulse to set a common starting time for both TDC boards
@@ -191,6 +206,8 @@ int main(int argc, char *argv[]) {
               if (out_file[i].is_open()) {
                 word = VME::TDCEvent(VME::TDCEvent::Trigger).GetWord();
                 out_file[i].write((char*)&word, sizeof(uint32_t));
+                tap.Write(i, word);
+                summaries[i].Add(VME::TDCEvent(word));
               }
             }
             num_triggers = nt;
@@ -211,6 +228,8 @@ int main(int argc, char *argv[]) {
             //e->Dump();
             //if (e->GetType()==VME::TDCEvent::TDCMeasurement) cout << "----> (board " << dec << i << " with address " << hex << atdc->first << dec << ") new event on channel " << e->GetChannelId() << endl;
           }
+          tap.Write(i, ec);
+          summaries[i].Add(ec);
           num_events[i] += ec.size();
         }
         if (use_fpga and tm>5000) { // probe the scaler value every N data readouts
@@ -219,6 +238,10 @@ int main(int argc, char *argv[]) {
             vme->BroadcastHVStatus(0, hv->ReadChannelValues(0));
             vme->BroadcastHVStatus(3, hv->ReadChannelValues(3));
           } catch (Exception& e) {;}
+          // make the words written so far visible to the live DQM
+          for (unsigned int i=0; i<tdcs.size(); i++) {
+            if (out_file[i].is_open()) out_file[i].flush();
+          }
           num_triggers_in_files = num_triggers-num_all_triggers;
             cerr << "--> " << num_triggers << " triggers acquired in this run so far" << endl;
           if (num_triggers_in_files>0 and num_triggers_in_files>=NUM_TRIG_BEFORE_FILE_CHANGE) {
@@ -233,10 +256,14 @@ int main(int argc, char *argv[]) {
       unsigned int i = 0;
       for (VME::TDCCollection::const_iterator atdc=tdcs.begin(); atdc!=tdcs.end(); atdc++, i++) {
         if (out_file[i].is_open()) out_file[i].close();
+        summaries[i].SetEndTime(time(0));
+        try { summaries[i].Write(vme->GetOutputFile(atdc->first)); } catch (Exception& e) {
+          if (vme->UseSocket()) vme->Send(e);
+        }
         cout << "Sent output from TDC 0x" << hex << atdc->first << dec << " in spill id " << fh.spill_id << endl;
-        vme->SendOutputFile(atdc->first); usleep(1000);
+        vme->SendOutputFile(atdc->first);
       }
-      vme->BroadcastNewBurst(fh.spill_id); usleep(1000);
+      vme->BroadcastNewBurst(fh.spill_id);
       vme->BroadcastTriggerRate(fh.spill_id, num_triggers);
     }
   } catch (Exception& e) {
@@ -247,7 +274,11 @@ int main(int argc, char *argv[]) {
         VME::TDCCollection tdcs = vme->GetTDCCollection();
         for (VME::TDCCollection::const_iterator atdc=tdcs.begin(); atdc!=tdcs.end(); atdc++, i++) {
           if (out_file[i].is_open()) out_file[i].close();
-          vme->SendOutputFile(atdc->first); usleep(1000);
+          if (i<summaries.size()) {
+            summaries[i].SetEndTime(time(0));
+            try { summaries[i].Write(vme->GetOutputFile(atdc->first)); } catch (Exception& e) { e.Dump(); }
+          }
+          vme->SendOutputFile(atdc->first);
         }
   
         time_t t_end = time(0);
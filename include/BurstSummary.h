@@ -0,0 +1,113 @@
+#ifndef BurstSummary_h
+#define BurstSummary_h
+
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <fstream>
+
+#include "FileConstants.h"
+#include "Exception.h"
+#include "VME_TDCEvent.h"
+
+/// Extension of the summary files written next to the output files
+#define SUMMARY_EXTENSION ".summary"
+
+/**
+ * Builds the summary of one output file from the words written to it, either
+ * on the fly by the acquisition, or during a first reading of the file.
+ * \brief Per-burst summary handler
+ * \date 19 Oct 2026
+ */
+class BurstSummary
+{
+  public:
+    inline BurstSummary() { Reset(); }
+
+    /// Start a new summary for a given file
+    inline void Reset(const file_header_t& header, uint32_t board_address, time_t start=0) {
+      Reset();
+      fSummary.run_id = header.run_id;
+      fSummary.spill_id = header.spill_id;
+      fSummary.board_address = board_address;
+      fSummary.acq_mode = header.acq_mode;
+      fSummary.time_start = fSummary.time_end = start;
+    }
+    inline void Add(const VME::TDCEvent& ev) {
+      const unsigned int type = ev.GetType();
+      fSummary.num_words++;
+      fSummary.num_words_by_type[type&0x1F]++;
+      switch (type) {
+        case VME::TDCEvent::GlobalHeader:
+          if (fSummary.acq_mode==VME::TRIG_MATCH) fSummary.num_triggers++;
+          break;
+        case VME::TDCEvent::Trigger:
+          if (fSummary.acq_mode!=VME::TRIG_MATCH) fSummary.num_triggers++;
+          break;
+        case VME::TDCEvent::TDCMeasurement: {
+          const unsigned int ch = ev.GetChannelId();
+          if (ch>=SUMMARY_NUM_CHANNELS) break;
+          if (!ev.IsTrailing()) { fSummary.num_hits[ch]++; fLeading[ch] = ev.GetTime(); fHasLeading[ch] = true; }
+          else if (fHasLeading[ch]) {
+            fSummary.sum_tot[ch] += ((ev.GetTime()-fLeading[ch])&0x7FFFF)*25./1.e3;
+            fHasLeading[ch] = false;
+          }
+        } break;
+        case VME::TDCEvent::TDCError:
+          fSummary.error_flags |= ev.GetErrorFlags().GetWord();
+          fSummary.num_errors++;
+          break;
+        case VME::TDCEvent::ETTT:
+          if (fSummary.num_words_by_type[VME::TDCEvent::ETTT]==1) fSummary.first_ettt = ev.GetETTT();
+          fSummary.last_ettt = ev.GetETTT();
+          break;
+        default: break;
+      }
+    }
+    inline void Add(const VME::TDCEventCollection& ec) {
+      for (VME::TDCEventCollection::const_iterator e=ec.begin(); e!=ec.end(); e++) Add(*e);
+    }
+    inline void SetEndTime(time_t end) { fSummary.time_end = end; }
+    inline const burst_summary_t& Get() const { return fSummary; }
+
+    /// Path of the summary file associated to an output file
+    static inline std::string SidecarPath(const std::string& data_file) { return data_file+SUMMARY_EXTENSION; }
+    /// Store the summary next to its output file
+    inline void Write(const std::string& data_file) const {
+      const std::string path = SidecarPath(data_file), tmp = path+".tmp";
+      std::ofstream out(tmp.c_str(), std::ios::binary);
+      out.write((char*)&fSummary, sizeof(burst_summary_t));
+      out.close();
+      if (out.fail() or rename(tmp.c_str(), path.c_str())!=0) {
+        std::ostringstream os; os << "Failed to write the burst summary \"" << path << "\"!";
+        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 43000);
+      }
+    }
+    /**
+     * \brief Retrieve the summary stored next to an output file
+     * \return false if no valid summary was found
+     */
+    inline bool Read(const std::string& data_file) {
+      std::ifstream in(SidecarPath(data_file).c_str(), std::ios::binary);
+      if (!in.is_open()) return false;
+      burst_summary_t summary;
+      in.read((char*)&summary, sizeof(burst_summary_t));
+      if (!in.good() or summary.magic!=SUMMARY_MAGIC) return false;
+      fSummary = summary;
+      return true;
+    }
+
+  private:
+    inline void Reset() {
+      memset(&fSummary, 0, sizeof(burst_summary_t));
+      fSummary.magic = SUMMARY_MAGIC;
+      for (unsigned int i=0; i<SUMMARY_NUM_CHANNELS; i++) { fLeading[i] = 0; fHasLeading[i] = false; }
+    }
+
+    burst_summary_t fSummary;
+    uint32_t fLeading[SUMMARY_NUM_CHANNELS];
+    bool fHasLeading[SUMMARY_NUM_CHANNELS];
+};
+
+#endif
@@ -3,12 +3,32 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
+#include <map>
+#include <set>
 
 #include "Socket.h"
 
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+/// Time given to the master to answer a request (in seconds)
+#define CLIENT_REQUEST_TIMEOUT 10
+/// Number of attempts to reconnect to the master once the connection is lost
+#define CLIENT_RECONNECT_ATTEMPTS 30
+/// Time between two attempts to reconnect to the master (in seconds)
+#define CLIENT_RECONNECT_DELAY 2
+
 /**
  * Client object used by the server to send/receive commands from
  * the messenger/broadcaster.
+ *
+ * The client keeps track of the sequence number of the last published
+ * message (file names, run numbers) it received for each key. If the
+ * connection to the master is lost, it reconnects, restores its
+ * subscriptions, and asks the master to replay the messages it missed
+ * meanwhile, before receiving the new ones.
  * \brief Base client object for the socket
  *
  * \author Laurent Forthomme <laurent.forthomme@cern.ch>
@@ -19,7 +39,7 @@ class Client : public Socket
 {
   public:
     /// General void client constructor
-    inline Client() {;}
+    inline Client() : fClientId(-1), fIsConnected(false), fLastRequestId(0) { InitConnectionLock(); }
     /// Bind a socket client to a given port
     Client(int port);
     virtual ~Client();
@@ -30,32 +50,103 @@ class Client : public Socket
     void Disconnect();
   
     /// Send a message to the master through the socket
-    inline void Send(const Message& m) const { SendMessage(m); }
-    inline void Send(const Exception& e) const { SendMessage(SocketMessage(EXCEPTION, e.OneLine())); }
-    inline SocketMessage SendAndReceive(const SocketMessage& m, const MessageKey& a) const {
-      SocketMessage msg; int i = 0;
-      try {
-        SendMessage(m);
-        do { msg = FetchMessage(); i++; } while (msg.GetKey()!=a and i<MAX_SOCKET_ATTEMPTS);
-      } catch (Exception& e) { e.Dump(); throw e; }
-      return msg;
+    inline void Send(const Message& m) const {
+      LockConnection();
+      try { SendMessage(m); } catch (Exception& e) { UnlockConnection(); throw e; }
+      UnlockConnection();
     }
+    inline void Send(const Exception& e) const { Send(SocketMessage(EXCEPTION, e.OneLine())); }
+    /**
+     * \brief Send a request to the master and wait for its answer
+     * \param[in] m Request to send
+     * \param[in] a Key of the expected answer
+     */
+    SocketMessage SendAndReceive(const SocketMessage& m, const MessageKey& a) const;
+    /**
+     * Ask the master to deliver the messages of this key, whatever the type
+     * of this client. If attributes are given (e.g. board addresses for the
+     * file names, channels for the HV status), only the messages with one of
+     * them as the first field of their value are delivered. It may be called
+     * before connecting, for the messages replayed when connecting to be
+     * filtered as well.
+     * \brief Subscribe to a message key
+     */
+    void Subscribe(const MessageKey& key, const std::vector<std::string>& attributes=std::vector<std::string>()) const;
+    /**
+     * \brief Stop receiving the messages of this key, whatever the type of this client
+     * \note It may also be called before connecting
+     */
+    void Unsubscribe(const MessageKey& key) const;
     /// Receive a socket message from the master
     void Receive();
     SocketMessage Receive(const MessageKey& key);
+    /// Sequence number of the last published message of this key received (0 if none)
+    inline uint64_t GetLastSequence(const MessageKey& key) const {
+      std::map<MessageKey,uint64_t>::const_iterator seq = fLastSequences.find(key);
+      return (seq!=fLastSequences.end()) ? seq->second : 0;
+    }
+    /**
+     * The messages of this key published after this one are replayed by the
+     * master when connecting, e.g. to resume the processing of a previous
+     * instance of this client from its last sequence number.
+     * \brief Set the sequence number of the last message of this key received
+     * \note To be called before connecting
+     */
+    inline void SetLastSequence(const MessageKey& key, uint64_t seq) { fLastSequences[key] = seq; }
     
     /// Parse a SocketMessage received from the master
     virtual void ParseMessage(const SocketMessage& m) {;}
     /// Socket actor type retrieval method
     virtual SocketType GetType() const { return fType; }
+
+  protected:
+    /**
+     * The connection lock is held while sending, and while the connection is
+     * reopened, so that a thread never sends through a closing connection.
+     * It is recursive, and may be held by the caller around a reception.
+     * \brief Lock the connection to the master
+     */
+    inline void LockConnection() const { pthread_mutex_lock(&fConnectionMutex); }
+    inline void UnlockConnection() const { pthread_mutex_unlock(&fConnectionMutex); }
   
   private:
-    /// Announce our entry on the socket to its master
+    void InitConnectionLock();
+    /// Open the connection to the master (through the local socket if possible)
+    void Open(const ExceptionType& type);
+    /**
+     * The subscriptions of the client, and the sequence numbers of the last
+     * messages it received, are sent along with the announcement, for no
+     * message to be published to this client in between.
+     * \brief Announce our entry on the socket to its master
+     */
     void Announce();
+    /**
+     * \brief Reconnect to the master once the connection is lost, and resume the session
+     * \note The client is terminated if the master cannot be reached anymore
+     */
+    void Reconnect();
+    /// Was the connection to the master lost?
+    static bool IsDisconnection(const Exception& e);
+    /**
+     * \brief Record the reception of a message
+     * \return false if it is to be skipped (already received, or end of a replay)
+     */
+    bool Acknowledge(const SocketMessage& m);
+    /// Build the message subscribing to a key
+    static SocketMessage SubscriptionMessage(const MessageKey& key, const std::vector<std::string>& attributes);
   
     int fClientId;
     bool fIsConnected;
     SocketType fType;
+    /// Identifier of the last request sent, to match it with its answer
+    mutable uint32_t fLastRequestId;
+    /// Subscriptions to restore when reconnecting
+    mutable std::map<MessageKey, std::vector<std::string> > fSubscriptions;
+    /// Keys unsubscribed from, to restore when reconnecting
+    mutable std::set<MessageKey> fUnsubscriptions;
+    /// Sequence number of the last published message received for each key
+    std::map<MessageKey,uint64_t> fLastSequences;
+    mutable pthread_mutex_t fConnectionMutex;
 };
 
 #endif
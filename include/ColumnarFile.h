@@ -0,0 +1,244 @@
+#ifndef ColumnarFile_h
+#define ColumnarFile_h
+
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Exception.h"
+
+#define COLUMNAR_MAGIC 0x43535050 // PPSC in ASCII
+#define COLUMNAR_VERSION 1
+/// Maximal number of columns stored in a file
+#define COLUMNAR_MAX_COLUMNS 8
+#define COLUMNAR_NAME_LENGTH 16
+/// Default number of rows in each chunk
+#define COLUMNAR_CHUNK_ROWS 65536
+
+/**
+ * \brief Description of the content of a columnar file
+ */
+struct columnar_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t run_id;
+  uint32_t spill_id;
+  uint32_t board_address;
+  uint32_t acq_mode;
+  /// Duration of one time count (in ns)
+  float time_lsb;
+  uint32_t num_columns;
+  char names[COLUMNAR_MAX_COLUMNS][COLUMNAR_NAME_LENGTH];
+};
+
+/**
+ * \brief Header of one chunk, followed by the arrays of values of all columns
+ */
+struct columnar_chunk_t {
+  uint32_t magic;
+  uint32_t num_rows;
+  /// Smallest and largest values of each column in this chunk
+  uint32_t min[COLUMNAR_MAX_COLUMNS], max[COLUMNAR_MAX_COLUMNS];
+};
+
+/**
+ * \brief Index of all chunks, stored at the end of the file
+ * \note The file ends with the number of chunks and the magic number, the
+ * chunk offsets being stored right before them
+ */
+struct columnar_footer_t {
+  uint32_t num_chunks;
+  uint32_t magic;
+};
+
+/**
+ * Stores rows of unsigned 32-bit values as a sequence of chunks, each chunk
+ * holding the contiguous array of every column (structure of arrays), along
+ * with the range of values of each column. All columns being aligned on 4
+ * bytes, the files may be memory-mapped and read in place by any language.
+ * \brief Writer of chunked columnar files
+ * \date 19 Oct 2026
+ */
+class ColumnarWriter
+{
+  public:
+    inline ColumnarWriter(unsigned int chunk_rows=COLUMNAR_CHUNK_ROWS) :
+      fFile(0), fChunkRows(chunk_rows>0 ? chunk_rows : 1), fNumRows(0) {
+      memset(&fHeader, 0, sizeof(columnar_header_t));
+      fHeader.magic = COLUMNAR_MAGIC;
+      fHeader.version = COLUMNAR_VERSION;
+    }
+    inline ~ColumnarWriter() { Close(); }
+
+    /// Describe one column of the file (to be called before Open)
+    inline void AddColumn(const char* name) {
+      if (fHeader.num_columns>=COLUMNAR_MAX_COLUMNS) {
+        std::ostringstream os; os << "Too many columns requested! (maximum is " << COLUMNAR_MAX_COLUMNS << ")";
+        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 43100);
+      }
+      strncpy(fHeader.names[fHeader.num_columns], name, COLUMNAR_NAME_LENGTH-1);
+      fHeader.num_columns++;
+    }
+    inline void SetRunInfo(uint32_t run_id, uint32_t spill_id, uint32_t board_address, uint32_t acq_mode, float time_lsb) {
+      fHeader.run_id = run_id; fHeader.spill_id = spill_id;
+      fHeader.board_address = board_address; fHeader.acq_mode = acq_mode;
+      fHeader.time_lsb = time_lsb;
+    }
+
+    inline void Open(const std::string& filename) {
+      Close();
+      fFile = fopen(filename.c_str(), "wb");
+      if (!fFile) {
+        std::ostringstream os; os << "Failed to open the output file \"" << filename << "\"!";
+        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 43101);
+      }
+      fwrite(&fHeader, sizeof(columnar_header_t), 1, fFile);
+      fColumns.assign(fHeader.num_columns, std::vector<uint32_t>());
+      for (unsigned int i=0; i<fHeader.num_columns; i++) fColumns[i].reserve(fChunkRows);
+      fOffsets.clear();
+      fNumRows = 0;
+    }
+    /// Add one row (one value per column)
+    inline void Fill(const uint32_t* values) {
+      for (unsigned int i=0; i<fHeader.num_columns; i++) fColumns[i].push_back(values[i]);
+      if (fColumns[0].size()>=fChunkRows) Flush();
+    }
+    /// Write the remaining rows and the chunks index
+    inline void Close() {
+      if (!fFile) return;
+      Flush();
+      if (ftello(fFile)%sizeof(uint64_t)!=0) { const uint32_t pad = 0; fwrite(&pad, sizeof(uint32_t), 1, fFile); }
+      if (fOffsets.size()>0) fwrite(&fOffsets[0], sizeof(uint64_t), fOffsets.size(), fFile);
+      columnar_footer_t footer;
+      footer.num_chunks = fOffsets.size();
+      footer.magic = COLUMNAR_MAGIC;
+      fwrite(&footer, sizeof(columnar_footer_t), 1, fFile);
+      const bool failed = ferror(fFile);
+      fclose(fFile); fFile = 0;
+      if (failed) throw Exception(__PRETTY_FUNCTION__, "Failed to write the columnar file!", JustWarning, 43102);
+    }
+
+    inline unsigned long GetNumRows() const { return fNumRows; }
+    inline unsigned int GetNumChunks() const { return fOffsets.size(); }
+
+  private:
+    inline void Flush() {
+      if (fHeader.num_columns==0 or fColumns[0].size()==0) return;
+      columnar_chunk_t chunk;
+      memset(&chunk, 0, sizeof(columnar_chunk_t));
+      chunk.magic = COLUMNAR_MAGIC;
+      chunk.num_rows = fColumns[0].size();
+      for (unsigned int i=0; i<fHeader.num_columns; i++) {
+        const std::vector<uint32_t>& col = fColumns[i];
+        uint32_t min = col[0], max = col[0];
+        for (std::vector<uint32_t>::const_iterator v=col.begin(); v!=col.end(); v++) {
+          if (*v<min) min = *v;
+          if (*v>max) max = *v;
+        }
+        chunk.min[i] = min; chunk.max[i] = max;
+      }
+      fOffsets.push_back(ftello(fFile));
+      fwrite(&chunk, sizeof(columnar_chunk_t), 1, fFile);
+      for (unsigned int i=0; i<fHeader.num_columns; i++) {
+        fwrite(&fColumns[i][0], sizeof(uint32_t), fColumns[i].size(), fFile);
+        fColumns[i].clear();
+      }
+      fNumRows += chunk.num_rows;
+    }
+
+    columnar_header_t fHeader;
+    FILE* fFile;
+    unsigned int fChunkRows;
+    unsigned long fNumRows;
+    std::vector< std::vector<uint32_t> > fColumns;
+    std::vector<uint64_t> fOffsets;
+};
+
+/**
+ * Memory-maps a columnar file and gives a direct access to the arrays of
+ * values, without any copy. The per-chunk ranges allow skipping the chunks
+ * with no value of interest.
+ * \brief Reader of chunked columnar files
+ * \date 19 Oct 2026
+ */
+class ColumnarReader
+{
+  public:
+    inline ColumnarReader() : fData(0), fSize(0), fHeader(0), fNumChunks(0), fOffsets(0) {;}
+    inline ColumnarReader(const std::string& filename) : fData(0), fSize(0), fHeader(0), fNumChunks(0), fOffsets(0) { Open(filename); }
+    inline ~ColumnarReader() { Close(); }
+
+    inline void Open(const std::string& filename) {
+      Close();
+      int fd = open(filename.c_str(), O_RDONLY);
+      struct stat st;
+      if (fd<0 or fstat(fd, &st)!=0) {
+        if (fd>=0) close(fd);
+        std::ostringstream os; os << "Failed to open the columnar file \"" << filename << "\"!";
+        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 43110);
+      }
+      fSize = st.st_size;
+      void* data = (fSize>0) ? mmap(0, fSize, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+      close(fd);
+      if (data==MAP_FAILED) {
+        std::ostringstream os; os << "Failed to map the columnar file \"" << filename << "\"!";
+        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 43110);
+      }
+      fData = static_cast<const char*>(data);
+
+      fHeader = reinterpret_cast<const columnar_header_t*>(fData);
+      const columnar_footer_t* footer = (fSize>=sizeof(columnar_header_t)+sizeof(columnar_footer_t))
+        ? reinterpret_cast<const columnar_footer_t*>(fData+fSize-sizeof(columnar_footer_t)) : 0;
+      if (!footer
+       or fHeader->magic!=COLUMNAR_MAGIC or footer->magic!=COLUMNAR_MAGIC
+       or fHeader->num_columns>COLUMNAR_MAX_COLUMNS
+       or footer->num_chunks*sizeof(uint64_t)>fSize-sizeof(columnar_header_t)-sizeof(columnar_footer_t)) {
+        Close();
+        std::ostringstream os; os << "Invalid or incomplete columnar file \"" << filename << "\"!";
+        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 43111);
+      }
+      fNumChunks = footer->num_chunks;
+      fOffsets = reinterpret_cast<const uint64_t*>(fData+fSize-sizeof(columnar_footer_t)-fNumChunks*sizeof(uint64_t));
+    }
+    inline void Close() {
+      if (fData) munmap(const_cast<char*>(fData), fSize);
+      fData = 0; fSize = 0; fHeader = 0; fNumChunks = 0; fOffsets = 0;
+    }
+
+    inline const columnar_header_t& GetHeader() const { return *fHeader; }
+    inline unsigned int GetNumColumns() const { return fHeader->num_columns; }
+    /// Index of a column from its name (-1 if not found)
+    inline int FindColumn(const char* name) const {
+      for (unsigned int i=0; i<fHeader->num_columns; i++) {
+        if (strncmp(fHeader->names[i], name, COLUMNAR_NAME_LENGTH)==0) return i;
+      }
+      return -1;
+    }
+
+    inline unsigned int GetNumChunks() const { return fNumChunks; }
+    inline const columnar_chunk_t& GetChunk(unsigned int chunk) const {
+      return *reinterpret_cast<const columnar_chunk_t*>(fData+fOffsets[chunk]);
+    }
+    inline unsigned int GetNumRows(unsigned int chunk) const { return GetChunk(chunk).num_rows; }
+    /// Array of all values of one column in a chunk
+    inline const uint32_t* GetColumn(unsigned int chunk, unsigned int column) const {
+      const columnar_chunk_t& c = GetChunk(chunk);
+      return reinterpret_cast<const uint32_t*>(fData+fOffsets[chunk]+sizeof(columnar_chunk_t))+column*c.num_rows;
+    }
+
+  private:
+    const char* fData;
+    size_t fSize;
+    const columnar_header_t* fHeader;
+    unsigned int fNumChunks;
+    const uint64_t* fOffsets;
+};
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef DQMEngine_h
+#define DQMEngine_h
+
+#include "FileReader.h"
+#include "OnlineDBHandler.h"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <pthread.h>
+
+/// Maximal number of channels handled on each TDC board
+#define DQM_MAX_CHANNELS 128
+/// Mask of the edge time measurements (19-bit counter)
+#define DQM_TIME_MASK 0x7FFFF
+
+namespace DQM
+{
+  /**
+   * \brief Leading edge and time over threshold of one hit
+   */
+  struct Hit {
+    uint16_t channel_id;
+    /// Leading edge time (in units of 25 ps)
+    uint32_t leading_time;
+    /// Time over threshold (in units of 25 ps)
+    uint32_t tot;
+  };
+
+  /**
+   * \brief All hits recorded by one board for a given trigger
+   */
+  struct TriggerHits {
+    TriggerHits() : event_count(0) {;}
+    inline void Clear() { event_count = 0; hits.clear(); }
+    /// Trigger counter, common to all boards receiving the same trigger
+    uint32_t event_count;
+    std::vector<Hit> hits;
+  };
+
+  /**
+   * \brief Information on the burst currently dispatched to the modules
+   */
+  struct BurstContext {
+    uint32_t board_address;
+    /// Detector name, as stored in the run conditions
+    std::string detector;
+    file_header_t header;
+    /// Fraction (1/N) of the triggers decoded, and weight to apply to the counts
+    unsigned int sampling;
+    double weight;
+  };
+
+  /**
+   * Base class for all detector-specific treatments of the decoded hits. A
+   * module receives the triggers of every board whose detector name it
+   * accepts, so that one module may correlate several detectors.
+   * \brief Detector module of the unified DQM engine
+   * \date 19 Oct 2026
+   */
+  class DetectorModule
+  {
+    public:
+      /// \param[in] det_type Part of the detector names handled by this module
+      inline DetectorModule(const char* det_type) { fDetectorTypes.push_back(det_type); }
+      inline virtual ~DetectorModule() {;}
+
+      /// Also handle the boards of another detector
+      inline void AddDetectorType(const char* det_type) { fDetectorTypes.push_back(det_type); }
+      inline virtual bool Accepts(const std::string& detector) const {
+        for (std::vector<std::string>::const_iterator t=fDetectorTypes.begin(); t!=fDetectorTypes.end(); t++) {
+          if (detector.find(*t)!=std::string::npos) return true;
+        }
+        return false;
+      }
+
+      virtual void BeginBurst(const BurstContext&) {;}
+      virtual void ProcessTrigger(const BurstContext& burst, const TriggerHits& trigger) = 0;
+      /**
+       * \brief Produce the plots once all triggers of the burst were processed
+       * \return Were any plots produced?
+       */
+      virtual bool EndBurst(const BurstContext&, std::vector<std::string>*) { return false; }
+
+    protected:
+      std::vector<std::string> fDetectorTypes;
+  };
+
+  /**
+   * Decodes each board's file once, and dispatches the hits of every trigger
+   * to all modules registered for the board's detector. The decoding may be
+   * performed concurrently from several threads, while the modules are always
+   * called from one thread at a time.
+   * \brief Multi-detector DQM engine
+   * \date 19 Oct 2026
+   */
+  class DQMEngine
+  {
+    public:
+      inline DQMEngine() : fRunId(0) {
+        pthread_mutex_init(&fMutex, NULL);
+        pthread_mutex_init(&fConditionsMutex, NULL);
+      }
+      inline ~DQMEngine() {
+        pthread_mutex_destroy(&fConditionsMutex);
+        pthread_mutex_destroy(&fMutex);
+      }
+
+      /// Add a module to the dispatching list (not owned by the engine)
+      inline void Register(DetectorModule* module) { fModules.push_back(module); }
+      /// Force the detector name of a board, instead of retrieving it from the run conditions
+      inline void SetDetector(uint32_t board_address, const std::string& detector) { fOverrides[board_address] = detector; }
+
+      /**
+       * \brief Decode one board's file and dispatch its content
+       * \param[in] sampling Fraction (1/N) of the triggers to decode
+       * \return Were any plots produced by the modules?
+       */
+      inline bool Process(unsigned int board_address, const std::string& filename, std::vector<std::string>* outputs, unsigned int sampling=1) {
+        FileReader reader;
+        reader.Open(filename);
+        reader.SetSampling(sampling);
+
+        BurstContext burst;
+        burst.board_address = board_address;
+        burst.header = reader.GetHeader();
+        burst.detector = GetDetector(board_address, reader.GetRunId());
+        std::vector<DetectorModule*> modules;
+        for (std::vector<DetectorModule*>::iterator m=fModules.begin(); m!=fModules.end(); m++) {
+          if ((*m)->Accepts(burst.detector)) modules.push_back(*m);
+        }
+        if (modules.size()==0) return false; // nobody is interested in this board
+
+        std::vector<TriggerHits> triggers;
+        Decode(reader, &triggers);
+        burst.sampling = reader.GetSampling();
+        burst.weight = reader.GetSamplingWeight();
+
+        bool status = false;
+        pthread_mutex_lock(&fMutex);
+        try {
+          for (std::vector<DetectorModule*>::iterator m=modules.begin(); m!=modules.end(); m++) {
+            (*m)->BeginBurst(burst);
+            for (std::vector<TriggerHits>::const_iterator t=triggers.begin(); t!=triggers.end(); t++) (*m)->ProcessTrigger(burst, *t);
+            status |= (*m)->EndBurst(burst, outputs);
+          }
+        } catch (Exception& e) { pthread_mutex_unlock(&fMutex); throw e; }
+        pthread_mutex_unlock(&fMutex);
+        return status;
+      }
+
+      /// Split the file content into the hits recorded for each trigger
+      static inline void Decode(FileReader& reader, std::vector<TriggerHits>* triggers) {
+        const bool trigger_matching = (reader.GetAcquisitionMode()==VME::TRIG_MATCH);
+        std::vector<uint32_t> leading(DQM_MAX_CHANNELS, 0);
+        std::vector<bool> has_leading(DQM_MAX_CHANNELS, false);
+        TriggerHits trigger;
+        VME::TDCEvent ev;
+        while (reader.GetNextEvent(&ev)) {
+          switch (ev.GetType()) {
+            case VME::TDCEvent::GlobalHeader:
+              trigger.Clear();
+              trigger.event_count = ev.GetEventCount();
+              has_leading.assign(DQM_MAX_CHANNELS, false);
+              break;
+            case VME::TDCEvent::TDCMeasurement: {
+              const unsigned int ch = ev.GetChannelId();
+              if (ch>=DQM_MAX_CHANNELS) break;
+              if (!ev.IsTrailing()) { leading[ch] = ev.GetTime(); has_leading[ch] = true; break; }
+              if (!has_leading[ch]) break; // trailing edge without its leading one
+              Hit hit;
+              hit.channel_id = ch;
+              hit.leading_time = leading[ch];
+              hit.tot = (ev.GetTime()-leading[ch])&DQM_TIME_MASK; // handles the counter rollover
+              trigger.hits.push_back(hit);
+              has_leading[ch] = false;
+            } break;
+            case VME::TDCEvent::GlobalTrailer:
+              if (trigger_matching) triggers->push_back(trigger);
+              trigger.Clear();
+              break;
+            case VME::TDCEvent::Trigger:
+              // in continuous storage mode, hits are grouped between two trigger words
+              if (!trigger_matching and trigger.hits.size()>0) triggers->push_back(trigger);
+              trigger.Clear();
+              break;
+            default: break;
+          }
+        }
+        if (!trigger_matching and trigger.hits.size()>0) triggers->push_back(trigger);
+      }
+
+    private:
+      inline std::string GetDetector(uint32_t board_address, unsigned int run_id) {
+        std::map<uint32_t, std::string>::const_iterator it = fOverrides.find(board_address);
+        if (it!=fOverrides.end()) return it->second;
+
+        std::string detector;
+        pthread_mutex_lock(&fConditionsMutex);
+        if (run_id!=fRunId or fDetectors.empty()) {
+          fDetectors.clear();
+          fRunId = run_id;
+          try {
+            OnlineDBHandler::TDCConditionsCollection cc = OnlineDBHandler().GetTDCConditions(run_id);
+            for (OnlineDBHandler::TDCConditionsCollection::const_iterator c=cc.begin(); c!=cc.end(); c++) {
+              fDetectors[c->tdc_address] = c->detector;
+            }
+          } catch (Exception& e) { e.Dump(); }
+        }
+        it = fDetectors.find(board_address);
+        if (it!=fDetectors.end()) detector = it->second;
+        pthread_mutex_unlock(&fConditionsMutex);
+        return detector;
+      }
+
+      std::vector<DetectorModule*> fModules;
+      std::map<uint32_t, std::string> fOverrides, fDetectors;
+      unsigned int fRunId;
+      /// Serialises the calls to the modules
+      pthread_mutex_t fMutex;
+      pthread_mutex_t fConditionsMutex;
+  };
+}
+
+#endif
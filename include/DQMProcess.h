@@ -1,8 +1,27 @@
 #include "Client.h"
 #include "Exception.h"
 #include "OnlineDBHandler.h"
+#include "FileReader.h"
+#include "SharedMemoryTap.h"
+#include "RunAccumulator.h"
+#include "RenderScheduler.h"
+#include "SamplingController.h"
+
+#include <sys/select.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <deque>
 
 #define DQM_OUTPUT_DIR "/tmp/"
+/// Default period (in ms) between two refreshes of the live DQM plots
+#define DQM_LIVE_REFRESH_MS 5000
+/// Default number of files processed in parallel in the worker pool mode
+#define DQM_NUM_WORKERS 4
+/// Default maximal number of files waiting to be processed in the worker pool mode
+#define DQM_MAX_QUEUE 20
+/// Binning of the per-channel time over threshold distributions (in ns)
+#define DQM_TOT_NUM_BINS 100
+#define DQM_TOT_MAX 100.
 
 namespace DQM
 {
@@ -15,29 +34,94 @@ namespace DQM
   {
     public:
       inline DQMProcess(int port, unsigned short order=0, const char* det_type="") :
-        Client(port), fOrder(order), fRunNumber(0), fDetectorType(det_type) {
+        Client(port), fOrder(order), fRunNumber(0), fDetectorType(det_type),
+        fAccumulator(0), fRenderer(0), fSampling(0), fJobFcn(0), fJobAction(NewPlot), fDefaultPolicy(DropOldest), fMaxQueue(DQM_MAX_QUEUE), fStop(false),
+        fNumProcessed(0), fNumDropped(0), fTotalLatency(0.), fLastLatency(0.) {
+        pthread_mutex_init(&fQueueMutex, NULL);
+        pthread_cond_init(&fQueueCondition, NULL);
         Client::Connect(Socket::DQM);
         SocketMessage run_msg = Client::SendAndReceive(GET_RUN_NUMBER, RUN_NUMBER);
         std::cout << "Current run number is: " << run_msg.GetIntValue() << std::endl;
         fRunNumber = run_msg.GetIntValue();
         IsInRun();
       }
-      inline ~DQMProcess() { Client::Disconnect(); }
+      inline ~DQMProcess() {
+        if (fRenderer) { fRenderer->Stop(); fRenderer->SetCallback(0, 0); }
+        Client::Disconnect();
+        pthread_cond_destroy(&fQueueCondition);
+        pthread_mutex_destroy(&fQueueMutex);
+      }
 
       enum Action { NewPlot = 0x0, UpdatedPlot = 0x1 };
+      /// Behaviour of the worker pool queue when a board produces files faster than they are processed
+      enum QueuePolicy {
+        DropOldest = 0x0, ///< Drop the oldest file waiting (of this board if any) once the queue is full
+        Coalesce = 0x1    ///< Only keep the latest file waiting for each board
+      };
+
+      /// Attach run-level accumulators, reset whenever a new run is started
+      inline void SetAccumulator(RunAccumulator* acc) {
+        fAccumulator = acc;
+        if (fAccumulator) fAccumulator->Reset(fRunNumber);
+      }
+      /**
+       * \brief Publish the plots rendered by a scheduler as updated DQM plots
+       * \param[in] threaded Render the plots in a separate thread (requires a thread-safe ROOT)
+       */
+      inline void SetRenderScheduler(RenderScheduler* rs, bool threaded=true) {
+        fRenderer = rs;
+        if (!fRenderer) return;
+        fRenderer->SetCallback(DQMProcess::PlotRendered, this);
+        if (threaded and !fRenderer->Start()) {
+          SafeSend(Exception(__PRETTY_FUNCTION__, "Failed to launch the rendering thread! Rendering from the analysis thread.", JustWarning, 42001));
+        }
+      }
+      /**
+       * \brief Adapt the fraction of triggers decoded by the plotter to the backlog of files waiting
+       * \note The plotter is expected to retrieve the sampling factor from the controller
+       */
+      inline void SetSamplingController(SamplingController* sc) { fSampling = sc; }
+      /// Set the queue policy for one board (the default one is used for all others)
+      inline void SetQueuePolicy(uint32_t board_address, const QueuePolicy& policy) { fPolicies[board_address] = policy; }
+      inline void SetQueuePolicy(const QueuePolicy& policy) { fDefaultPolicy = policy; }
+      /// Number of files currently waiting to be processed
+      inline unsigned int GetQueueDepth() {
+        pthread_mutex_lock(&fQueueMutex); const unsigned int depth = fQueue.size(); pthread_mutex_unlock(&fQueueMutex);
+        return depth;
+      }
+      /// Number of files processed by the worker pool
+      inline unsigned long GetNumProcessed() const { return fNumProcessed; }
+      /// Number of files dropped from the queue without being processed
+      inline unsigned long GetNumDropped() const { return fNumDropped; }
+      /// Average time (in s) between the reception of a file and the end of its processing
+      inline double GetMeanLatency() const { return (fNumProcessed>0) ? fTotalLatency/fNumProcessed : 0.; }
+      /// Time (in s) between the reception of the last file processed and the end of its processing
+      inline double GetLastLatency() const { return fLastLatency; }
 
       /// Run a DQM plotter making use of the board/output filename information
       inline void Run(bool (*fcn)(unsigned int addr, std::string filename, std::vector<std::string>* outputs), const Action& act=NewPlot) {
         bool status = false;
         uint32_t board_address; std::string filename;
         std::vector<std::string> outputs;
+        std::deque<std::pair<uint32_t, std::string> > pending;
         try {
           while (true) {
             outputs.clear();
-	    int ret = ParseMessage(&board_address, &filename);
-            if (ret!=1) continue;
+            if (fSampling) {
+              // gather all files already announced to measure the backlog
+              while (pending.empty() or HasPendingMessage()) {
+                if (ParseMessage(&board_address, &filename)==1) pending.push_back(std::pair<uint32_t, std::string>(board_address, filename));
+              }
+              board_address = pending.front().first; filename = pending.front().second;
+              pending.pop_front();
+              fSampling->Update(pending.size());
+            }
+            else {
+	      int ret = ParseMessage(&board_address, &filename);
+              if (ret!=1) continue;
+            }
             // new raw file to process
-            try { status = fcn(board_address, filename, &outputs); } catch (Exception& e) { Client::Send(e); continue; }
+            try { status = fcn(board_address, filename, &outputs); } catch (Exception& e) { SafeSend(e); continue; }
             if (!status) continue; // failed to produce plots
             std::cout << "Produced " << outputs.size() << " plot(s) for board with address 0x" << std::hex << board_address << std::endl;
             MessageKey key = INVALID_KEY;
@@ -47,10 +131,51 @@ namespace DQM
             }
             //sleep(fOrder);
             for (std::vector<std::string>::iterator nm=outputs.begin(); nm!=outputs.end(); nm++) {
-              Client::Send(SocketMessage(key, *nm)); usleep(500);
+              SafeSend(SocketMessage(key, *nm));
             }
           }
-        } catch (Exception& e) { /*Client::Send(e);*/ e.Dump(); }
+        } catch (Exception& e) { /*SafeSend(e);*/ e.Dump(); }
+      }
+      /**
+       * Process the files received in parallel in a pool of worker threads,
+       * while the socket keeps being listened to. Files waiting to be
+       * processed are kept in a bounded queue, handled according to the
+       * per-board queue policy.
+       * \brief Run a DQM plotter on a pool of worker threads
+       * \param[in] num_workers Number of files processed concurrently
+       * \param[in] max_queue Maximal number of files waiting to be processed
+       * \note The plotter must be reentrant (e.g. with ROOT's thread safety enabled)
+       */
+      inline void RunParallel(bool (*fcn)(unsigned int addr, std::string filename, std::vector<std::string>* outputs), const Action& act=NewPlot, unsigned int num_workers=DQM_NUM_WORKERS, unsigned int max_queue=DQM_MAX_QUEUE) {
+        fJobFcn = fcn; fJobAction = act;
+        fMaxQueue = (max_queue>0) ? max_queue : 1;
+        fStop = false;
+        std::vector<pthread_t> workers;
+        for (unsigned int i=0; i<num_workers; i++) {
+          pthread_t thread;
+          if (pthread_create(&thread, NULL, DQMProcess::ProcessJobs, this)!=0) {
+            SafeSend(Exception(__PRETTY_FUNCTION__, "Failed to launch a DQM worker thread!", JustWarning, 42000));
+            continue;
+          }
+          workers.push_back(thread);
+        }
+        if (workers.size()==0) { Run(fcn, act); return; } // fall back to the sequential mode
+        std::cout << "Processing the DQM with " << workers.size() << " worker thread(s)" << std::endl;
+
+        uint32_t board_address; std::string filename;
+        try {
+          while (true) {
+            int ret = ParseMessage(&board_address, &filename);
+            if (ret!=1) continue;
+            AddJob(board_address, filename);
+          }
+        } catch (Exception& e) { e.Dump(); }
+
+        pthread_mutex_lock(&fQueueMutex);
+        fStop = true;
+        pthread_cond_broadcast(&fQueueCondition);
+        pthread_mutex_unlock(&fQueueMutex);
+        for (std::vector<pthread_t>::iterator w=workers.begin(); w!=workers.end(); w++) pthread_join(*w, NULL);
       }
       /// Run a DQM plotter without any information on the board/output filename
       inline void Run(bool (*fcn)(std::vector<std::string>* outputs), const Action& act=NewPlot) {
@@ -63,7 +188,7 @@ namespace DQM
             int ret =  ParseMessage(&board_address, &filename);
             if (ret!=1) continue;
             // new raw file to process
-            try { status = fcn(&outputs); } catch (Exception& e) { Client::Send(e); continue; }
+            try { status = fcn(&outputs); } catch (Exception& e) { SafeSend(e); continue; }
             if (!status) continue; // failed to produce plots
             std::cout << "Produced " << outputs.size() << " plot(s)" << std::endl;
             MessageKey key = INVALID_KEY;
@@ -73,17 +198,236 @@ namespace DQM
             }
             //sleep(fOrder);
             for (std::vector<std::string>::iterator nm=outputs.begin(); nm!=outputs.end(); nm++) {
-              Client::Send(SocketMessage(key, *nm)); usleep(500);
+              SafeSend(SocketMessage(key, *nm));
             }
           } // end of infinite loop to fetch messages
-        } catch (Exception& e) { Client::Send(e); e.Dump(); }
+        } catch (Exception& e) { SafeSend(e); e.Dump(); }
+      }
+      /**
+       * Follow the output files while the acquisition is still writing them,
+       * and feed the plotter with every new complete event as soon as it is
+       * written, instead of waiting for the end of the burst.
+       * \brief Run a DQM plotter on the files being written
+       * \param[in] refresh_ms Minimal period between two updates of the plots
+       */
+      inline void RunLive(bool (*fcn)(unsigned int addr, const file_header_t& header, const VME::TDCEventCollection& events, std::vector<std::string>* outputs), unsigned int refresh_ms=DQM_LIVE_REFRESH_MS) {
+        typedef std::map<uint32_t, FileReader*> LiveReaders;
+        LiveReaders readers;
+        uint32_t board_address; std::string filename;
+        struct timeval now, left, next_refresh;
+        gettimeofday(&next_refresh, NULL);
+        try {
+          while (true) {
+            gettimeofday(&now, NULL);
+            if (timercmp(&now, &next_refresh, <)) timersub(&next_refresh, &now, &left);
+            else timerclear(&left);
+            fd_set fds; FD_ZERO(&fds); FD_SET(GetSocketId(), &fds);
+            if (HasBufferedMessage() or select(GetSocketId()+1, &fds, NULL, NULL, &left)>0) {
+              int ret = ParseMessage(&board_address, &filename);
+              if (ret==2) { // new file being written
+                LiveReaders::iterator it = readers.find(board_address);
+                if (it!=readers.end()) {
+                  // the end of the previous burst is plotted before following the new one
+                  ProcessLiveEvents(fcn, it->first, it->second);
+                  delete it->second; readers.erase(it);
+                }
+                FileReader* reader = new FileReader;
+                reader->SetFollowMode(true, 0);
+                try { reader->Open(filename); } catch (Exception& e) { SafeSend(e); delete reader; continue; }
+                readers.insert(std::pair<uint32_t, FileReader*>(board_address, reader));
+              }
+              // pending messages are processed first, as long as the refresh is not due
+              gettimeofday(&now, NULL);
+              if (timercmp(&now, &next_refresh, <)) continue;
+            }
+            // collect all complete events appended since last refresh
+            for (LiveReaders::iterator it=readers.begin(); it!=readers.end();) {
+              ProcessLiveEvents(fcn, it->first, it->second);
+              if (it->second->IsWriterDone()) { delete it->second; readers.erase(it++); }
+              else it++;
+            }
+            gettimeofday(&next_refresh, NULL);
+            next_refresh.tv_sec += refresh_ms/1000;
+            next_refresh.tv_usec += (refresh_ms%1000)*1000;
+            if (next_refresh.tv_usec>=1000000) { next_refresh.tv_sec++; next_refresh.tv_usec -= 1000000; }
+          }
+        } catch (Exception& e) { SafeSend(e); e.Dump(); }
+        for (LiveReaders::iterator it=readers.begin(); it!=readers.end(); it++) { delete it->second; }
+      }
+      /**
+       * Attach to the shared memory segment published by the acquisition, and
+       * feed the plotter with the new complete events of each board without
+       * any disk access.
+       * \brief Run a DQM plotter on the live data tap
+       * \param[in] refresh_ms Minimal period between two updates of the plots
+       */
+      inline void RunTap(bool (*fcn)(unsigned int addr, const file_header_t& header, const VME::TDCEventCollection& events, std::vector<std::string>* outputs), unsigned int refresh_ms=DQM_LIVE_REFRESH_MS) {
+        SharedMemoryTap tap(SharedMemoryTap::SkipToOldest);
+        uint32_t board_address; std::string filename;
+        std::vector<std::string> outputs;
+        std::vector<uint64_t> num_lost;
+        VME::TDCEventCollection events;
+        struct timeval now, left, next_refresh;
+        gettimeofday(&next_refresh, NULL);
+        try {
+          while (true) {
+            gettimeofday(&now, NULL);
+            if (timercmp(&now, &next_refresh, <)) timersub(&next_refresh, &now, &left);
+            else timerclear(&left);
+            fd_set fds; FD_ZERO(&fds); FD_SET(GetSocketId(), &fds);
+            if (HasBufferedMessage() or select(GetSocketId()+1, &fds, NULL, NULL, &left)>0) {
+              ParseMessage(&board_address, &filename); // keeps track of the run conditions
+              // pending messages are processed first, as long as the refresh is not due
+              gettimeofday(&now, NULL);
+              if (timercmp(&now, &next_refresh, <)) continue;
+            }
+            gettimeofday(&next_refresh, NULL);
+            next_refresh.tv_sec += refresh_ms/1000;
+            next_refresh.tv_usec += (refresh_ms%1000)*1000;
+            if (next_refresh.tv_usec>=1000000) { next_refresh.tv_sec++; next_refresh.tv_usec -= 1000000; }
+            // (re)attach whenever a new acquisition publishes its data
+            if (!tap.IsAttached() or tap.IsStale()) {
+              if (!tap.Attach()) continue;
+              num_lost.assign(tap.GetNumStreams(), 0);
+              std::cout << "Attached to the live data tap with " << tap.GetNumStreams() << " board(s)" << std::endl;
+            }
+            for (unsigned int i=0; i<tap.GetNumStreams(); i++) {
+              board_address = tap.GetBoardAddress(i);
+              if (fDetectorType!="" and fAddressesCanProcess.find(board_address)==fAddressesCanProcess.end()) continue;
+              events.clear(); outputs.clear();
+              if (tap.Fetch(i, &events)==0) continue;
+              if (tap.GetNumLostWords(i)!=num_lost[i]) {
+                num_lost[i] = tap.GetNumLostWords(i);
+                std::cout << "Board with address 0x" << std::hex << board_address << std::dec << " overran this consumer: "
+                          << num_lost[i] << " word(s) lost so far" << std::endl;
+              }
+              bool status = false;
+              try { status = fcn(board_address, tap.GetFileHeader(i), events, &outputs); } catch (Exception& e) { SafeSend(e); }
+              if (status) SendUpdatedPlots(outputs);
+            }
+          }
+        } catch (Exception& e) { SafeSend(e); e.Dump(); }
       }
     private:
+      /// File waiting to be processed by the worker pool
+      struct Job {
+        uint32_t board_address;
+        std::string filename;
+        struct timeval received;
+      };
+      inline void AddJob(uint32_t board_address, const std::string& filename) {
+        Job job; job.board_address = board_address; job.filename = filename;
+        gettimeofday(&job.received, NULL);
+        std::map<uint32_t, QueuePolicy>::const_iterator pol = fPolicies.find(board_address);
+        const QueuePolicy policy = (pol!=fPolicies.end()) ? pol->second : fDefaultPolicy;
+
+        pthread_mutex_lock(&fQueueMutex);
+        std::deque<Job>::iterator same_board = fQueue.end();
+        for (std::deque<Job>::iterator j=fQueue.begin(); j!=fQueue.end(); j++) {
+          if (j->board_address==board_address) { same_board = j; break; }
+        }
+        if (policy==Coalesce and same_board!=fQueue.end()) {
+          // the new file supersedes the one still waiting for this board
+          fQueue.erase(same_board); fNumDropped++;
+        }
+        else if (fQueue.size()>=fMaxQueue) {
+          if (policy==DropOldest and same_board!=fQueue.end()) fQueue.erase(same_board);
+          else fQueue.pop_front();
+          fNumDropped++;
+        }
+        fQueue.push_back(job);
+        pthread_cond_signal(&fQueueCondition);
+        pthread_mutex_unlock(&fQueueMutex);
+      }
+      static void* ProcessJobs(void* arg) {
+        DQMProcess* dqm = static_cast<DQMProcess*>(arg);
+        std::vector<std::string> outputs;
+        while (true) {
+          pthread_mutex_lock(&dqm->fQueueMutex);
+          while (!dqm->fStop and dqm->fQueue.empty()) pthread_cond_wait(&dqm->fQueueCondition, &dqm->fQueueMutex);
+          if (dqm->fStop) { pthread_mutex_unlock(&dqm->fQueueMutex); break; }
+          Job job = dqm->fQueue.front();
+          dqm->fQueue.pop_front();
+          if (dqm->fSampling) dqm->fSampling->Update(dqm->fQueue.size());
+          pthread_mutex_unlock(&dqm->fQueueMutex);
+
+          outputs.clear();
+          bool status = false;
+          try { status = dqm->fJobFcn(job.board_address, job.filename, &outputs); } catch (Exception& e) { dqm->SafeSend(e); }
+
+          struct timeval now; gettimeofday(&now, NULL);
+          const double latency = (now.tv_sec-job.received.tv_sec)+(now.tv_usec-job.received.tv_usec)*1.e-6;
+          pthread_mutex_lock(&dqm->fQueueMutex);
+          dqm->fNumProcessed++;
+          dqm->fTotalLatency += latency;
+          dqm->fLastLatency = latency;
+          std::ostringstream os;
+          os << dqm->fDetectorType << ":" << dqm->fQueue.size() << "," << dqm->fMaxQueue << "," << dqm->fNumDropped << "," << static_cast<int>(latency*1.e3)
+             << "," << (dqm->fSampling ? dqm->fSampling->GetFactor() : 1);
+          pthread_mutex_unlock(&dqm->fQueueMutex);
+
+          if (status) {
+            std::cout << "Produced " << outputs.size() << " plot(s) for board with address 0x" << std::hex << job.board_address << std::dec << std::endl;
+            const MessageKey key = (dqm->fJobAction==UpdatedPlot) ? UPDATED_DQM_PLOT : NEW_DQM_PLOT;
+            for (std::vector<std::string>::iterator nm=outputs.begin(); nm!=outputs.end(); nm++) {
+              dqm->SafeSend(SocketMessage(key, *nm));
+            }
+          }
+          dqm->SafeSend(SocketMessage(DQM_QUEUE_STATUS, os.str()));
+        }
+        return 0;
+      }
+      static void PlotRendered(const std::string& name, void* arg) {
+        static_cast<DQMProcess*>(arg)->SafeSend(SocketMessage(UPDATED_DQM_PLOT, name));
+      }
+      /// Send a message to the master from any thread (under the connection lock of the client)
+      inline void SafeSend(const Message& m) {
+        try { Client::Send(m); } catch (Exception& e) { e.Dump(); }
+      }
+      inline void SafeSend(const Exception& e) { SafeSend(SocketMessage(EXCEPTION, e.OneLine())); }
+      /// Is a message from the socket master waiting to be parsed?
+      inline bool HasPendingMessage() {
+        if (HasBufferedMessage()) return true;
+        fd_set fds; FD_ZERO(&fds); FD_SET(GetSocketId(), &fds);
+        struct timeval tv; tv.tv_sec = tv.tv_usec = 0;
+        return (select(GetSocketId()+1, &fds, NULL, NULL, &tv)>0);
+      }
+      /// Feed the plotter with all complete events appended to a file being written
+      inline void ProcessLiveEvents(bool (*fcn)(unsigned int addr, const file_header_t& header, const VME::TDCEventCollection& events, std::vector<std::string>* outputs), uint32_t board_address, FileReader* reader) {
+        VME::TDCEventCollection events;
+        std::vector<std::string> outputs;
+        VME::TDCEvent ev;
+        while (reader->GetNextEvent(&ev)) { events.push_back(ev); }
+        if (events.size()==0) return;
+        bool status = false;
+        try { status = fcn(board_address, reader->GetHeader(), events, &outputs); } catch (Exception& e) { SafeSend(e); }
+        if (status) SendUpdatedPlots(outputs);
+      }
+      inline void SendUpdatedPlots(const std::vector<std::string>& outputs) {
+        for (std::vector<std::string>::const_iterator nm=outputs.begin(); nm!=outputs.end(); nm++) {
+          SafeSend(SocketMessage(UPDATED_DQM_PLOT, *nm));
+        }
+      }
+      /**
+       * \brief Parse a message received from the socket master
+       * \return 1 for a closed file to process, 2 for a file still being written,
+       *  0 for a file to skip, and a negative value in case of error
+       */
       int ParseMessage(uint32_t* board_address, std::string* filename) {
-        SocketMessage msg = Client::Receive(NEW_FILENAME);
-        if (msg.GetKey()==NEW_FILENAME) {
+        // the message is waited for without blocking the other threads' sends,
+        // but is received under the connection lock as the connection may be reopened meanwhile
+        if (!HasBufferedMessage()) {
+          fd_set fds; FD_ZERO(&fds); FD_SET(GetSocketId(), &fds);
+          select(GetSocketId()+1, &fds, NULL, NULL, NULL);
+        }
+        SocketMessage msg;
+        LockConnection();
+        try { msg = Client::Receive(NEW_FILENAME); } catch (Exception& e) { UnlockConnection(); throw e; }
+        UnlockConnection();
+        if (msg.GetKey()==NEW_FILENAME or msg.GetKey()==LIVE_FILENAME) {
+          const int status = (msg.GetKey()==NEW_FILENAME) ? 1 : 2;
           if (msg.GetValue()=="") {
-            std::ostringstream os; os << "Invalid output file path received through the NEW_FILENAME message: " << msg.GetValue();
+            std::ostringstream os; os << "Invalid output file path received through the " << MessageKeyToString(msg.GetKey()) << " message: " << msg.GetValue();
             throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning);
           }
           std::string value = msg.GetValue();
@@ -94,20 +438,21 @@ namespace DQM
           }
           *board_address = atoi(value.substr(0, end).c_str());
           *filename = value.substr(end+1);
-          if (fDetectorType=="") return 1;
+          if (fDetectorType=="") return status;
           if (fAddressesCanProcess.find(*board_address)==fAddressesCanProcess.end()) {
             std::cout << "board address " << *board_address << " is not in run" << std::endl;
             return 0;
           }
           
           std::cout << "Board address: " << *board_address << ", filename: " << *filename << std::endl;
-          return 1;
+          return status;
         }
         else if (msg.GetKey()==RUN_NUMBER) {
           try { fRunNumber = msg.GetIntValue(); } catch (Exception& e) {
             std::cout << "Invalid Run number received: " << msg.GetValue() << std::endl;
             return -2;
           }
+          if (fAccumulator) fAccumulator->Reset(fRunNumber);
           if (IsInRun()) return 0;
           else return -3;
         }
@@ -135,18 +480,47 @@ namespace DQM
               fAddressesCanProcess.insert(std::pair<unsigned long, std::string>(c->tdc_address, c->detector));
             }
           }
+          UpdateSubscriptions();
           if (fAddressesCanProcess.size()!=0) return true;
           std::cout << "Detector not in conditions... leaving this DQM (" << fDetectorType << ") hanging." << std::endl;
           return false;
         } catch (Exception& e) {
           e.Dump();
           std::cout << "Failed to retrieve online TDC conditions. Aborting" << std::endl;
+          UpdateSubscriptions();
           return false;
         }
       }
+      /// Only receive from the master the file names of the boards this DQM processes
+      inline void UpdateSubscriptions() {
+        std::vector<std::string> boards;
+        for (std::map<unsigned long, std::string>::const_iterator it=fAddressesCanProcess.begin(); it!=fAddressesCanProcess.end(); it++) {
+          std::ostringstream os; os << it->first;
+          boards.push_back(os.str());
+        }
+        try {
+          if (boards.empty()) { Client::Unsubscribe(NEW_FILENAME); Client::Unsubscribe(LIVE_FILENAME); }
+          else { Client::Subscribe(NEW_FILENAME, boards); Client::Subscribe(LIVE_FILENAME, boards); }
+        } catch (Exception& e) { e.Dump(); }
+      }
       unsigned short fOrder;
       unsigned int fRunNumber;
       std::string fDetectorType;
       std::map<unsigned long, std::string> fAddressesCanProcess;
+      RunAccumulator* fAccumulator;
+      RenderScheduler* fRenderer;
+      SamplingController* fSampling;
+
+      bool (*fJobFcn)(unsigned int, std::string, std::vector<std::string>*);
+      Action fJobAction;
+      QueuePolicy fDefaultPolicy;
+      std::map<uint32_t, QueuePolicy> fPolicies;
+      std::deque<Job> fQueue;
+      unsigned int fMaxQueue;
+      bool fStop;
+      unsigned long fNumProcessed, fNumDropped;
+      double fTotalLatency, fLastLatency;
+      pthread_mutex_t fQueueMutex;
+      pthread_cond_t fQueueCondition;
   };
 }
@@ -0,0 +1,130 @@
+#ifndef DetectorGeometry_h
+#define DetectorGeometry_h
+
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <pthread.h>
+
+#include "Exception.h"
+#include "tinyxml2.h"
+
+/// Location of the channels mapping configuration, relative to $PPS_PATH
+#define GEOMETRY_FILE "/config/geometry.xml"
+
+namespace DQM
+{
+  /**
+   * Position of every (board, channel) of a detector in its display grid,
+   * stored in one flat table so that retrieving the position of a channel is
+   * a single array lookup. The mappings of all detectors are described in
+   * the XML configuration, e.g.
+   * \code
+   * <geometry detector="quartic" boards="1" channels="32" width="5" height="4">
+   *   <channel board="0" id="0" x="5" y="2"/>
+   * </geometry>
+   * \endcode
+   * \brief Channels mapping of a detector
+   * \date 19 Oct 2026
+   */
+  class DetectorGeometry
+  {
+    public:
+      /// Position of a channel in the detector grid (starting at 1)
+      struct Cell {
+        Cell(short x_=0, short y_=0) : x(x_), y(y_) {;}
+        inline bool IsValid() const { return (x>0 and y>0); }
+        short x, y;
+      };
+
+      inline DetectorGeometry(unsigned int num_boards=1, unsigned int num_channels=32, unsigned int width=0, unsigned int height=0) :
+        fNumBoards(num_boards), fNumChannels(num_channels), fWidth(width), fHeight(height), fCells(num_boards*num_channels) {;}
+
+      inline unsigned int GetNumBoards() const { return fNumBoards; }
+      inline unsigned int GetNumChannels() const { return fNumChannels; }
+      /// Number of cells in the horizontal direction of the grid
+      inline unsigned int GetWidth() const { return fWidth; }
+      /// Number of cells in the vertical direction of the grid
+      inline unsigned int GetHeight() const { return fHeight; }
+
+      inline void SetCell(unsigned int board_id, unsigned int channel_id, const Cell& cell) {
+        if (board_id>=fNumBoards or channel_id>=fNumChannels) return;
+        fCells[board_id*fNumChannels+channel_id] = cell;
+        if ((unsigned int)cell.x>fWidth) fWidth = cell.x;
+        if ((unsigned int)cell.y>fHeight) fHeight = cell.y;
+      }
+      /// Position of a channel (invalid if the channel is not mapped)
+      inline const Cell& GetCell(unsigned int board_id, unsigned int channel_id) const {
+        static const Cell invalid;
+        return (board_id<fNumBoards and channel_id<fNumChannels) ? fCells[board_id*fNumChannels+channel_id] : invalid;
+      }
+
+      /**
+       * \brief Retrieve the mapping of one detector
+       * \note The configuration is parsed once, at the first call
+       */
+      static inline const DetectorGeometry& Get(const std::string& detector) {
+        static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        pthread_mutex_lock(&mutex);
+        Registry& geometries = GetRegistry();
+        if (geometries.empty()) {
+          const char* path = getenv("PPS_PATH");
+          try { Load(std::string(path ? path : ".")+GEOMETRY_FILE); } catch (Exception& e) { pthread_mutex_unlock(&mutex); throw e; }
+        }
+        Registry::const_iterator it = geometries.find(detector);
+        pthread_mutex_unlock(&mutex);
+        if (it==geometries.end()) {
+          std::ostringstream os; os << "No channels mapping found for detector \"" << detector << "\"!";
+          throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 42400);
+        }
+        return it->second;
+      }
+      /// Parse all detectors mappings from an XML configuration file
+      static inline void Load(const std::string& filename) {
+        tinyxml2::XMLDocument doc;
+        doc.LoadFile(filename.c_str());
+        if (doc.Error()) {
+          std::ostringstream os;
+          os << "Error while trying to parse the geometry file \"" << filename << "\"" << "\n\t"
+             << "Code: " << doc.ErrorID();
+          throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 42401);
+        }
+        Registry& geometries = GetRegistry();
+        for (tinyxml2::XMLElement* ageom=doc.FirstChildElement("geometry"); ageom!=NULL; ageom=ageom->NextSiblingElement("geometry")) {
+          const char* detector = ageom->Attribute("detector");
+          if (!detector) throw Exception(__PRETTY_FUNCTION__, "Geometry with no detector name found!", JustWarning, 42402);
+          unsigned int num_boards = 1, num_channels = 32, width = 0, height = 0;
+          ageom->QueryUnsignedAttribute("boards", &num_boards);
+          ageom->QueryUnsignedAttribute("channels", &num_channels);
+          ageom->QueryUnsignedAttribute("width", &width);
+          ageom->QueryUnsignedAttribute("height", &height);
+          DetectorGeometry geom(num_boards, num_channels, width, height);
+          for (tinyxml2::XMLElement* ach=ageom->FirstChildElement("channel"); ach!=NULL; ach=ach->NextSiblingElement("channel")) {
+            unsigned int board_id = 0, channel_id = 0;
+            int x = 0, y = 0;
+            ach->QueryUnsignedAttribute("board", &board_id);
+            if (ach->QueryUnsignedAttribute("id", &channel_id)!=tinyxml2::XML_SUCCESS
+             or ach->QueryIntAttribute("x", &x)!=tinyxml2::XML_SUCCESS
+             or ach->QueryIntAttribute("y", &y)!=tinyxml2::XML_SUCCESS) {
+              std::ostringstream os; os << "Invalid channel mapping for detector \"" << detector << "\"!";
+              throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 42402);
+            }
+            geom.SetCell(board_id, channel_id, Cell(x, y));
+          }
+          geometries[detector] = geom;
+        }
+      }
+
+    private:
+      typedef std::map<std::string, DetectorGeometry> Registry;
+      static inline Registry& GetRegistry() { static Registry reg; return reg; }
+
+      unsigned int fNumBoards, fNumChannels;
+      unsigned int fWidth, fHeight;
+      std::vector<Cell> fCells;
+  };
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef EventStreamer_h
+#define EventStreamer_h
+
+#include <map>
+#include <set>
+#include <deque>
+#include <string>
+#include <sstream>
+#include <stdint.h>
+
+#include "SharedMemoryTap.h"
+#include "SocketMessage.h"
+#include "MessageFrame.h"
+
+/// Default port of the data stream (the control socket of the master being on 1987)
+#define STREAM_PORT 1988
+/// Maximal number of socket events handled at each loop iteration
+#define STREAM_MAX_EVENTS 64
+/// Interval between two polls of the live data tap (in ms)
+#define STREAM_POLL_MS 20
+/// Maximal number of words sent in one block
+#define STREAM_MAX_BLOCK_WORDS 65536
+/// Size of the pending output of a consumer above which the blocks are dropped, whatever its credits (in bytes)
+#define STREAM_MAX_OUTPUT 8388608
+/// Maximal size of the unparsed data kept for one consumer (in bytes)
+#define STREAM_MAX_INPUT 65536
+#define STREAM_MAGIC 0x52545350 // PSTR in ASCII
+
+/**
+ * \brief Header of each block of events sent to a consumer
+ * \note All fields, as the data words following them, are in the byte order
+ *  of the acquisition machine (as in the output files)
+ */
+struct stream_block_t {
+  uint32_t magic;
+  uint32_t board_address;
+  uint32_t run_id;
+  uint32_t spill_id;
+  uint32_t acq_mode;
+  uint32_t det_mode;
+  /// Number of events in this block
+  uint32_t num_events;
+  /// Number of 32-bit words following this header
+  uint32_t num_words;
+  /// Index of this block among all the ones sent to this consumer
+  uint64_t sequence;
+  /// Number of selected events not sent to this consumer so far (no credit left, or output full)
+  uint64_t num_dropped;
+  /// Number of words of this board lost by the streamer itself, overrun by the acquisition
+  uint64_t num_lost_words;
+};
+
+/**
+ * Streaming server feeding remote monitors with the raw event blocks
+ * published by the acquisition through the live data tap, on a dedicated
+ * port separate from the control socket of the master.
+ *
+ * The tap is only read, so the readout never waits for the streamer, and the
+ * streamer never waits for its consumers: each of them grants credits (one
+ * block each) through STREAM_CREDIT messages, and the events selected for
+ * a consumer with no credit left, or whose connection does not keep up, are
+ * dropped for it and counted in the next block it receives.
+ *
+ * A consumer subscribes with a STREAM_SUBSCRIBE message whose value is the
+ * prescaling factor (one event out of N is kept, per board), optionally
+ * followed by a comma-separated list of board addresses (e.g.
+ * "STREAM_SUBSCRIBE:10:1234,5678"). Events are delimited by the global
+ * trailers in trigger matching mode, each fetch of the tap being considered
+ * as one event in continuous storage mode.
+ * \brief Live event stream server
+ * \date 19 Oct 2026
+ * \ingroup Socket
+ */
+class EventStreamer
+{
+  public:
+    EventStreamer(int port=STREAM_PORT);
+    ~EventStreamer();
+
+    /// Listen for consumers on the stream port
+    bool Connect();
+    /// Close the connections of all consumers and the listening socket
+    void Disconnect();
+    /**
+     * Wait for activity on the consumer connections (at most STREAM_POLL_MS),
+     * then distribute all events newly published by the acquisition.
+     * \brief Handle one iteration of the event loop
+     */
+    void Process();
+    inline int GetPort() const { return fPort; }
+    inline unsigned int GetNumConsumers() const { return fConsumers.size(); }
+
+  private:
+    /**
+     * \brief Connection and selections of one consumer
+     */
+    struct Consumer {
+      Consumer() : subscribed(false), prescale(1), credits(0), sequence(0), num_dropped(0), output_offset(0), output_size(0) {;}
+      /// Has the consumer sent its subscription yet?
+      bool subscribed;
+      /// One event out of this number is selected for the consumer
+      unsigned int prescale;
+      /// Boards the consumer receives the events of (all if empty)
+      std::set<uint32_t> boards;
+      /// Number of events of each board seen for this consumer (for the prescaling)
+      std::map<uint32_t,uint64_t> num_seen;
+      /// Number of blocks the consumer is still ready to receive
+      uint64_t credits;
+      uint64_t sequence;
+      uint64_t num_dropped;
+      /// Data received and not yet parsed into messages
+      MessageFramer input;
+      /// Encoded blocks waiting for the socket to be writable
+      std::deque<std::string> output;
+      size_t output_offset;
+      size_t output_size;
+    };
+    /// Accept all consumers waiting on the listening socket
+    void AddConsumers();
+    void RemoveConsumer(int sid);
+    /**
+     * \brief Read and process all messages received from a consumer
+     * \return false if the consumer closed its connection or sent invalid data
+     */
+    bool ReadConsumer(int sid);
+    void ProcessMessage(const SocketMessage& m, int sid);
+    /// Send as much of the pending output of a consumer as the socket accepts
+    bool FlushConsumer(int sid);
+    /// Fetch the new events from the tap, and distribute them to all consumers
+    void PollTap();
+    /**
+     * \brief Send the selected events of one board to a consumer, if it may receive them
+     * \param[in] events Words of all events fetched
+     * \param[in] ends Index of the word following each event
+     */
+    void SendEvents(int sid, Consumer& c, unsigned int stream, const VME::TDCEventCollection& events, const std::vector<size_t>& ends);
+    /// Queue one block of events for a consumer
+    void SendBlock(Consumer& c, stream_block_t& block, const std::vector<uint32_t>& words);
+
+    int fPort;
+    int fSocketId;
+    int fEpollFd;
+    SharedMemoryTap fTap;
+    std::map<int,Consumer> fConsumers;
+    /// Consumers whose connection failed, to be closed at the end of the loop iteration
+    std::set<int> fBrokenConsumers;
+    char fBuffer[STREAM_MAX_INPUT];
+};
+
+#endif
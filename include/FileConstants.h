@@ -26,6 +26,40 @@ struct file_header_t {
   VME::DetectionMode det_mode;
 };
 
+/// Number of channels summarised for each board
+#define SUMMARY_NUM_CHANNELS 32
+#define SUMMARY_MAGIC 0x53535050 // PPSS in ASCII
+
+/**
+ * Compact digest of one output file, stored next to it with a ".summary"
+ * extension, from which the run trends can be built without decoding the
+ * raw data again.
+ * \brief Per-burst summary of one board's output file
+ * \date 19 Oct 2026
+ */
+struct burst_summary_t {
+  uint32_t magic;
+  uint32_t run_id;
+  uint32_t spill_id;
+  uint32_t board_address;
+  uint32_t acq_mode;
+  uint32_t num_triggers;
+  uint64_t num_words;
+  /// Number of words of each type (indexed by the 5-bit word type)
+  uint32_t num_words_by_type[32];
+  /// Number of leading edges recorded on each channel
+  uint32_t num_hits[SUMMARY_NUM_CHANNELS];
+  /// Sum of the times over threshold of each channel (in ns)
+  double sum_tot[SUMMARY_NUM_CHANNELS];
+  /// Logical OR of all error flags reported by the HPTDCs
+  uint32_t error_flags;
+  uint32_t num_errors;
+  /// First and last extended trigger time tags (0 if not recorded)
+  uint32_t first_ettt, last_ettt;
+  /// Time at which the file was opened and closed
+  int64_t time_start, time_end;
+};
+
 /// Generate a random string of fixed length for file name
 inline std::string GenerateString(const size_t len=5)
 {
@@ -0,0 +1,109 @@
+#ifndef FilePrefetcher_h
+#define FilePrefetcher_h
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <streambuf>
+#include <pthread.h>
+
+#include "Exception.h"
+
+/// Default amount of data (in MB) to read ahead of the decoder
+#define PREFETCH_MAX_MB 64
+/// Alignment of the prefetch buffers (page size, suitable for direct I/O)
+#define PREFETCH_ALIGNMENT 4096
+
+/**
+ * \brief Image of a data file fully loaded in memory
+ * \date 19 Oct 2026
+ */
+struct PrefetchedFile
+{
+  PrefetchedFile() : data(0), size(0), capacity(0), error(0) {;}
+  std::string path;
+  char* data;
+  size_t size;
+  size_t capacity;
+  /// errno value if the file could not be loaded
+  int error;
+};
+
+/**
+ * \brief Seekable input buffer over a memory region
+ * \date 19 Oct 2026
+ */
+class MemoryBuffer : public std::streambuf
+{
+  public:
+    inline MemoryBuffer() {;}
+    inline void Set(char* data, size_t size) { setg(data, data, data+size); }
+
+  protected:
+    inline pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which=std::ios_base::in) {
+      char* pos = gptr();
+      if (dir==std::ios_base::beg) pos = eback()+off;
+      else if (dir==std::ios_base::cur) pos = gptr()+off;
+      else if (dir==std::ios_base::end) pos = egptr()+off;
+      if (pos<eback() or pos>egptr()) return pos_type(off_type(-1));
+      setg(eback(), pos, egptr());
+      return pos_type(pos-eback());
+    }
+    inline pos_type seekpos(pos_type pos, std::ios_base::openmode which=std::ios_base::in) {
+      return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+/**
+ * Background reader loading the next files of a run into a pool of aligned
+ * memory buffers while the previous ones are being decoded, so that disk
+ * accesses and data decoding overlap.
+ * \brief Read-ahead stage for the offline readers
+ * \date 19 Oct 2026
+ */
+class FilePrefetcher
+{
+  public:
+    /**
+     * \param[in] max_mb Maximal amount of data (in MB) to load ahead of the decoder
+     */
+    FilePrefetcher(unsigned int max_mb=PREFETCH_MAX_MB);
+    ~FilePrefetcher();
+
+    /// Add a file to the list of files to read (in order)
+    void AddFile(const std::string& path);
+    /// Launch the background reading thread
+    void Start();
+    /**
+     * \brief Retrieve the next file loaded in memory
+     * \note This only waits if the disk is slower than the decoding
+     * \return false if all files were already retrieved
+     */
+    bool Next(PrefetchedFile* file);
+    /// Give a buffer back to the pool once its content is decoded
+    void Release(PrefetchedFile* file);
+
+  private:
+    static void* Process(void* arg);
+    void ReadFile(PrefetchedFile* file);
+    /// Size of the aligned buffer holding a file
+    static inline size_t GetCapacity(size_t size) { return ((size/PREFETCH_ALIGNMENT)+1)*PREFETCH_ALIGNMENT; }
+
+    size_t fMaxBytes;
+    /// Amount of data currently loaded and not yet released
+    size_t fBytesInFlight;
+    std::deque<std::string> fPending;
+    std::deque<PrefetchedFile> fReady;
+    /// Pool of aligned buffers ready to be reused
+    std::vector<PrefetchedFile> fPool;
+    /// Capacity of the buffers kept in the pool (counted in the memory budget)
+    size_t fBytesPooled;
+    bool fStarted, fStop;
+    unsigned int fNumQueued, fNumDelivered;
+
+    pthread_t fThread;
+    pthread_mutex_t fMutex;
+    pthread_cond_t fCondition;
+};
+
+#endif
@@ -9,10 +9,18 @@
 #include <iomanip>
 
 #include "FileConstants.h"
+#include "FilePrefetcher.h"
 #include "Exception.h"
 
 #include "VME_TDCMeasurement.h"
 
+/// Default maximal time (in ms) to wait for a new complete event in follow mode
+#define FOLLOW_WAIT_MS 500
+/// Default time (in s) without any file growth after which the writer is considered gone
+#define FOLLOW_IDLE_S 30
+/// Number of words in each time slice sampled in continuous storage mode
+#define SAMPLING_SLICE_WORDS 1024
+
 /**
  * \brief Handler for a TDC output file readout
  * \author Laurent Forthomme <laurent.forthomme@cern.ch>
@@ -21,7 +29,7 @@
 class FileReader
 {
   public:
-    inline FileReader() {;}
+    FileReader();
     /**
      * \brief Class constructor
      * \param[in] name Path to the file to read
@@ -31,10 +39,45 @@ class FileReader
     ~FileReader();
     
     void Open(std::string name);
-    inline bool IsOpen() const { return fFile.is_open(); }
-    inline void Clear() { fFile.clear(); fFile.seekg(sizeof(file_header_t), std::ios::beg); }
+    /**
+     * \brief Open the next file loaded in memory by a read-ahead stage
+     * \return false if no more files are to be read
+     */
+    bool Open(FilePrefetcher& prefetcher);
+    inline bool IsOpen() const { return (fFile.is_open() or fImage.data); }
+    inline void Clear() { fStream.clear(); fStream.seekg(sizeof(file_header_t), std::ios::beg); ResetSampling(); }
+
+    /**
+     * Read a file while the acquisition is still appending words to it. Only
+     * complete events (up to the last global trailer in trigger matching mode)
+     * are delivered to the caller. Must be called before Open().
+     * \brief Enable the tail-following mode
+     * \param[in] wait_ms Maximal time to wait for new data at each fetch
+     * \param[in] idle_s Time without any growth after which the file is considered closed
+     */
+    void SetFollowMode(bool follow=true, unsigned int wait_ms=FOLLOW_WAIT_MS, unsigned int idle_s=FOLLOW_IDLE_S);
+    inline bool IsFollowing() const { return fFollow; }
+    /// Has the writer released the file being followed?
+    inline bool IsWriterDone() const { return fWriterDone; }
+
+    /**
+     * Only decode one trigger out of a given number, all others being skipped
+     * at the word level. In continuous storage mode, where no trigger
+     * boundaries are available, one time slice of SAMPLING_SLICE_WORDS words
+     * is kept out of this number.
+     * \brief Set the sampling factor of the readout
+     */
+    inline void SetSampling(unsigned int factor) { fSampling = (factor>0) ? factor : 1; }
+    inline unsigned int GetSampling() const { return fSampling; }
+    /// Number of triggers (or time slices) encountered since the beginning of the file
+    inline unsigned long GetNumTriggersSeen() const { return fNumSeen; }
+    /// Number of triggers (or time slices) actually decoded
+    inline unsigned long GetNumTriggersSampled() const { return fNumSampled; }
+    /// Weight to apply to the counts of the decoded triggers to recover the full statistics
+    inline double GetSamplingWeight() const { return (fNumSampled>0) ? (double)fNumSeen/fNumSampled : 1.; }
 
     void Dump() const;    
+    inline const file_header_t& GetHeader() const { return fHeader; }
     inline unsigned int GetNumTDCs() const { return fHeader.num_hptdc; }
     inline unsigned int GetRunId() const { return fHeader.run_id; }
     inline unsigned int GetBurstId() const { return fHeader.spill_id; }
@@ -42,6 +85,11 @@ class FileReader
     inline unsigned int GetDetectionMode() const { return fHeader.det_mode; }
     
     unsigned long GetNumEvents() const { return fNumEvents; }
+    /**
+     * \brief Fetch the next data word
+     * \note In follow mode, a false return value only means no complete event
+     *  is available yet, unless IsWriterDone() is also true.
+     */
     bool GetNextEvent(VME::TDCEvent*);
     /**
      * \brief Fetch the next full measurement on a given channel
@@ -52,11 +100,48 @@ class FileReader
     bool GetNextMeasurement(unsigned int channel_id, VME::TDCMeasurement* mc);
     
   private:
+    /// Close the current input and release its resources
+    void Close();
+    /// Parse the file header once the input stream is set
+    void ReadHeader(const std::string& name, off_t size);
+    /// Read the next word, whether it is sampled or not
+    bool ReadWord(VME::TDCEvent*);
+    /// Is this word part of a sampled trigger (or time slice)?
+    bool IsSampled(const VME::TDCEvent&);
+    inline void ResetSampling() { fNumSeen = fNumSampled = fNumWords = 0; fKeepTrigger = true; }
+    /// Look for new complete events appended to the file being followed
+    bool Sync();
+    /// Wait for the writer to append (or release) the file being followed
+    bool WaitForData();
+
     std::ifstream fFile;
+    /// Prefetched file image (if read from memory)
+    PrefetchedFile fImage;
+    FilePrefetcher* fPrefetcher;
+    MemoryBuffer fMemory;
+    /// Input stream used for the readout (either the file or its memory image)
+    std::istream fStream;
+    std::string fFilename;
     file_header_t fHeader;
     VME::AcquisitionMode fReadoutMode;
     time_t fWriteTime;
     unsigned long fNumEvents;
+
+    bool fFollow, fWriterDone;
+    unsigned int fFollowWait, fFollowIdle;
+    /// File descriptor used to scan the appended words without moving the read pointer
+    int fScanFd;
+    /// inotify handler and watch descriptors (-1 if size polling is used)
+    int fNotifyFd, fWatchFd;
+    /// Size of the file already scanned for event boundaries
+    off_t fScannedSize;
+    /// Offset of the end of the last complete event found
+    off_t fCompleteSize;
+    time_t fLastGrowth;
+
+    unsigned int fSampling;
+    unsigned long fNumSeen, fNumSampled, fNumWords;
+    bool fKeepTrigger;
 };
 
 #endif
@@ -5,26 +5,30 @@
 #include "TStyle.h"
 #include "TDatime.h"
 
+#include "Histogram.h"
+#include "RenderScheduler.h"
+#include "DetectorGeometry.h"
+
 namespace DQM
 {
   /**
    * \author Laurent Forthomme <laurent.forthomme@cern.ch>
    * \date 25 Jul 2015
    */
-  class GastofCanvas : public TCanvas
+  class GastofCanvas : public TCanvas, public Renderable
   {
     public:
       inline GastofCanvas() :
-        TCanvas("null"), fLegend(0), fLegendX(.52), fLegendY(.76), fLegendNumEntries(0),
-        fUpperLabel(0), fLabelsDrawn(false), fRunId(0), fRunDate(TDatime().AsString()) {;}
+        TCanvas("null"), fGeometry(0), fLegend(0), fLegendX(.52), fLegendY(.76), fLegendNumEntries(0), fLabel3(0),
+        fUpperLabel(0), fLabelsDrawn(false), fBoardId(0), fRunId(0), fSpillId(0), fRunDate(TDatime().AsString()), fGridDrawn(false) {;}
       inline GastofCanvas(TString name, unsigned int width=500, unsigned int height=500, TString upper_label="") :
-        TCanvas(name, "", width, height), fWidth(width), fHeight(height), fLegend(0), fLegendX(.52), fLegendY(.76), fLegendNumEntries(0),
+        TCanvas(name, "", width, height), fGeometry(0), fWidth(width), fHeight(height), fLegend(0), fLegendX(.52), fLegendY(.76), fLegendNumEntries(0), fLabel3(0),
         fUpperLabelText(upper_label), fUpperLabel(0), fLabelsDrawn(false),
-        fRunId(0), fRunDate(TDatime().AsString()) { Build(); }
+        fBoardId(0), fRunId(0), fSpillId(0), fRunDate(TDatime().AsString()), fGridDrawn(false) { Build(); }
       inline GastofCanvas(TString name, TString upper_label) :
-        TCanvas(name, "", 500, 500), fWidth(500), fHeight(500), fLegend(0), fLegendX(.52), fLegendY(.76), fLegendNumEntries(0),
+        TCanvas(name, "", 500, 500), fGeometry(0), fWidth(500), fHeight(500), fLegend(0), fLegendX(.52), fLegendY(.76), fLegendNumEntries(0), fLabel3(0),
         fUpperLabelText(upper_label), fUpperLabel(0), fLabelsDrawn(false),
-        fRunId(0), fRunDate(TDatime().AsString()) { Build(); }
+        fBoardId(0), fRunId(0), fSpillId(0), fRunDate(TDatime().AsString()), fGridDrawn(false) { Build(); }
       inline virtual ~GastofCanvas() {
         if (fLegend) delete fLegend;
         if (fUpperLabel) delete fUpperLabel;
@@ -36,6 +40,7 @@ namespace DQM
         fRunId = run_id;
         fSpillId = spill_id;
         fRunDate = date;
+        MarkDirty();
       }
 
       inline void SetUpperLabel(TString text) {
@@ -54,11 +59,28 @@ namespace DQM
       }
 
       inline void FillChannel(unsigned short nino_id, unsigned short channel_id, double content) {
-        const Coord c = GetCoordinates(nino_id, channel_id);
+        const DetectorGeometry::Cell& c = fGeometry->GetCell(nino_id, channel_id);
+        if (!c.IsValid()) return;
         fHist->Fill(c.x-0.5, c.y-0.5, content);
+        MarkDirty();
+      }
+      /// Set the content of all channels from a histogram indexed by channel identifier
+      inline void FillChannels(unsigned short nino_id, const Histogram1D& h) {
+        fHist->Reset();
+        for (unsigned int i=0; i<h.GetNumBins(); i++) FillChannel(nino_id, i, h.GetBinContent(i+1));
       }
       inline TH2D* Grid() { return fHist; }
 
+      inline std::string GetOutputName() const { return TCanvas::GetName(); }
+      inline uint64_t GetContentChecksum() const {
+        uint64_t hash = Hash(TCanvas::GetName(), strlen(TCanvas::GetName()));
+        for (int i=0; i<fHist->GetSize(); i++) { const double content = fHist->GetBinContent(i); hash = Hash(&content, sizeof(double), hash); }
+        const unsigned int info[3] = { fBoardId, fRunId, fSpillId };
+        hash = Hash(info, sizeof(info), hash);
+        return Hash(fRunDate.Data(), fRunDate.Length(), hash);
+      }
+      inline void Render(const char* path) { Save("png", path); }
+
       inline void Save(TString ext="png", TString path=".") {
         bool valid_ext = true;
         valid_ext |= (strcmp(ext, "png")!=0);
@@ -114,6 +136,11 @@ namespace DQM
           SetUpperLabel(fUpperLabelText);
           fLabelsDrawn = true;
         }
+        else if (fLabel3) { // decorations are reused, only the run information is updated
+          fLabel3->Clear();
+          fLabel3->AddText(Form("Board %x, Run %d - Spill %d - %s", fBoardId>>16, fRunId, fSpillId, fRunDate.Data()));
+        }
+        c1->SetLogz(0);
         TCanvas::SaveAs(Form("%s/%s.%s", path.Data(), TCanvas::GetName(), ext.Data()));
         c1->SetLogz();
         TCanvas::SaveAs(Form("%s/%s_logscale.%s", path.Data(), TCanvas::GetName(), ext.Data()));
@@ -128,9 +155,11 @@ namespace DQM
         fLegend->SetTextFont(43);
         fLegend->SetTextSize(14);
     
-        fHist = new TH2D(Form("hist_%s", TCanvas::GetName()), "", 8, 0.5, 8.5, 8, 0.5, 8.5);
+        fGeometry = &DetectorGeometry::Get("gastof");
+        fHist = new TH2D(Form("hist_%s", TCanvas::GetName()), "", fGeometry->GetWidth(), 0.5, fGeometry->GetWidth()+0.5, fGeometry->GetHeight(), 0.5, fGeometry->GetHeight()+0.5);
       }
       inline void DrawGrid() {
+        if (fGridDrawn) { c1->Modified(); return; }
         TCanvas::cd();
         gStyle->SetOptStat(0);
 
@@ -159,93 +188,12 @@ namespace DQM
             
         c1->SetTicks(1, 1);
         //c1->SetGrid(1, 1);
+        fGridDrawn = true;
       }
       
-      struct Coord { unsigned int x; unsigned int y; };
-      inline Coord GetCoordinates(unsigned short nino_id, unsigned short channel_id) const {
-        Coord out;
-        out.x = out.y = 0;
-        switch (nino_id) {
-          case 0:
-            switch (channel_id) {
-              case 0:  out.x = 1, out.y = 1; break;
-              case 1:  out.x = 2, out.y = 1; break;
-              case 2:  out.x = 3, out.y = 1; break;
-              case 3:  out.x = 4, out.y = 1; break;
-              case 4:  out.x = 5, out.y = 1; break;
-              case 5:  out.x = 6, out.y = 1; break;
-              case 6:  out.x = 7, out.y = 1; break;
-              case 7:  out.x = 8, out.y = 1; break;
-              case 8:  out.x = 1, out.y = 2; break;
-              case 9:  out.x = 2, out.y = 2; break;
-              case 10: out.x = 7, out.y = 2; break;
-              case 11: out.x = 8, out.y = 2; break;
-              case 12: out.x = 1, out.y = 3; break;
-              case 13: out.x = 8, out.y = 3; break;
-              case 14: out.x = 1, out.y = 4; break;
-              case 15: out.x = 8, out.y = 4; break;
-              case 16: out.x = 1, out.y = 5; break;
-              case 17: out.x = 8, out.y = 5; break;
-              case 18: out.x = 1, out.y = 6; break;
-              case 19: out.x = 8, out.y = 6; break;
-              case 20: out.x = 1, out.y = 7; break;
-              case 21: out.x = 2, out.y = 7; break;
-              case 22: out.x = 7, out.y = 7; break;
-              case 23: out.x = 8, out.y = 7; break;
-              case 24: out.x = 1, out.y = 8; break;
-              case 25: out.x = 2, out.y = 8; break;
-              case 26: out.x = 3, out.y = 8; break;
-              case 27: out.x = 4, out.y = 8; break;
-              case 28: out.x = 5, out.y = 8; break;
-              case 29: out.x = 6, out.y = 8; break;
-              case 30: out.x = 7, out.y = 8; break;
-              case 31: out.x = 8, out.y = 8; break;
-            }
-            break;
-          case 1:
-            switch (channel_id) {
-              case 0:  out.x = 3, out.y = 2; break;
-              case 1:  out.x = 4, out.y = 2; break;
-              case 2:  out.x = 5, out.y = 2; break;
-              case 3:  out.x = 6, out.y = 2; break;
-              case 4:  out.x = 2, out.y = 3; break;
-              case 5:  out.x = 3, out.y = 3; break;
-              case 6:  out.x = 4, out.y = 3; break;
-              case 7:  out.x = 5, out.y = 3; break;
-              case 8:  out.x = 6, out.y = 3; break;
-              case 9:  out.x = 7, out.y = 3; break;
-              case 10: out.x = 2, out.y = 4; break;
-              case 11: out.x = 3, out.y = 4; break;
-              case 12: out.x = 4, out.y = 4; break;
-              case 13: out.x = 5, out.y = 4; break;
-              case 14: out.x = 6, out.y = 4; break;
-              case 15: out.x = 7, out.y = 4; break;
-              case 16: out.x = 2, out.y = 5; break;
-              case 17: out.x = 3, out.y = 5; break;
-              case 18: out.x = 4, out.y = 5; break;
-              case 19: out.x = 5, out.y = 5; break;
-              case 20: out.x = 6, out.y = 5; break;
-              case 21: out.x = 7, out.y = 5; break;
-              case 22: out.x = 2, out.y = 6; break;
-              case 23: out.x = 3, out.y = 6; break;
-              case 24: out.x = 4, out.y = 6; break;
-              case 25: out.x = 5, out.y = 6; break;
-              case 26: out.x = 6, out.y = 6; break;
-              case 27: out.x = 7, out.y = 6; break;
-              case 28: out.x = 3, out.y = 7; break;
-              case 29: out.x = 4, out.y = 7; break;
-              case 30: out.x = 5, out.y = 7; break;
-              case 31: out.x = 6, out.y = 7; break;
-            }
-            break;
-          default:
-            throw Exception(__PRETTY_FUNCTION__, Form("Invalid NINO identifier fetched! NINO: %d", nino_id), JustWarning);
-        }      
-        return out;
-      }
-
       TPad *c1, *c2;
       TH2D* fHist;
+      const DetectorGeometry* fGeometry;
       double fWidth, fHeight;
       TLegend *fLegend;
       double fLegendX, fLegendY;
@@ -256,5 +204,6 @@ namespace DQM
       bool fLabelsDrawn;
       unsigned int fBoardId, fRunId, fSpillId;
       TString fRunDate;
+      bool fGridDrawn;
   };
 }
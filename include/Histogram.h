@@ -0,0 +1,280 @@
+#ifndef Histogram_h
+#define Histogram_h
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "Exception.h"
+
+#define HIST_MAGIC 0x48535050 // PPSH in ASCII
+
+namespace DQM
+{
+  // relaxed atomic accesses: bins may be read and filled from any thread
+  inline double HistLoad(const double& v) { double out; __atomic_load(&v, &out, __ATOMIC_RELAXED); return out; }
+  inline void HistStore(double& v, double val) { __atomic_store(&v, &val, __ATOMIC_RELAXED); }
+  inline void HistAdd(double& v, double weight) {
+    double old = HistLoad(v), val;
+    do { val = old+weight; } while (!__atomic_compare_exchange(&v, &old, &val, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  }
+
+  /**
+   * Fixed binning histogram with under- and overflow bins, independent of
+   * ROOT. Its bins are updated atomically, so it can be filled and read from
+   * any thread, but concurrent fills of a same instance contend on its bins
+   * (see ShardedHistogram).
+   * \brief Lightweight one-dimensional histogram
+   * \date 19 Oct 2026
+   */
+  class Histogram1D
+  {
+    public:
+      inline Histogram1D(unsigned int num_bins=1, double min=0., double max=1.) :
+        fNumBins(num_bins), fMin(min), fMax(max), fScale(num_bins/(max-min)), fContent(num_bins+2, 0.), fEntries(0) {;}
+
+      inline unsigned int GetNumBins() const { return fNumBins; }
+      inline double GetMin() const { return fMin; }
+      inline double GetMax() const { return fMax; }
+      /// Bin index (0 for underflow, num_bins+1 for overflow)
+      inline unsigned int FindBin(double x) const {
+        if (x<fMin) return 0;
+        if (x>=fMax) return fNumBins+1;
+        return static_cast<unsigned int>((x-fMin)*fScale)+1;
+      }
+      inline void Fill(double x, double weight=1.) { AddToBin(FindBin(x), weight); }
+      /// Fill a bin by its index starting at 0 (e.g. a channel identifier)
+      inline void FillBin(unsigned int index, double weight=1.) { AddToBin((index<fNumBins) ? index+1 : fNumBins+1, weight); }
+      inline double GetBinContent(unsigned int bin) const { return (bin<fContent.size()) ? HistLoad(fContent[bin]) : 0.; }
+      inline double GetBinCenter(unsigned int bin) const { return fMin+(bin-0.5)/fScale; }
+      inline uint64_t GetEntries() const { return __atomic_load_n(&fEntries, __ATOMIC_RELAXED); }
+
+      inline bool SameBinning(const Histogram1D& h) const { return (h.fNumBins==fNumBins and h.fMin==fMin and h.fMax==fMax); }
+      inline void Add(const Histogram1D& h) {
+        if (!SameBinning(h)) throw Exception(__PRETTY_FUNCTION__, "Trying to add histograms with different binnings!", JustWarning, 42200);
+        for (unsigned int i=0; i<fContent.size(); i++) HistAdd(fContent[i], h.GetBinContent(i));
+        __atomic_fetch_add(&fEntries, h.GetEntries(), __ATOMIC_RELAXED);
+      }
+      inline void Reset() {
+        for (unsigned int i=0; i<fContent.size(); i++) HistStore(fContent[i], 0.);
+        __atomic_store_n(&fEntries, 0, __ATOMIC_RELAXED);
+      }
+
+      /// Write a compact binary image of the histogram
+      inline void Write(std::ostream& out) const {
+        const uint32_t magic = HIST_MAGIC, dim = 1, num_bins = fNumBins;
+        const uint64_t entries = GetEntries();
+        out.write((char*)&magic, sizeof(uint32_t));
+        out.write((char*)&dim, sizeof(uint32_t));
+        out.write((char*)&num_bins, sizeof(uint32_t));
+        out.write((char*)&fMin, sizeof(double));
+        out.write((char*)&fMax, sizeof(double));
+        out.write((char*)&entries, sizeof(uint64_t));
+        for (unsigned int i=0; i<fContent.size(); i++) { const double c = GetBinContent(i); out.write((char*)&c, sizeof(double)); }
+      }
+      /// Retrieve the binning and content from a binary image (to be called while no thread is filling)
+      inline void Read(std::istream& in) {
+        uint32_t magic, dim, num_bins; double min, max; uint64_t entries;
+        in.read((char*)&magic, sizeof(uint32_t));
+        in.read((char*)&dim, sizeof(uint32_t));
+        in.read((char*)&num_bins, sizeof(uint32_t));
+        in.read((char*)&min, sizeof(double));
+        in.read((char*)&max, sizeof(double));
+        in.read((char*)&entries, sizeof(uint64_t));
+        if (!in.good() or magic!=HIST_MAGIC or dim!=1) throw Exception(__PRETTY_FUNCTION__, "Invalid histogram snapshot!", JustWarning, 42201);
+        *this = Histogram1D(num_bins, min, max);
+        in.read((char*)&fContent[0], fContent.size()*sizeof(double));
+        if (!in.good()) throw Exception(__PRETTY_FUNCTION__, "Truncated histogram snapshot!", JustWarning, 42201);
+        fEntries = entries;
+      }
+
+    protected:
+      inline void AddToBin(unsigned int bin, double weight) {
+        HistAdd(fContent[bin], weight);
+        __atomic_fetch_add(&fEntries, 1, __ATOMIC_RELAXED);
+      }
+
+      unsigned int fNumBins;
+      double fMin, fMax, fScale;
+      std::vector<double> fContent;
+      uint64_t fEntries;
+  };
+
+  /**
+   * \brief Lightweight two-dimensional histogram (e.g. one distribution per channel)
+   * \date 19 Oct 2026
+   */
+  class Histogram2D
+  {
+    public:
+      inline Histogram2D(unsigned int num_bins_x=1, double min_x=0., double max_x=1., unsigned int num_bins_y=1, double min_y=0., double max_y=1.) :
+        fX(num_bins_x, min_x, max_x), fY(num_bins_y, min_y, max_y), fContent((num_bins_x+2)*(num_bins_y+2), 0.), fEntries(0) {;}
+
+      inline const Histogram1D& GetXAxis() const { return fX; }
+      inline const Histogram1D& GetYAxis() const { return fY; }
+      inline unsigned int FindBin(double x, double y) const { return Bin(fX.FindBin(x), fY.FindBin(y)); }
+      inline void Fill(double x, double y, double weight=1.) { AddToBin(FindBin(x, y), weight); }
+      /// Fill the distribution of one channel (x bin given by its index)
+      inline void FillChannel(unsigned int channel_id, double y, double weight=1.) {
+        const unsigned int bin_x = (channel_id<fX.GetNumBins()) ? channel_id+1 : fX.GetNumBins()+1;
+        AddToBin(Bin(bin_x, fY.FindBin(y)), weight);
+      }
+      inline double GetBinContent(unsigned int bin_x, unsigned int bin_y) const {
+        const unsigned int bin = Bin(bin_x, bin_y);
+        return (bin<fContent.size()) ? HistLoad(fContent[bin]) : 0.;
+      }
+      inline uint64_t GetEntries() const { return __atomic_load_n(&fEntries, __ATOMIC_RELAXED); }
+
+      inline void Add(const Histogram2D& h) {
+        if (!fX.SameBinning(h.fX) or !fY.SameBinning(h.fY)) throw Exception(__PRETTY_FUNCTION__, "Trying to add histograms with different binnings!", JustWarning, 42200);
+        for (unsigned int i=0; i<fContent.size(); i++) HistAdd(fContent[i], HistLoad(h.fContent[i]));
+        __atomic_fetch_add(&fEntries, h.GetEntries(), __ATOMIC_RELAXED);
+      }
+      inline void Reset() {
+        for (unsigned int i=0; i<fContent.size(); i++) HistStore(fContent[i], 0.);
+        __atomic_store_n(&fEntries, 0, __ATOMIC_RELAXED);
+      }
+
+      inline void Write(std::ostream& out) const {
+        const uint32_t magic = HIST_MAGIC, dim = 2, nx = fX.GetNumBins(), ny = fY.GetNumBins();
+        const double min_x = fX.GetMin(), max_x = fX.GetMax(), min_y = fY.GetMin(), max_y = fY.GetMax();
+        const uint64_t entries = GetEntries();
+        out.write((char*)&magic, sizeof(uint32_t));
+        out.write((char*)&dim, sizeof(uint32_t));
+        out.write((char*)&nx, sizeof(uint32_t));
+        out.write((char*)&min_x, sizeof(double));
+        out.write((char*)&max_x, sizeof(double));
+        out.write((char*)&ny, sizeof(uint32_t));
+        out.write((char*)&min_y, sizeof(double));
+        out.write((char*)&max_y, sizeof(double));
+        out.write((char*)&entries, sizeof(uint64_t));
+        for (unsigned int i=0; i<fContent.size(); i++) { const double c = HistLoad(fContent[i]); out.write((char*)&c, sizeof(double)); }
+      }
+      inline void Read(std::istream& in) {
+        uint32_t magic, dim, nx, ny; double min_x, max_x, min_y, max_y; uint64_t entries;
+        in.read((char*)&magic, sizeof(uint32_t));
+        in.read((char*)&dim, sizeof(uint32_t));
+        in.read((char*)&nx, sizeof(uint32_t));
+        in.read((char*)&min_x, sizeof(double));
+        in.read((char*)&max_x, sizeof(double));
+        in.read((char*)&ny, sizeof(uint32_t));
+        in.read((char*)&min_y, sizeof(double));
+        in.read((char*)&max_y, sizeof(double));
+        in.read((char*)&entries, sizeof(uint64_t));
+        if (!in.good() or magic!=HIST_MAGIC or dim!=2) throw Exception(__PRETTY_FUNCTION__, "Invalid histogram snapshot!", JustWarning, 42201);
+        *this = Histogram2D(nx, min_x, max_x, ny, min_y, max_y);
+        in.read((char*)&fContent[0], fContent.size()*sizeof(double));
+        if (!in.good()) throw Exception(__PRETTY_FUNCTION__, "Truncated histogram snapshot!", JustWarning, 42201);
+        fEntries = entries;
+      }
+
+    private:
+      inline unsigned int Bin(unsigned int bin_x, unsigned int bin_y) const { return bin_y*(fX.GetNumBins()+2)+bin_x; }
+      inline void AddToBin(unsigned int bin, double weight) {
+        HistAdd(fContent[bin], weight);
+        __atomic_fetch_add(&fEntries, 1, __ATOMIC_RELAXED);
+      }
+
+      /// Axes definition (their content is not used)
+      Histogram1D fX, fY;
+      std::vector<double> fContent;
+      uint64_t fEntries;
+  };
+
+  /**
+   * Set of identical histograms, one per filling thread, so that any number
+   * of decoding threads may fill it concurrently without contending on the
+   * same bins. The shards are only summed when a snapshot is requested. The
+   * shard of a thread is folded into the others once this thread exits.
+   * \brief Histogram filled concurrently from several threads
+   * \date 19 Oct 2026
+   */
+  template<class H>
+  class ShardedHistogram
+  {
+    public:
+      /// Build from a model histogram defining the binning
+      inline ShardedHistogram(const H& model) : fModel(model) {
+        fModel.Reset();
+        fRetired = fModel;
+        pthread_key_create(&fKey, ShardedHistogram::ReleaseShard);
+        pthread_mutex_init(&fMutex, NULL);
+        pthread_mutex_init(&fWriteMutex, NULL);
+      }
+      inline ~ShardedHistogram() {
+        pthread_key_delete(fKey); // no shard is released from now on
+        for (typename std::vector<Shard*>::iterator s=fShards.begin(); s!=fShards.end(); s++) delete *s;
+        pthread_mutex_destroy(&fMutex);
+        pthread_mutex_destroy(&fWriteMutex);
+      }
+
+      /// Shard owned by the calling thread, to be filled without any lock
+      inline H& Local() {
+        Shard* shard = static_cast<Shard*>(pthread_getspecific(fKey));
+        if (shard) return shard->hist;
+        shard = new Shard(this, fModel);
+        pthread_mutex_lock(&fMutex);
+        fShards.push_back(shard);
+        pthread_mutex_unlock(&fMutex);
+        pthread_setspecific(fKey, shard);
+        return shard->hist;
+      }
+      /// Sum of all shards at the time of the call
+      inline H Snapshot() {
+        pthread_mutex_lock(&fMutex);
+        H out(fRetired);
+        for (typename std::vector<Shard*>::const_iterator s=fShards.begin(); s!=fShards.end(); s++) out.Add((*s)->hist);
+        pthread_mutex_unlock(&fMutex);
+        return out;
+      }
+      /// Reset all shards (fills happening meanwhile may be kept or not)
+      inline void Reset() {
+        pthread_mutex_lock(&fMutex);
+        fRetired.Reset();
+        for (typename std::vector<Shard*>::iterator s=fShards.begin(); s!=fShards.end(); s++) (*s)->hist.Reset();
+        pthread_mutex_unlock(&fMutex);
+      }
+      /// Store the merged content into a binary snapshot file
+      inline void SaveSnapshot(const std::string& path) {
+        const H snapshot = Snapshot();
+        // written to a temporary file, then atomically replacing the previous snapshot
+        const std::string tmp = path+".tmp";
+        pthread_mutex_lock(&fWriteMutex);
+        std::ofstream out(tmp.c_str(), std::ios::binary);
+        if (out.is_open()) { snapshot.Write(out); out.close(); }
+        const bool ok = (!out.fail() and rename(tmp.c_str(), path.c_str())==0);
+        pthread_mutex_unlock(&fWriteMutex);
+        if (!ok) throw Exception(__PRETTY_FUNCTION__, "Failed to write the histogram snapshot file!", JustWarning, 42202);
+      }
+
+    private:
+      struct Shard {
+        Shard(ShardedHistogram* o, const H& model) : owner(o), hist(model) {;}
+        ShardedHistogram* owner;
+        H hist;
+      };
+      /// Fold the shard of an exiting thread into the retired content
+      static void ReleaseShard(void* arg) {
+        Shard* shard = static_cast<Shard*>(arg);
+        ShardedHistogram* sh = shard->owner;
+        pthread_mutex_lock(&sh->fMutex);
+        sh->fRetired.Add(shard->hist);
+        for (typename std::vector<Shard*>::iterator s=sh->fShards.begin(); s!=sh->fShards.end(); s++) {
+          if (*s==shard) { sh->fShards.erase(s); break; }
+        }
+        pthread_mutex_unlock(&sh->fMutex);
+        delete shard;
+      }
+
+      H fModel, fRetired;
+      pthread_key_t fKey;
+      pthread_mutex_t fMutex, fWriteMutex;
+      std::vector<Shard*> fShards;
+  };
+}
+
+#endif
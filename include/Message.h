@@ -3,6 +3,7 @@
 
 #include <string>
 #include <iostream>
+#include <stdint.h>
 
 #include "MessageKeys.h"
 
@@ -16,17 +17,25 @@ class Message
 {
   public:
     /// Void message constructor
-    inline Message() : fString("") {;}
+    inline Message() : fString(""), fRequestId(0), fSequence(0) {;}
     /// Construct a message from a string
-    inline Message(const char* msg) : fString(msg) {;}
+    inline Message(const char* msg) : fString(msg), fRequestId(0), fSequence(0) {;}
     /// Construct a message from a string
-    inline Message(std::string msg) : fString(msg) {;}
+    inline Message(std::string msg) : fString(msg), fRequestId(0), fSequence(0) {;}
     inline virtual ~Message() {;}
     
     /// Placeholder for the MessageKey retrieval method
     inline MessageKey GetKey() const { return INVALID_KEY; }
     /// Retrieve the string carried by this message as a whole
-    inline std::string GetString() const { return fString; }
+    inline const std::string& GetString() const { return fString; }
+    /// Set the identifier matching a request with its answer (0 if none)
+    inline void SetRequestId(uint32_t id) { fRequestId = id; }
+    /// Identifier matching a request with its answer (0 if none)
+    inline uint32_t GetRequestId() const { return fRequestId; }
+    /// Set the rank of this message among the ones published by the master for its key (0 if none)
+    inline void SetSequence(uint64_t seq) { fSequence = seq; }
+    /// Rank of this message among the ones published by the master for its key (0 if none)
+    inline uint64_t GetSequence() const { return fSequence; }
     
     /// Extract from any message its potential arrival from a WebSocket protocol
     inline bool IsFromWeb() const {
@@ -42,6 +51,8 @@ class Message
     
   protected:
     std::string fString;
+    uint32_t fRequestId;
+    uint64_t fSequence;
 };
 
 #endif
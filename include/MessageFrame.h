@@ -0,0 +1,197 @@
+#ifndef MessageFrame_h
+#define MessageFrame_h
+
+#include <string>
+#include <sstream>
+#include <stdint.h>
+
+#include "Exception.h"
+#include "StringRef.h"
+
+/// First two bytes of each frame (the first one is never found in a text message)
+#define FRAME_MAGIC_0 0xFE
+#define FRAME_MAGIC_1 0x50
+#define FRAME_HEADER_SIZE 8
+/// Maximal size of a message payload (in bytes)
+#define FRAME_MAX_LENGTH 16777216
+/// The payload holds non-printable data
+#define FRAME_BINARY 0x1
+/// The header is followed by the identifier of the request this message belongs to
+#define FRAME_REQUEST 0x2
+#define FRAME_REQUEST_ID_SIZE 4
+/// The header is followed by the sequence number of this message among the ones of its key
+#define FRAME_SEQUENCE 0x4
+#define FRAME_SEQUENCE_SIZE 8
+
+/**
+ * Splits a stream of bytes received from a socket into messages, whatever
+ * the way they were coalesced or split by the transport. Each message is
+ * sent as one frame made of an 8-byte header (magic number, flags, and
+ * payload length in network order) followed by the payload. Requests and
+ * their answers additionally carry a 4-byte identifier between the header
+ * and the payload, used to match them whatever the other messages exchanged
+ * meanwhile. The messages published by the master which may be replayed to
+ * a reconnecting client are followed by their 8-byte sequence number. Peers sending null-terminated text messages without any
+ * framing are still understood (without request identifiers).
+ * \brief Framing of the socket messages
+ * \date 19 Oct 2026
+ * \ingroup Socket
+ */
+class MessageFramer
+{
+  public:
+    /// Framing used by the peer, as detected from its first bytes
+    typedef enum { Unknown=-1, Framed=0, Legacy } Mode;
+
+    inline MessageFramer() : fOffset(0), fMode(Unknown) {;}
+
+    /**
+     * \brief Build the frame transporting a message
+     * \param[in] request_id Identifier of the request/answer (0 if none)
+     * \param[in] sequence Sequence number of the published message (0 if none)
+     * \note The null terminator of text messages is not transmitted
+     */
+    static inline std::string Encode(const std::string& message, uint32_t request_id=0, uint64_t sequence=0) {
+      std::string frame;
+      EncodeTo(&frame, StringRef(message), request_id, sequence);
+      return frame;
+    }
+    /**
+     * \brief Append the frame transporting a message to a buffer
+     * \note The buffer is only reallocated if its capacity is exceeded
+     */
+    static inline void EncodeTo(std::string* out, StringRef message, uint32_t request_id=0, uint64_t sequence=0) {
+      if (!message.empty() and message[message.size()-1]=='\0') message = message.substr(0, message.size()-1);
+      if (message.size()>FRAME_MAX_LENGTH) throw Exception(__PRETTY_FUNCTION__, "Message is too long to be sent!", JustWarning, 11010);
+      const bool binary = (message.find('\0')!=StringRef::npos);
+      AppendHeader(out, message.size(), binary, request_id, sequence);
+      out->append(message.data(), message.size());
+    }
+    /**
+     * \brief Build the frame transporting a block of binary data
+     * \note Contrary to Encode, all bytes are transmitted as is
+     */
+    static inline std::string EncodeBinary(const char* data, size_t length) {
+      if (length>FRAME_MAX_LENGTH) throw Exception(__PRETTY_FUNCTION__, "Message is too long to be sent!", JustWarning, 11010);
+      std::string frame;
+      AppendHeader(&frame, length, true, 0, 0);
+      frame.append(data, length);
+      return frame;
+    }
+
+    /// Add the bytes received from the socket
+    inline void Append(const char* data, size_t size) {
+      if (fOffset>0 and fOffset>=fBuffer.size()/2) { fBuffer.erase(0, fOffset); fOffset = 0; }
+      fBuffer.append(data, size);
+      if (fMode==Unknown and fBuffer.size()>fOffset) {
+        fMode = (static_cast<unsigned char>(fBuffer[fOffset])==FRAME_MAGIC_0) ? Framed : Legacy;
+      }
+    }
+    /**
+     * \brief Extract the next complete message received
+     * \param[out] request_id Identifier of the request/answer (0 if none)
+     * \param[out] sequence Sequence number of the published message (0 if none)
+     * \return false if no complete message was received yet
+     */
+    inline bool Next(std::string* payload, uint32_t* request_id=0, uint64_t* sequence=0) {
+      StringRef ref;
+      if (!Next(&ref, request_id, sequence)) return false;
+      payload->assign(ref.data(), ref.size());
+      return true;
+    }
+    /**
+     * \brief Extract the next complete message received, without copying it
+     * \note The message refers to the internal buffer, and is only valid until
+     *  the next bytes are appended
+     */
+    inline bool Next(StringRef* payload, uint32_t* request_id=0, uint64_t* sequence=0) {
+      if (request_id) *request_id = 0;
+      if (sequence) *sequence = 0;
+      if (fMode==Legacy) {
+        size_t end;
+        while ((end=fBuffer.find('\0', fOffset))!=std::string::npos) {
+          const size_t start = fOffset;
+          fOffset = end+1;
+          if (end>start) { *payload = StringRef(fBuffer.data()+start, end-start); return true; }
+        }
+        return false;
+      }
+      size_t start, length;
+      if (!GetFrame(&start, &length)) return false;
+      const unsigned char* header = reinterpret_cast<const unsigned char*>(fBuffer.data()+fOffset);
+      size_t pos = FRAME_HEADER_SIZE;
+      if (header[2]&FRAME_REQUEST) {
+        if (request_id) for (unsigned int i=0; i<FRAME_REQUEST_ID_SIZE; i++) *request_id = (*request_id<<8)|header[pos+i];
+        pos += FRAME_REQUEST_ID_SIZE;
+      }
+      if (sequence and (header[2]&FRAME_SEQUENCE)) {
+        for (unsigned int i=0; i<FRAME_SEQUENCE_SIZE; i++) *sequence = (*sequence<<8)|header[pos+i];
+      }
+      *payload = StringRef(fBuffer.data()+fOffset+start, length);
+      fOffset += start+length;
+      return true;
+    }
+    /**
+     * \brief Extract the unterminated data of a peer without framing as one message
+     * \note To be called once everything available on the socket was read
+     */
+    inline bool FlushLegacy(std::string* payload) {
+      if (fMode!=Legacy or fOffset>=fBuffer.size()) return false;
+      payload->assign(fBuffer, fOffset, std::string::npos);
+      fBuffer.clear(); fOffset = 0;
+      return true;
+    }
+    /// Is a complete message waiting to be extracted?
+    inline bool HasMessage() const {
+      if (fMode==Legacy) return (fBuffer.find('\0', fOffset)!=std::string::npos);
+      size_t start, length;
+      return GetFrame(&start, &length);
+    }
+    inline Mode GetMode() const { return fMode; }
+    /// Number of bytes received and not extracted yet
+    inline size_t GetBufferedSize() const { return fBuffer.size()-fOffset; }
+
+  private:
+    static inline void AppendHeader(std::string* out, size_t length, bool binary, uint32_t request_id, uint64_t sequence) {
+      char header[FRAME_HEADER_SIZE+FRAME_REQUEST_ID_SIZE+FRAME_SEQUENCE_SIZE];
+      header[0] = static_cast<char>(FRAME_MAGIC_0);
+      header[1] = static_cast<char>(FRAME_MAGIC_1);
+      header[2] = (binary ? FRAME_BINARY : 0)|(request_id!=0 ? FRAME_REQUEST : 0)|(sequence!=0 ? FRAME_SEQUENCE : 0);
+      header[3] = 0;
+      for (unsigned int i=0; i<4; i++) header[4+i] = static_cast<char>((length>>(8*(3-i)))&0xFF);
+      size_t size = FRAME_HEADER_SIZE;
+      if (request_id!=0) {
+        for (unsigned int i=0; i<FRAME_REQUEST_ID_SIZE; i++) header[size+i] = static_cast<char>((request_id>>(8*(3-i)))&0xFF);
+        size += FRAME_REQUEST_ID_SIZE;
+      }
+      if (sequence!=0) {
+        for (unsigned int i=0; i<FRAME_SEQUENCE_SIZE; i++) header[size+i] = static_cast<char>((sequence>>(8*(7-i)))&0xFF);
+        size += FRAME_SEQUENCE_SIZE;
+      }
+      out->append(header, size);
+    }
+    /// Is a complete frame available? (and where is its payload)
+    inline bool GetFrame(size_t* start, size_t* length) const {
+      if (fBuffer.size()-fOffset<FRAME_HEADER_SIZE) return false;
+      const unsigned char* header = reinterpret_cast<const unsigned char*>(fBuffer.data()+fOffset);
+      if (header[0]!=FRAME_MAGIC_0 or header[1]!=FRAME_MAGIC_1) {
+        throw Exception(__PRETTY_FUNCTION__, "Invalid frame header received!", JustWarning, 11011);
+      }
+      *length = 0;
+      for (unsigned int i=0; i<4; i++) *length = (*length<<8)|header[4+i];
+      if (*length>FRAME_MAX_LENGTH) {
+        std::ostringstream os; os << "Invalid frame length received: " << *length << " bytes!";
+        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 11011);
+      }
+      *start = FRAME_HEADER_SIZE;
+      if (header[2]&FRAME_REQUEST) *start += FRAME_REQUEST_ID_SIZE;
+      if (header[2]&FRAME_SEQUENCE) *start += FRAME_SEQUENCE_SIZE;
+      return (fBuffer.size()-fOffset>=*start+*length);
+    }
+
+    std::string fBuffer;
+    size_t fOffset;
+    Mode fMode;
+};
+
+#endif
@@ -12,22 +12,26 @@ MESSAGES_ENUM(\
   
   // client messages
   ADD_CLIENT, REMOVE_CLIENT, GET_CLIENTS, CLIENT_TYPE, PING_CLIENT,\
-  GET_RUN_NUMBER, SET_NEW_FILENAME, NEW_RUN,\
+  GET_RUN_NUMBER, SET_NEW_FILENAME, SET_LIVE_FILENAME, NEW_RUN,\
+  SUBSCRIBE, UNSUBSCRIBE, RESUME,\
   
   // master messages
   MASTER_BROADCAST, MASTER_DISCONNECT,\
   SET_CLIENT_ID,\
   THIS_CLIENT_DELETED, OTHER_CLIENT_DELETED,\
-  CLIENTS_LIST, GET_CLIENT_TYPE, PING_ANSWER,\
+  CLIENTS_LIST, GET_CLIENT_TYPE, PING_ANSWER, RESUMED,\
   ACQUISITION_STARTED, ACQUISITION_STOPPED,\
-  RUN_NUMBER, NEW_FILENAME,\
+  RUN_NUMBER, NEW_FILENAME, LIVE_FILENAME,\
   
   // web socket messages
   WEB_GET_CLIENTS,\
   START_ACQUISITION, STOP_ACQUISITION,\
 
   // DQM messages
-  NEW_DQM_PLOT, UPDATED_DQM_PLOT, NUM_TRIGGERS, HV_STATUS,\
+  NEW_DQM_PLOT, UPDATED_DQM_PLOT, NUM_TRIGGERS, HV_STATUS, DQM_QUEUE_STATUS,\
+
+  // data stream messages
+  STREAM_SUBSCRIBE, STREAM_CREDIT,\
 
   // other
   OTHER_MESSAGE,\
@@ -4,8 +4,33 @@
 #include "Socket.h"
 #include "OnlineDBHandler.h"
 
+#include <map>
+#include <set>
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <string>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+
+/// Maximal number of socket events handled at each loop iteration
+#define MESSENGER_MAX_EVENTS 64
+/// Maximal size of the unparsed data kept for one client, on top of one full frame (in bytes)
+#define MESSENGER_MAX_INPUT 1048576
+/// Size of the pending output of a client above which the monitoring updates are dropped (in bytes)
+#define MESSENGER_OUTPUT_HIGH_WATER 1048576
+/// Size of the pending output of a client above which it is disconnected (in bytes)
+#define MESSENGER_MAX_OUTPUT 33554432
+/// Time given to a client to answer a request forwarded by the messenger (in seconds)
+#define MESSENGER_REQUEST_TIMEOUT 5
+/// Number of threads running the blocking operations (database accesses, process control)
+#define MESSENGER_NUM_WORKERS 2
+/// Number of published messages of each key kept to be replayed to the reconnecting clients
+#define MESSENGER_REPLAY_SIZE 1024
 
 /**
  * Messenger/broadcaster object used by the server to send/receive commands from
@@ -26,7 +51,9 @@ class Messenger : public Socket
     ~Messenger();
 
     /**
-     * Connect this master to the socket for clients to be able to bind.
+     * Connect this master to the socket for clients to be able to bind. The
+     * clients are accepted on the TCP port, and also on the local socket if
+     * its path is configured (see Socket::GetLocalPath).
      * \brief Connect the master to the socket
      */
     bool Connect();
@@ -38,45 +65,173 @@ class Messenger : public Socket
     void Disconnect();
         
     /**
+     * The message is queued for the client, and written once the socket is
+     * writable, along with all other messages pending for this client. Slow
+     * clients lose their monitoring updates once their queue goes beyond the
+     * high-water mark, and are disconnected if it keeps on growing.
      * \brief Send any type of message to any client
      * \param[in] m Message to transmit
      * \param[in] sid Unique identifier of the client on this socket
      */
-    void Send(const Message& m, int sid) const;
+    inline void Send(const Message& m, int sid) { Send(SocketMessageView(m), sid); }
+    /// Send a message parsed in place (e.g. forwarded from another client)
+    void Send(const SocketMessageView& m, int sid);
     /**
-     * \brief Send any type of message to all clients of one type
-     * \param[in] type Client type
+     * The message is delivered to the clients of this type which did not
+     * restrict their subscriptions for its key, and to all clients (whatever
+     * their type) which subscribed to its key and attribute. The file names
+     * and run numbers are numbered and kept in the replay log of their key,
+     * for the clients missing them to catch up after reconnecting.
+     * \brief Publish a message to its subscribers
+     * \param[in] type Type of the clients receiving it by default
      * \param[in] m Message to transmit
      */
-    inline void SendAll(const Socket::SocketType& type, const Message& m) const {
-      for (SocketCollection::const_iterator it=fSocketsConnected.begin(); it!=fSocketsConnected.end(); it++) {
-        if (it->second==type) Send(m, it->first);
-      }
+    void SendAll(const Socket::SocketType& type, const SocketMessageView& m);
+    inline void SendAll(const Socket::SocketType& type, const SocketMessage& m) {
+      SendAll(type, SocketMessageView(m));
     }
-    inline void SendAll(const Socket::SocketType& type, const Exception& e) const {
-      for (SocketCollection::const_iterator it=fSocketsConnected.begin(); it!=fSocketsConnected.end(); it++) {
-        if (it->second==type) Send(SocketMessage(EXCEPTION, e.OneLine()), it->first);
-      }
+    inline void SendAll(const Socket::SocketType& type, const Exception& e) {
+      SendAll(type, SocketMessage(EXCEPTION, e.OneLine()));
     }
-    /// Handle a message reception from a client
+    /**
+     * Wait for activity on any connection, then accept all new clients, read
+     * and process all complete messages received, and flush the pending
+     * outputs of all writable clients.
+     * \brief Handle one iteration of the event loop
+     */
     void Receive();
     /**
      * \brief Emit a message to all clients connected through the socket
      * \param[in] m Message to transmit
      */
-    void Broadcast(const Message& m) const;
-    /// Start the data acquisition
+    void Broadcast(const Message& m);
+    /**
+     * The acquisition process is launched, and the run number retrieved, by
+     * a worker thread ; the clients are notified once it is done.
+     * \brief Start the data acquisition
+     */
     void StartAcquisition();
     void StopAcquisition();
     /// Socket actor type retrieval method
     inline SocketType GetType() const { return MASTER; }
   private:
     /**
-     * Add one client to the list of socket actors to monitor for message
-     * retrieval/submission.
-     * \brief Add a client to listen to
+     * \brief Messages of one key a client subscribed to
+     */
+    struct Subscription {
+      Subscription() : all(false) {;}
+      /// Are all messages of this key accepted, whatever their attribute?
+      bool all;
+      /// Attributes of the messages accepted (board addresses, channels, detector types...), sorted
+      std::vector<std::string> attributes;
+      /// Is a message with this attribute accepted?
+      inline bool Accepts(const StringRef& attribute) const {
+        if (all) return true;
+        size_t low = 0, high = attributes.size();
+        while (low<high) {
+          const size_t mid = (low+high)/2;
+          const int cmp = attribute.compare(attributes[mid]);
+          if (cmp==0) return true;
+          if (cmp>0) low = mid+1;
+          else high = mid;
+        }
+        return false;
+      }
+    };
+    typedef std::map<MessageKey,Subscription> Subscriptions;
+    /**
+     * \brief Message kept to be replayed to the reconnecting clients
+     */
+    struct Publication {
+      /// Sequence number of the message among the ones of its key
+      uint64_t sequence;
+      /// Rank of the message among all the ones published, whatever their key
+      uint64_t order;
+      MessageKey key;
+      /// Type of the clients receiving it by default
+      SocketType type;
+      std::string message;
+    };
+    typedef std::deque<Publication> ReplayLog;
+    /**
+     * \brief Buffers of one client connection
+     */
+    struct Connection {
+      Connection() : serial(0), output_offset(0), num_dropped(0) {;}
+      /// Unique number of this connection (its descriptor being reused after it is closed)
+      uint64_t serial;
+      /// Number of bytes waiting to be sent
+      inline size_t OutputSize() const { return output.size()-output_offset; }
+      /// Data received and not yet parsed into messages
+      MessageFramer input;
+      /// Encoded messages waiting for the socket to be writable (its capacity being kept between writes)
+      std::string output;
+      /// Number of bytes of the output already sent
+      size_t output_offset;
+      /// Number of messages dropped since the queue went beyond the high-water mark
+      unsigned long num_dropped;
+      /// Message keys for which the client chose what it receives
+      Subscriptions subscriptions;
+    };
+    /**
+     * \brief Request forwarded to a client, waiting for its answer
+     */
+    struct Request {
+      /// Client which issued the request
+      int requester;
+      /// Identifier given by the requester to its request
+      uint32_t requester_id;
+      /// Client the request was forwarded to
+      int target;
+      /// Key of the expected answer
+      MessageKey answer;
+      /// Time after which the requester is notified of the missing answer
+      struct timeval deadline;
+    };
+    /**
+     * \brief Blocking operation handled by the workers, and its outcome
+     */
+    struct Job {
+      Job() : type(INVALID_KEY), requester(-1), requester_serial(0), request_id(0), ticket(0), run_number(-1), pid(-1) {;}
+      /// Request this job handles (NEW_RUN, GET_RUN_NUMBER, START_ACQUISITION)
+      MessageKey type;
+      /// Client which issued the request, and its connection serial
+      int requester;
+      uint64_t requester_serial;
+      uint32_t request_id;
+      /// Rank of this job in the sequence of database accesses
+      uint64_t ticket;
+      int run_number;
+      pid_t pid;
+      /// Description of the failure (empty if successful)
+      std::string error;
+    };
+    /**
+     * Add all clients waiting on a listening socket to the list of socket
+     * actors to monitor for message retrieval/submission.
+     * \brief Add the new clients to listen to
+     * \param[in] listener TCP or local listening socket
+     */
+    void AddClients(int listener);
+    /**
+     * \brief Read everything available from a client, and process all complete messages
+     * \return false if the client closed its connection
      */
-    void AddClient();
+    bool ReadClient(int sid);
+    /**
+     * \brief Process all complete messages received from a client
+     * \param[in] drained Was everything available on the socket read?
+     * \return false if the client sent invalid data
+     */
+    bool ProcessInput(int sid, bool drained);
+    /// Send as much of the pending output of a client as the socket accepts
+    void FlushClient(int sid);
+    /// Flush all clients to which messages were queued
+    void FlushPendingClients();
+    /// Can this message be dropped for a slow client? (superseded by the next update)
+    bool IsDroppable(const SocketMessageView& m) const;
+    /// Close the connections flagged as broken while sending
+    void CloseBrokenClients();
     /**
      * Ask to a client to disconnect from this socket.
      * \brief Disconnect a client
@@ -90,9 +245,128 @@ class Messenger : public Socket
      * \brief Process a message received from the socket
      * \param[in] Unique identifier of the client sending the message
      */
-    void ProcessMessage(SocketMessage m, int sid);
+    void ProcessMessage(const SocketMessageView& m, int sid);
+    /**
+     * Update the subscriptions of a client from a SUBSCRIBE/UNSUBSCRIBE
+     * message, whose value is the message key, optionally followed by a
+     * comma-separated list of attributes (e.g. "NEW_FILENAME:1234,5678").
+     * An UNSUBSCRIBE without attributes stops the delivery of this key to
+     * the client, even if its type would receive it by default.
+     * \brief Update the subscriptions of a client
+     */
+    void Subscribe(const SocketMessageView& m, int sid);
+    /// Attribute of a message its subscribers are filtered on (the first field of its value)
+    static StringRef GetAttribute(const SocketMessageView& m);
+    /**
+     * \brief Is a published message delivered to a client?
+     * \param[in] client_type Type of the client
+     * \param[in] type Type of the clients receiving the message by default
+     */
+    static bool IsRecipient(const Connection& c, const SocketType& client_type, const SocketType& type, const MessageKey& key, const StringRef& attribute);
+    /// Is this message kept in the replay log once published?
+    bool IsReplayable(const MessageKey& key) const;
+    static inline bool PublishedBefore(const Publication* a, const Publication* b) { return (a->order<b->order); }
+    /**
+     * Replay to a client the published messages it missed, from a RESUME
+     * message whose value is a ';'-separated list of message keys with the
+     * sequence number of the last message the client received for each of
+     * them (e.g. "NEW_FILENAME:7000000000000000042;RUN_NUMBER:7000000000000000012").
+     * The messages of all keys are replayed in the order they were published.
+     * They are filtered as when published, according to the current
+     * type and subscriptions of the client, and followed by a RESUMED
+     * message giving the number of messages replayed, and the number of
+     * messages of these keys no longer in the log (an upper bound of the
+     * ones the client missed for good).
+     * \brief Resume the session of a reconnecting client
+     */
+    void Resume(const SocketMessageView& m, int sid);
+    /// Answer a request handled by the messenger itself
+    void Reply(const SocketMessageView& request, SocketMessage answer, int sid);
+    /**
+     * The request is sent to the target with an identifier of the messenger,
+     * and its answer is routed back to the requester when received, without
+     * waiting for it in the meantime.
+     * \brief Forward a request to another client
+     * \param[in] m Request to send to the target
+     * \param[in] answer Key of the expected answer
+     * \param[in] requester Client issuing the request
+     * \param[in] requester_id Identifier given by the requester to its request
+     * \param[in] target Client to forward the request to
+     */
+    void ForwardRequest(SocketMessage m, const MessageKey& answer, int requester, uint32_t requester_id, int target);
+    /**
+     * \brief Route an answer back to the client which issued the request
+     * \return false if this message does not answer any forwarded request
+     */
+    bool RouteAnswer(const SocketMessageView& m, int sid);
+    /// Notify the requesters whose request was not answered in time
+    void ExpireRequests();
+    /// Forget the requests issued by a client, and notify the requesters of the ones forwarded to it
+    void CancelRequests(int sid);
+    /// Time left before the next request expires (in ms, -1 if no request is pending)
+    int GetRequestsTimeout() const;
+    /// Launch the worker threads and the notification of their completions
+    bool StartWorkers();
+    /// Wait for the worker threads to finish their current job
+    void StopWorkers();
+    /**
+     * The database accesses of all jobs are performed in the order of their
+     * submission, whatever the worker handling them.
+     * \brief Queue a blocking operation for the workers
+     * \param[in] type Request to handle
+     * \param[in] sid Client issuing the request (-1 if none)
+     */
+    void Submit(const MessageKey& type, int sid=-1, uint32_t request_id=0);
+    static void* ProcessJobs(void* arg);
+    /// Perform a job (from a worker thread)
+    void RunJob(Job& job);
+    /// Wait for the turn of a job to access the database (from a worker thread)
+    void WaitDatabaseTurn(const Job& job);
+    void EndDatabaseTurn();
+    /**
+     * \brief Launch a program in a child process (from a worker thread)
+     * \return false if the program could not be executed
+     */
+    static bool Spawn(const char* path, pid_t* pid, std::string* error);
+    /// Notify the clients of the outcome of all completed jobs
+    void ProcessCompletions();
     int fNumAttempts;
     pid_t fPID;
+    int fEpollFd;
+    /// Listening socket for the clients running on this machine (-1 if TCP only)
+    int fLocalSocketId;
+    std::map<int,Connection> fConnections;
+    /// Clients whose connection failed while sending, to be closed at the end of the loop iteration
+    std::set<int> fBrokenClients;
+    /// Clients with messages queued since their last flush
+    std::set<int> fPendingOutput;
+    /// Requests forwarded to the clients, waiting for an answer
+    std::map<uint32_t,Request> fRequests;
+    uint32_t fLastRequestId;
+    uint64_t fLastSerial;
+    /**
+     * Sequence number preceding the first message published by this master.
+     * It is derived from its start time, for the sequence numbers of a new
+     * master to follow the ones of the master it replaces.
+     */
+    uint64_t fFirstSequence;
+    /// Sequence number of the last message published for each key
+    std::map<MessageKey,uint64_t> fLastSequences;
+    /// Number of messages kept in the replay logs so far, whatever their key
+    uint64_t fLastOrder;
+    /// Last messages published for each key, sorted by sequence number
+    std::map<MessageKey,ReplayLog> fReplayLogs;
+
+    std::vector<pthread_t> fWorkers;
+    /// Jobs waiting for a worker, and jobs completed waiting for the loop
+    std::deque<Job> fJobs, fCompletedJobs;
+    pthread_mutex_t fJobsMutex;
+    pthread_cond_t fJobsCondition;
+    bool fStopWorkers;
+    /// Tickets of the last database access submitted and of the next one allowed
+    uint64_t fLastTicket, fNextTicket;
+    /// Signalled by the workers when a job is completed
+    int fCompletionFd;
     
     int fStdoutPipe[2], fStderrPipe[2];
 };
@@ -0,0 +1,101 @@
+#ifndef PPSDecoder_h
+#define PPSDecoder_h
+
+/**
+ * C interface to the HPTDC files decoder, built as the libppsdecoder shared
+ * library for non-C++ clients (e.g. Python tools through ctypes). Hits are
+ * decoded directly into columnar buffers owned by the caller:
+ * \code
+ * pps_decoder* dec = pps_decoder_open(filename, error, sizeof(error));
+ * pps_hits hits = { trigger, event_count, channel_id, leading_time, tot };
+ * long n;
+ * while ((n=pps_decoder_read_hits(dec, &hits, capacity))>0) { ... }
+ * pps_decoder_close(dec);
+ * \endcode
+ * Only plain C types are exchanged, and any change of the structures below
+ * is reflected in the API version number.
+ * \brief C interface to the decoder
+ * \date 19 Oct 2026
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PPS_DECODER_API_VERSION 2
+/// Number of distinct flags reported by the HPTDC error words
+#define PPS_DECODER_NUM_ERROR_FLAGS 15
+/// Number of channels handled on each board
+#define PPS_DECODER_NUM_CHANNELS 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Opaque handle to a file being decoded
+typedef struct pps_decoder pps_decoder;
+
+/// File header information
+typedef struct {
+  uint32_t run_id;
+  uint32_t spill_id;
+  uint32_t num_hptdc;
+  uint32_t acq_mode;
+  uint32_t det_mode;
+} pps_file_info;
+
+/// Caller-provided arrays, each one able to hold the requested number of hits
+typedef struct {
+  /// Trigger index in the file (starting at 1, 0 for hits before the first trigger)
+  uint32_t* trigger;
+  /// Trigger counter of the board
+  uint32_t* event_count;
+  uint32_t* channel_id;
+  /// Leading edge time (in time counts)
+  uint32_t* leading_time;
+  /// Time over threshold (in time counts)
+  uint32_t* tot;
+} pps_hits;
+
+/**
+ * Counters accumulated over all words decoded so far. The triggers and
+ * the per-channel edges are counted as in the Python decoder, for both
+ * decodings to give the same occupancies.
+ */
+typedef struct {
+  uint64_t num_words;
+  /// Number of extended trigger time tag words (one per trigger)
+  uint64_t num_triggers;
+  /// Number of hits decoded (leading edges paired with a trailing edge)
+  uint64_t num_hits;
+  uint64_t num_errors;
+  /// Number of error words raising each flag
+  uint64_t error_flags[PPS_DECODER_NUM_ERROR_FLAGS];
+  /// Number of trailing edges recorded on each channel, paired or not
+  uint64_t trailing_edges[PPS_DECODER_NUM_CHANNELS];
+} pps_stats;
+
+/// Version of the interface implemented by the library
+int pps_decoder_api_version(void);
+/**
+ * \brief Open a file for decoding
+ * \param[out] error Buffer receiving the error message on failure (may be NULL)
+ * \return NULL if the file could not be opened
+ */
+pps_decoder* pps_decoder_open(const char* filename, char* error, size_t error_size);
+void pps_decoder_close(pps_decoder* dec);
+/// Retrieve the file header information (0 on success)
+int pps_decoder_get_info(const pps_decoder* dec, pps_file_info* info);
+/**
+ * \brief Decode the next hits of the file into the caller buffers
+ * \param[in] capacity Maximal number of hits to write in each array
+ * \return Number of hits written (0 once the file is fully decoded, -1 on error)
+ */
+long pps_decoder_read_hits(pps_decoder* dec, pps_hits* hits, size_t capacity);
+/// Retrieve the counters of all words decoded so far (0 on success)
+int pps_decoder_get_stats(const pps_decoder* dec, pps_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef RenderScheduler_h
+#define RenderScheduler_h
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/// Default maximal number of times per second a plot may be rendered
+#define DQM_RENDER_MAX_FPS 0.5
+
+namespace DQM
+{
+  /**
+   * Base class for all plots rendered by a RenderScheduler. Any change of the
+   * plot content has to mark it as dirty, and must be performed while
+   * holding its render lock if the scheduler runs in a separate thread.
+   * \brief Plot whose rendering is driven by its content changes
+   * \date 19 Oct 2026
+   */
+  class Renderable
+  {
+    public:
+      inline Renderable() : fVersion(0), fRenderedVersion(0), fRenderedChecksum(0) { pthread_mutex_init(&fRenderMutex, NULL); }
+      inline virtual ~Renderable() { pthread_mutex_destroy(&fRenderMutex); }
+
+      inline void MarkDirty() { __atomic_add_fetch(&fVersion, 1, __ATOMIC_RELEASE); }
+      inline bool IsDirty() const { return __atomic_load_n(&fVersion, __ATOMIC_ACQUIRE)!=fRenderedVersion; }
+      inline void LockRender() { pthread_mutex_lock(&fRenderMutex); }
+      inline void UnlockRender() { pthread_mutex_unlock(&fRenderMutex); }
+
+      /// Name of the output produced (as sent to the DAQ clients)
+      virtual std::string GetOutputName() const = 0;
+      /// Hash of everything that appears on the rendered output
+      virtual uint64_t GetContentChecksum() const = 0;
+      /// Produce the output files in a given directory
+      virtual void Render(const char* path) = 0;
+
+    protected:
+      /// FNV-1a hashing of a memory region, to be chained in the content checksums
+      static inline uint64_t Hash(const void* data, size_t size, uint64_t hash=14695981039346656037ULL) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i=0; i<size; i++) { hash ^= bytes[i]; hash *= 1099511628211ULL; }
+        return hash;
+      }
+
+    private:
+      friend class RenderScheduler;
+      unsigned long fVersion, fRenderedVersion;
+      uint64_t fRenderedChecksum;
+      pthread_mutex_t fRenderMutex;
+  };
+
+  /**
+   * \brief Scope guard holding the render lock of a plot while it is being filled
+   */
+  class RenderLock
+  {
+    public:
+      inline RenderLock(Renderable* r) : fRenderable(r) { fRenderable->LockRender(); }
+      inline ~RenderLock() { fRenderable->UnlockRender(); }
+    private:
+      Renderable* fRenderable;
+  };
+
+  /**
+   * Renders the registered plots outside of the analysis thread, at most at a
+   * given frame rate, and only if their content changed since their previous
+   * rendering. The analysis cost is therefore decoupled from the rendering
+   * one, which no longer grows with the burst rate.
+   * \brief Change-driven rendering of the DQM plots
+   * \date 19 Oct 2026
+   */
+  class RenderScheduler
+  {
+    public:
+      typedef void (*Callback)(const std::string& name, void* arg);
+
+      /**
+       * \param[in] path Directory where all outputs are written
+       * \param[in] max_fps Maximal number of times per second a plot is rendered
+       */
+      inline RenderScheduler(const char* path, double max_fps=DQM_RENDER_MAX_FPS) :
+        fPath(path), fCallback(0), fCallbackArg(0), fStarted(false), fStop(false), fNumRendered(0), fNumSkipped(0) {
+        SetMaxFrameRate(max_fps);
+        fLastPass.tv_sec = fLastPass.tv_usec = 0;
+        pthread_mutex_init(&fMutex, NULL);
+      }
+      inline ~RenderScheduler() {
+        Stop();
+        pthread_mutex_destroy(&fMutex);
+      }
+
+      inline void SetMaxFrameRate(double max_fps) { fPeriodUs = (max_fps>0.) ? static_cast<unsigned long>(1.e6/max_fps) : 0; }
+      /// Function to call whenever an output is (re)written
+      inline void SetCallback(Callback cb, void* arg) { fCallback = cb; fCallbackArg = arg; }
+
+      inline void Register(Renderable* r) {
+        pthread_mutex_lock(&fMutex);
+        if (std::find(fPlots.begin(), fPlots.end(), r)==fPlots.end()) fPlots.push_back(r);
+        pthread_mutex_unlock(&fMutex);
+      }
+      /// Remove a plot from the scheduler (mandatory before its deletion)
+      inline void Unregister(Renderable* r) {
+        pthread_mutex_lock(&fMutex);
+        std::vector<Renderable*>::iterator it = std::find(fPlots.begin(), fPlots.end(), r);
+        if (it!=fPlots.end()) fPlots.erase(it);
+        pthread_mutex_unlock(&fMutex);
+      }
+
+      /// Launch the rendering thread
+      inline bool Start() {
+        if (fStarted) return true;
+        fStop = false;
+        fStarted = (pthread_create(&fThread, NULL, RenderScheduler::Process, this)==0);
+        return fStarted;
+      }
+      inline void Stop() {
+        if (!fStarted) return;
+        fStop = true;
+        pthread_join(fThread, NULL);
+        fStarted = false;
+      }
+      /**
+       * \brief Render the dirty plots from the calling thread if the frame period elapsed
+       * \note Only useful if no rendering thread was started
+       */
+      inline void Poll() {
+        if (fStarted) return;
+        struct timeval now; gettimeofday(&now, NULL);
+        if (ElapsedUs(fLastPass, now)<fPeriodUs) return;
+        fLastPass = now;
+        RenderDirty();
+      }
+
+      /**
+       * \brief Render a plot right away if it changed since its last rendering
+       * \note To be called while holding the plot's render lock, e.g. before
+       *  its content is replaced by another burst's one
+       */
+      inline void Flush(Renderable* r) {
+        std::vector<std::string> outputs;
+        RenderOne(r, &outputs);
+        if (!fCallback) return;
+        for (std::vector<std::string>::const_iterator nm=outputs.begin(); nm!=outputs.end(); nm++) fCallback(*nm, fCallbackArg);
+      }
+
+      /// Number of outputs written so far
+      inline unsigned long GetNumRendered() const { return __atomic_load_n(&fNumRendered, __ATOMIC_RELAXED); }
+      /// Number of renderings skipped as the plot content did not change
+      inline unsigned long GetNumSkipped() const { return __atomic_load_n(&fNumSkipped, __ATOMIC_RELAXED); }
+
+    private:
+      static inline unsigned long ElapsedUs(const struct timeval& beg, const struct timeval& end) {
+        return (end.tv_sec-beg.tv_sec)*1000000+(end.tv_usec-beg.tv_usec);
+      }
+      inline void RenderDirty() {
+        std::vector<std::string> outputs;
+        pthread_mutex_lock(&fMutex); // plots cannot be unregistered while being rendered
+        for (std::vector<Renderable*>::iterator it=fPlots.begin(); it!=fPlots.end(); it++) {
+          if (!(*it)->IsDirty()) continue;
+          RenderLock lock(*it);
+          RenderOne(*it, &outputs);
+        }
+        pthread_mutex_unlock(&fMutex);
+        if (!fCallback) return;
+        for (std::vector<std::string>::const_iterator nm=outputs.begin(); nm!=outputs.end(); nm++) fCallback(*nm, fCallbackArg);
+      }
+      /// Render one plot if needed (to be called with its render lock held)
+      inline void RenderOne(Renderable* r, std::vector<std::string>* outputs) {
+        if (!r->IsDirty()) return;
+        r->fRenderedVersion = __atomic_load_n(&r->fVersion, __ATOMIC_ACQUIRE);
+        const uint64_t checksum = r->GetContentChecksum();
+        if (checksum==r->fRenderedChecksum) { __atomic_add_fetch(&fNumSkipped, 1, __ATOMIC_RELAXED); return; }
+        r->Render(fPath.c_str());
+        r->fRenderedChecksum = checksum;
+        outputs->push_back(r->GetOutputName());
+        __atomic_add_fetch(&fNumRendered, 1, __ATOMIC_RELAXED);
+      }
+      static void* Process(void* arg) {
+        RenderScheduler* rs = static_cast<RenderScheduler*>(arg);
+        struct timeval beg, end;
+        while (!rs->fStop) {
+          gettimeofday(&beg, NULL);
+          rs->RenderDirty();
+          gettimeofday(&end, NULL);
+          // sleep for the rest of the frame, by short steps to stay responsive to Stop()
+          unsigned long elapsed = ElapsedUs(beg, end);
+          while (!rs->fStop and elapsed<rs->fPeriodUs) {
+            const unsigned long step = std::min<unsigned long>(rs->fPeriodUs-elapsed, 100000);
+            usleep(step); elapsed += step;
+          }
+          if (rs->fPeriodUs==0) usleep(10000);
+        }
+        return 0;
+      }
+
+      std::string fPath;
+      unsigned long fPeriodUs;
+      Callback fCallback;
+      void* fCallbackArg;
+      std::vector<Renderable*> fPlots;
+      bool fStarted;
+      volatile bool fStop;
+      unsigned long fNumRendered, fNumSkipped;
+      struct timeval fLastPass;
+      pthread_t fThread;
+      pthread_mutex_t fMutex;
+  };
+}
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef RunAccumulator_h
+#define RunAccumulator_h
+
+#include "Exception.h"
+#include "VME_TDCMeasurement.h"
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <stdint.h>
+#include <pthread.h>
+
+/// Number of channels monitored on each TDC board
+#define ACC_NUM_CHANNELS 32
+/// Last bin of the per-channel hit multiplicity distribution (overflow included)
+#define ACC_MAX_MULTIPLICITY 15
+#define ACC_MAGIC 0x41535050 // PPSA in ASCII
+
+namespace DQM
+{
+  /**
+   * \brief Run-integrated statistics of one TDC channel
+   */
+  struct ChannelStatistics
+  {
+    ChannelStatistics() : num_triggers(0), num_hits(0), sum_tot(0.), sum_tot2(0.) {
+      for (unsigned int i=0; i<=ACC_MAX_MULTIPLICITY; i++) multiplicity[i] = 0;
+    }
+    inline void Add(const ChannelStatistics& s) {
+      num_triggers += s.num_triggers; num_hits += s.num_hits;
+      sum_tot += s.sum_tot; sum_tot2 += s.sum_tot2;
+      for (unsigned int i=0; i<=ACC_MAX_MULTIPLICITY; i++) multiplicity[i] += s.multiplicity[i];
+    }
+    /// Reweight the counts of a sampled readout (means are left unchanged)
+    inline void Scale(double weight) {
+      num_triggers = static_cast<uint64_t>(num_triggers*weight+0.5); num_hits = static_cast<uint64_t>(num_hits*weight+0.5);
+      sum_tot *= weight; sum_tot2 *= weight;
+      for (unsigned int i=0; i<=ACC_MAX_MULTIPLICITY; i++) multiplicity[i] = static_cast<uint64_t>(multiplicity[i]*weight+0.5);
+    }
+    /// Mean time over threshold (in ns)
+    inline double MeanToT() const { return (num_hits>0) ? sum_tot/num_hits : 0.; }
+    /// Mean number of hits in each trigger with at least one hit
+    inline double MeanMultiplicity() const { return (num_triggers>0) ? (double)num_hits/num_triggers : 0.; }
+
+    /// Number of triggers with at least one hit on this channel
+    uint64_t num_triggers;
+    uint64_t num_hits;
+    double sum_tot, sum_tot2;
+    uint64_t multiplicity[ACC_MAX_MULTIPLICITY+1];
+  };
+
+  /**
+   * \brief Statistics of all channels of one board, for one burst
+   */
+  class BoardStatistics : public std::vector<ChannelStatistics>
+  {
+    public:
+      inline BoardStatistics() : std::vector<ChannelStatistics>(ACC_NUM_CHANNELS) {;}
+      /// Add one trigger's measurement on a channel
+      inline void Fill(unsigned int channel_id, VME::TDCMeasurement& m) {
+        if (channel_id>=size() or m.NumEvents()==0) return;
+        ChannelStatistics& ch = at(channel_id);
+        ch.num_triggers++;
+        ch.num_hits += m.NumEvents();
+        for (unsigned int i=0; i<m.NumEvents(); i++) {
+          const double tot = m.GetToT(i)*25./1.e3;
+          ch.sum_tot += tot; ch.sum_tot2 += tot*tot;
+        }
+        ch.multiplicity[(m.NumEvents()<ACC_MAX_MULTIPLICITY) ? m.NumEvents() : ACC_MAX_MULTIPLICITY]++;
+      }
+      /// Add one trigger's hits on a channel, given the sums of their times over threshold (in ns)
+      inline void Fill(unsigned int channel_id, unsigned int num_hits, double sum_tot, double sum_tot2) {
+        if (channel_id>=size() or num_hits==0) return;
+        ChannelStatistics& ch = at(channel_id);
+        ch.num_triggers++;
+        ch.num_hits += num_hits;
+        ch.sum_tot += sum_tot; ch.sum_tot2 += sum_tot2;
+        ch.multiplicity[(num_hits<ACC_MAX_MULTIPLICITY) ? num_hits : ACC_MAX_MULTIPLICITY]++;
+      }
+      inline void Scale(double weight) {
+        for (iterator it=begin(); it!=end(); it++) it->Scale(weight);
+      }
+      inline void Add(const BoardStatistics& s) {
+        for (unsigned int i=0; i<size() and i<s.size(); i++) at(i).Add(s.at(i));
+      }
+  };
+
+  /**
+   * Holds the occupancy, time over threshold and hit multiplicity of every
+   * channel, integrated over all bursts processed since the beginning of the
+   * run. Each burst is only decoded once and merged into these accumulators,
+   * which are checkpointed to disk so that a restarted DQM process recovers
+   * the run-level view without re-reading the previous bursts.
+   * \brief Run-level statistics accumulators
+   * \date 19 Oct 2026
+   */
+  class RunAccumulator
+  {
+    public:
+      /**
+       * \param[in] name Detector name, used to build the checkpoint file name
+       * \param[in] dir Directory where the checkpoint is stored
+       */
+      inline RunAccumulator(const char* name, const char* dir="/tmp/") : fName(name), fDir(dir), fRunId(0) {
+        pthread_mutex_init(&fMutex, NULL);
+      }
+      inline ~RunAccumulator() { pthread_mutex_destroy(&fMutex); }
+
+      inline unsigned int GetRunId() const { return fRunId; }
+      /// Start the accumulation for a new run, or recover it from its last checkpoint
+      inline void Reset(unsigned int run_id) {
+        pthread_mutex_lock(&fMutex);
+        if (run_id!=fRunId or fBoards.empty()) SwitchRun(run_id);
+        pthread_mutex_unlock(&fMutex);
+      }
+      /**
+       * The accumulation switches to the burst's run if it is a newer one, in
+       * the same operation, so that concurrent workers never merge a burst
+       * into another run. Bursts of a previous run, and bursts already merged
+       * (e.g. re-read after a restart), are not merged.
+       * \brief Merge the statistics of one burst and checkpoint the result
+       * \note Safe to be called from several worker threads
+       * \return false if the burst was not merged
+       */
+      inline bool Add(unsigned int run_id, unsigned int board_address, unsigned int burst_id, const BoardStatistics& stats) {
+        pthread_mutex_lock(&fMutex);
+        if (run_id<fRunId) { pthread_mutex_unlock(&fMutex); return false; }
+        if (run_id!=fRunId) SwitchRun(run_id);
+        if (!fBursts[board_address].insert(burst_id).second) { pthread_mutex_unlock(&fMutex); return false; } // already merged
+        BoardsMap::iterator b = fBoards.find(board_address);
+        if (b==fBoards.end()) b = fBoards.insert(std::pair<unsigned int, BoardStatistics>(board_address, BoardStatistics())).first;
+        b->second.Add(stats);
+        try { Checkpoint(); } catch (Exception& e) { e.Dump(); }
+        pthread_mutex_unlock(&fMutex);
+        return true;
+      }
+      /// Retrieve a copy of one board's run-integrated statistics
+      inline BoardStatistics GetStatistics(unsigned int board_address, unsigned int* num_bursts=0) {
+        BoardStatistics out;
+        pthread_mutex_lock(&fMutex);
+        BoardsMap::const_iterator b = fBoards.find(board_address);
+        if (b!=fBoards.end()) out = b->second;
+        if (num_bursts) *num_bursts = fBursts[board_address].size();
+        pthread_mutex_unlock(&fMutex);
+        return out;
+      }
+
+    private:
+      typedef std::map<unsigned int, BoardStatistics> BoardsMap;
+      /// Start the accumulation of a run from its last checkpoint (to be called with the lock held)
+      inline void SwitchRun(unsigned int run_id) {
+        fBoards.clear(); fBursts.clear();
+        fRunId = run_id;
+        try { Load(); } catch (Exception& e) { e.Dump(); fBoards.clear(); fBursts.clear(); }
+      }
+      inline std::string CheckpointPath() const {
+        std::ostringstream os; os << fDir << fName << "_" << fRunId << "_run_accumulator.dat";
+        return os.str();
+      }
+      /// Write the accumulators to a temporary file, then atomically replace the previous checkpoint
+      inline void Checkpoint() const {
+        const std::string path = CheckpointPath(), tmp = path+".tmp";
+        std::ofstream out(tmp.c_str(), std::ios::binary);
+        if (!out.is_open()) throw Exception(__PRETTY_FUNCTION__, "Failed to write the accumulators checkpoint!", JustWarning, 42100);
+        const uint32_t magic = ACC_MAGIC, num_boards = fBoards.size();
+        out.write((char*)&magic, sizeof(uint32_t));
+        out.write((char*)&fRunId, sizeof(uint32_t));
+        out.write((char*)&num_boards, sizeof(uint32_t));
+        for (BoardsMap::const_iterator b=fBoards.begin(); b!=fBoards.end(); b++) {
+          const uint32_t address = b->first, num_channels = b->second.size();
+          out.write((char*)&address, sizeof(uint32_t));
+          out.write((char*)&num_channels, sizeof(uint32_t));
+          out.write((char*)&b->second[0], num_channels*sizeof(ChannelStatistics));
+          const std::set<unsigned int>& bursts = fBursts.find(b->first)->second;
+          const uint32_t num_bursts = bursts.size();
+          out.write((char*)&num_bursts, sizeof(uint32_t));
+          for (std::set<unsigned int>::const_iterator it=bursts.begin(); it!=bursts.end(); it++) {
+            const uint32_t burst_id = *it;
+            out.write((char*)&burst_id, sizeof(uint32_t));
+          }
+        }
+        out.close();
+        if (out.fail() or rename(tmp.c_str(), path.c_str())!=0) {
+          throw Exception(__PRETTY_FUNCTION__, "Failed to write the accumulators checkpoint!", JustWarning, 42100);
+        }
+      }
+      inline void Load() {
+        std::ifstream in(CheckpointPath().c_str(), std::ios::binary);
+        if (!in.is_open()) return; // nothing accumulated yet for this run
+        uint32_t magic, run_id, num_boards;
+        in.read((char*)&magic, sizeof(uint32_t));
+        in.read((char*)&run_id, sizeof(uint32_t));
+        in.read((char*)&num_boards, sizeof(uint32_t));
+        if (!in.good() or magic!=ACC_MAGIC or run_id!=fRunId) {
+          throw Exception(__PRETTY_FUNCTION__, "Invalid accumulators checkpoint! Starting from scratch.", JustWarning, 42101);
+        }
+        for (unsigned int i=0; i<num_boards; i++) {
+          uint32_t address, num_channels, num_bursts, burst_id;
+          in.read((char*)&address, sizeof(uint32_t));
+          in.read((char*)&num_channels, sizeof(uint32_t));
+          if (!in.good() or num_channels!=ACC_NUM_CHANNELS) {
+            throw Exception(__PRETTY_FUNCTION__, "Invalid accumulators checkpoint! Starting from scratch.", JustWarning, 42101);
+          }
+          BoardStatistics& stats = fBoards[address];
+          in.read((char*)&stats[0], num_channels*sizeof(ChannelStatistics));
+          in.read((char*)&num_bursts, sizeof(uint32_t));
+          for (unsigned int j=0; j<num_bursts and in.good(); j++) {
+            in.read((char*)&burst_id, sizeof(uint32_t));
+            fBursts[address].insert(burst_id);
+          }
+          if (!in.good()) throw Exception(__PRETTY_FUNCTION__, "Truncated accumulators checkpoint! Starting from scratch.", JustWarning, 42101);
+        }
+        std::cout << "Recovered the " << fName << " accumulators of run " << fRunId << " for " << num_boards << " board(s)" << std::endl;
+      }
+
+      std::string fName, fDir;
+      uint32_t fRunId;
+      BoardsMap fBoards;
+      std::map<unsigned int, std::set<unsigned int> > fBursts;
+      pthread_mutex_t fMutex;
+  };
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SamplingController_h
+#define SamplingController_h
+
+/// Maximal number of triggers out of which only one is decoded
+#define DQM_MAX_SAMPLING 64
+/// Number of files waiting above which the sampling factor is increased
+#define DQM_SAMPLING_HIGH_BACKLOG 2
+/// Number of files waiting below which the sampling factor is decreased
+#define DQM_SAMPLING_LOW_BACKLOG 0
+
+namespace DQM
+{
+  /**
+   * Chooses the fraction of the triggers decoded by a DQM plotter from the
+   * backlog of files waiting to be processed. The sampling factor is doubled
+   * whenever the backlog grows above a high watermark, and halved back once it
+   * drains below a low one, so that the full statistics are decoded again as
+   * soon as the load allows it.
+   * \brief Adaptive sampling factor of the DQM readout
+   * \date 19 Oct 2026
+   */
+  class SamplingController
+  {
+    public:
+      /**
+       * \param[in] max_factor Maximal sampling factor (1 to always decode all triggers)
+       * \param[in] high_backlog Backlog above which less triggers are decoded
+       * \param[in] low_backlog Backlog below which more triggers are decoded
+       */
+      inline SamplingController(unsigned int max_factor=DQM_MAX_SAMPLING, unsigned int high_backlog=DQM_SAMPLING_HIGH_BACKLOG, unsigned int low_backlog=DQM_SAMPLING_LOW_BACKLOG) :
+        fFactor(1), fMaxFactor((max_factor>0) ? max_factor : 1), fHighBacklog(high_backlog), fLowBacklog(low_backlog) {;}
+
+      /**
+       * \brief Adapt the sampling factor to the number of files waiting
+       * \return The sampling factor to use for the next file
+       * \note Safe to be called from several worker threads
+       */
+      inline unsigned int Update(unsigned int backlog) {
+        unsigned int factor = __atomic_load_n(&fFactor, __ATOMIC_RELAXED), new_factor = factor;
+        if (backlog>fHighBacklog and factor<fMaxFactor) new_factor = (factor*2<fMaxFactor) ? factor*2 : fMaxFactor;
+        else if (backlog<=fLowBacklog and factor>1) new_factor = factor/2;
+        if (new_factor!=factor) {
+          // only one concurrent update is applied
+          if (__atomic_compare_exchange_n(&fFactor, &factor, new_factor, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) factor = new_factor;
+        }
+        return factor;
+      }
+      /// Current fraction (1/factor) of the triggers to decode
+      inline unsigned int GetFactor() const { return __atomic_load_n(&fFactor, __ATOMIC_RELAXED); }
+      inline void Reset() { __atomic_store_n(&fFactor, 1, __ATOMIC_RELAXED); }
+
+    private:
+      unsigned int fFactor, fMaxFactor;
+      unsigned int fHighBacklog, fLowBacklog;
+  };
+}
+
+#endif
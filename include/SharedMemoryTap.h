@@ -0,0 +1,129 @@
+#ifndef SharedMemoryTap_h
+#define SharedMemoryTap_h
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "FileConstants.h"
+#include "Exception.h"
+#include "VME_TDCEvent.h"
+
+/// Name of the shared memory segment published by the acquisition
+#define TAP_NAME "/pps_live_tap"
+/// Number of 32-bit words kept in memory for each board
+#define TAP_CAPACITY_WORDS (1<<21)
+#define TAP_MAGIC 0x50415450 // PTAP in ASCII
+/// Number of attempts to read a file header being updated before the writer is considered dead
+#define TAP_HEADER_MAX_ATTEMPTS 100000
+
+/**
+ * \brief Header of the shared memory segment
+ */
+struct tap_header_t {
+  uint32_t magic;
+  uint32_t num_streams;
+  /// Number of words in each stream's ring buffer
+  uint64_t capacity;
+};
+
+/**
+ * \brief Control block of one board's data stream
+ */
+struct tap_stream_t {
+  uint32_t board_address;
+  /// Odd while the file header below is being updated
+  uint32_t header_seq;
+  file_header_t header;
+  /// Total number of words ever written to this stream
+  uint64_t write_index;
+  /// Index up to which the writer may currently be overwriting the ring
+  uint64_t reserve_index;
+};
+
+/**
+ * Shared memory ring buffers (one per board) in which the acquisition
+ * publishes every word it writes to the output files. Any number of
+ * monitoring processes may attach to it read-only, each with its own cursor,
+ * without any disk access or synchronisation with the writer.
+ * \brief Live data tap published by the acquisition
+ * \date 19 Oct 2026
+ */
+class SharedMemoryTap
+{
+  public:
+    /// Policy to follow when the writer already overwrote unread words
+    enum OverrunPolicy {
+      SkipToOldest, ///< Resume from the oldest words still in memory
+      SkipToLatest  ///< Drop everything and only read the newest words
+    };
+
+    /// Build a consumer (read-only) handler
+    SharedMemoryTap(OverrunPolicy policy=SkipToOldest);
+    ~SharedMemoryTap();
+
+    /**
+     * \brief Create and publish the segment (acquisition side)
+     * \param[in] num_streams Number of boards to publish
+     * \param[in] capacity Number of words kept in memory for each board
+     */
+    void Create(unsigned int num_streams, uint64_t capacity=TAP_CAPACITY_WORDS, const char* name=TAP_NAME);
+    /// Set the board and file header information of one stream (acquisition side)
+    void SetStream(unsigned int stream, uint32_t board_address, const file_header_t& header);
+    /// Publish new words on one stream (acquisition side)
+    void Write(unsigned int stream, const VME::TDCEventCollection& events);
+    void Write(unsigned int stream, uint32_t word);
+
+    /**
+     * \brief Attach to a published segment (consumer side)
+     * \return false if no acquisition currently publishes its data
+     */
+    bool Attach(const char* name=TAP_NAME);
+    inline bool IsAttached() const { return fBase!=0; }
+    /// Has the segment been withdrawn by the acquisition (or its writer died while updating it)?
+    bool IsStale() const;
+    inline unsigned int GetNumStreams() const { return fHeader ? fHeader->num_streams : 0; }
+    uint32_t GetBoardAddress(unsigned int stream) const;
+    /**
+     * \brief Retrieve a consistent copy of the stream's current file header
+     * \note A void header is returned, and the tap flagged as stale, if the
+     *  header is left in the middle of an update
+     */
+    file_header_t GetFileHeader(unsigned int stream) const;
+    /**
+     * \brief Retrieve all complete events published since last call (consumer side)
+     * \return Number of words retrieved
+     */
+    size_t Fetch(unsigned int stream, VME::TDCEventCollection* events);
+    /// Number of words lost because the writer overran this consumer
+    inline uint64_t GetNumLostWords(unsigned int stream) const { return (stream<fLost.size()) ? fLost[stream] : 0; }
+
+  private:
+    void Map(int prot);
+    void Unmap();
+    inline tap_stream_t* Stream(unsigned int stream) const {
+      return reinterpret_cast<tap_stream_t*>(fBase+sizeof(tap_header_t)+stream*StreamSize());
+    }
+    inline uint32_t* Ring(unsigned int stream) const {
+      return reinterpret_cast<uint32_t*>(reinterpret_cast<char*>(Stream(stream))+sizeof(tap_stream_t));
+    }
+    inline size_t StreamSize() const { return sizeof(tap_stream_t)+fHeader->capacity*sizeof(uint32_t); }
+
+    OverrunPolicy fPolicy;
+    bool fWriter;
+    std::string fName;
+    int fFd;
+    char* fBase;
+    size_t fSize;
+    tap_header_t* fHeader;
+    /// Per-stream read cursors (consumer side)
+    std::vector<uint64_t> fCursor;
+    std::vector<uint64_t> fLost;
+    /// Is the next block of each stream to be realigned on an event boundary? (consumer side)
+    std::vector<bool> fResync;
+    std::vector<uint32_t> fBuffer;
+    /// Was a file header found in the middle of an update for too long?
+    mutable bool fStaleHeader;
+};
+
+#endif
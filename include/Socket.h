@@ -5,6 +5,7 @@
 #include <cstring>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h> // local address family (for sockaddr_un)
 #include <netinet/in.h> // internet address family (for sockaddr_in)
 #include <arpa/inet.h> // definitions for internet operations
 #include <netdb.h>
@@ -15,15 +16,19 @@
 #include <fcntl.h>
 
 #include <set>
+#include <string>
 #include <sstream>
 #include <iostream>
 
 #include "Exception.h"
 #include "SocketMessage.h"
+#include "MessageFrame.h"
 
 #define SOCKET_ERROR(x) 10000+x
 #define MAX_WORD_LENGTH 5000
 #define MAX_SOCKET_ATTEMPTS 2
+/// Environment variable holding the path of the local (Unix domain) socket of the master
+#define SOCKET_LOCAL_PATH_ENV "PPS_SOCKET_PATH"
 
 /**
  * \defgroup Socket Socket communication objects
@@ -57,6 +62,21 @@ class Socket
     inline void SetPort(int port) { fPort=port; }
     /// Retrieve the port used for this socket
     inline int GetPort() const { return fPort; }
+    /**
+     * Processes running on the same machine as the master may exchange their
+     * messages through a Unix domain socket instead of TCP, avoiding the
+     * network stack. Its path is set through the PPS_SOCKET_PATH environment
+     * variable, TCP only being used if undefined.
+     * \brief Path of the local socket of the master (empty if not configured)
+     */
+    static inline std::string GetLocalPath() {
+      const char* path = getenv(SOCKET_LOCAL_PATH_ENV);
+      return (path) ? std::string(path) : std::string();
+    }
+    /// Use a Unix domain socket at this path (TCP on the port if empty)
+    inline void SetLocalPath(const std::string& path) { fLocalPath=path; }
+    /// Is this socket using the local (Unix domain) transport?
+    inline bool IsLocal() const { return !fLocalPath.empty(); }
   
     /**
      * Set the socket to accept connections any client transmitting through the
@@ -84,6 +104,8 @@ class Socket
       return INVALID;
     }
     inline bool IsWebSocket(int sid) const { return GetSocketType(sid)==WEBSOCKET_CLIENT; }
+    /// Was a complete message already received, and not fetched yet?
+    inline bool HasBufferedMessage() const { return fInput.HasMessage(); }
 
     void DumpConnected() const;
     
@@ -99,19 +121,34 @@ class Socket
      * \return Success of the operation
      */
     void Bind();
-    void PrepareConnection();
+    /**
+     * \brief Connect this socket to the master
+     * \param[in] type Severity of the failure to reach the master through TCP
+     */
+    void PrepareConnection(const ExceptionType& type=Fatal);
+    /**
+     * \brief Create a Unix domain socket listening on a path
+     * \note Any file left at this path (e.g. by a previous master) is removed
+     * \return File descriptor of the new socket
+     */
+    int ListenLocal(const std::string& path, int maxconn) const;
     /**
      * Set the socket to listen to any message coming from outside
      * \brief Listen to incoming messages
      */
     void Listen(int maxconn);
+    /// Switch a file descriptor to the non-blocking mode
+    void SetNonBlocking(int sid) const;
     
     /**
-     * \brief Send a message on a socket
+     * \brief Send a message on a socket, as one frame
      */
     void SendMessage(Message message, int id=-1) const;
+    /// Send a block of encoded frames on a socket, in one piece
+    void SendFrames(const std::string& frames, int id=-1) const;
     /**
      * \brief Receive a message from a socket
+     * \note Messages received along with a previous one are delivered first
      * \return Received message as a std::string
      */
     Message FetchMessage(int id=-1) const;
@@ -124,8 +161,12 @@ class Socket
     
   protected:
     int fPort;
+    /// Path of the Unix domain socket used instead of TCP (empty if not)
+    std::string fLocalPath;
     char fBuffer[MAX_WORD_LENGTH];
     SocketCollection fSocketsConnected;
+    /// Bytes received and not yet delivered as messages
+    mutable MessageFramer fInput;
     /// Master file descriptor list
     fd_set fMaster;
     /// Temp file descriptor list for select()
@@ -6,12 +6,83 @@
 #include <string>
 
 #include "Message.h"
+#include "StringRef.h"
 
 #include <iostream>
+#include <cctype>
 
 typedef std::pair<MessageKey, std::string> MessageMap;
 typedef std::vector<std::string> VectorValue;
 
+/**
+ * Key:value message parsed in place, its value referring to the characters
+ * of the received message (e.g. in the receive buffer of the socket) instead
+ * of a copy. Its key is retrieved from the lookup table of the message keys.
+ * It is only valid as long as the message it was built from.
+ * \brief Non-owning view on a socket-passed message
+ * \date 19 Oct 2026
+ * \ingroup Socket
+ */
+class SocketMessageView
+{
+  public:
+    inline SocketMessageView() : fKey(INVALID_KEY), fRequestId(0), fSequence(0), fValid(false) {;}
+    /// Parse a message (its null terminator, if any, being ignored)
+    inline explicit SocketMessageView(const StringRef& msg, uint32_t request_id=0) :
+      fString(msg), fKey(INVALID_KEY), fRequestId(request_id), fSequence(0), fValid(false) {
+      if (!fString.empty() and fString[fString.size()-1]=='\0') fString = fString.substr(0, fString.size()-1);
+      const size_t end = fString.find(':');
+      if (end==StringRef::npos) return;
+      fKey = MessageKeyToObject(fString.data(), end);
+      fValue = fString.substr(end+1);
+      fValid = true;
+    }
+    /// View on an existing message
+    inline explicit SocketMessageView(const Message& msg) {
+      *this = SocketMessageView(StringRef(msg.GetString()), msg.GetRequestId());
+      fSequence = msg.GetSequence();
+    }
+
+    /// Was the message in the key:value format?
+    inline bool IsValid() const { return fValid; }
+    /// Extract the whole key:value message
+    inline const StringRef& GetString() const { return fString; }
+    inline MessageKey GetKey() const { return fKey; }
+    inline const StringRef& GetValue() const { return fValue; }
+    /// Extract the message's integer value (as atoi would)
+    inline int GetIntValue() const {
+      size_t i = 0;
+      while (i<fValue.size() and isspace(fValue[i])) i++;
+      const bool negative = (i<fValue.size() and fValue[i]=='-');
+      if (i<fValue.size() and (fValue[i]=='-' or fValue[i]=='+')) i++;
+      int out = 0;
+      for (; i<fValue.size() and isdigit(fValue[i]); i++) out = out*10+(fValue[i]-'0');
+      return negative ? -out : out;
+    }
+    /// Split the message's value into its ';'-separated fields
+    inline void GetVectorValue(std::vector<StringRef>* out) const {
+      out->clear();
+      size_t start = 0, end;
+      while ((end=fValue.find(';', start))!=StringRef::npos) {
+        out->push_back(fValue.substr(start, end-start));
+        start = end+1;
+      }
+      out->push_back(fValue.substr(start));
+    }
+    inline void SetRequestId(uint32_t id) { fRequestId = id; }
+    inline uint32_t GetRequestId() const { return fRequestId; }
+    inline void SetSequence(uint64_t seq) { fSequence = seq; }
+    inline uint64_t GetSequence() const { return fSequence; }
+
+  private:
+    StringRef fString;
+    StringRef fValue;
+    MessageKey fKey;
+    uint32_t fRequestId;
+    uint64_t fSequence;
+    bool fValid;
+};
+
 /**
  * \brief Socket-passed message type
  * \author Laurent Forthomme <laurent.forthomme@cern.ch>
@@ -31,6 +102,12 @@ class SocketMessage : public Message
     inline SocketMessage(std::string msg_s) : Message(msg_s) {
       try { fMessage = Object(); } catch (Exception& e) { return; }
     }
+    /// Copy of a parsed message
+    inline SocketMessage(const SocketMessageView& view) : Message(view.GetString().str()) {
+      fRequestId = view.GetRequestId();
+      fSequence = view.GetSequence();
+      if (view.IsValid()) fMessage = make_pair(view.GetKey(), view.GetValue().str());
+    }
     /// Construct a socket message out of a key
     inline SocketMessage(const MessageKey& key) : Message() { SetKeyValue(key, ""); }
     /// Construct a socket message out of a key and a string-type value
@@ -83,11 +160,11 @@ class SocketMessage : public Message
     }
 
     /// Extract the whole key:value message
-    inline std::string GetString() const { return fString; }
+    inline const std::string& GetString() const { return fString; }
     /// Extract the message's key
     inline MessageKey GetKey() const { return fMessage.first; }
     /// Extract the message's string value
-    inline std::string GetValue() const { return fMessage.second; }
+    inline const std::string& GetValue() const { return fMessage.second; }
     /// Extract the message's string value (without the trailing endlines)
     inline std::string GetCleanedValue() const {
       std::string s = fMessage.second;
@@ -119,18 +196,12 @@ class SocketMessage : public Message
     
   private:
     inline MessageMap Object() const {
-      MessageMap out;
-      MessageKey key;
-      std::string value;
-      size_t end;
-      if ((end=fString.find(':'))==std::string::npos) {
+      const SocketMessageView view((StringRef(fString)));
+      if (!view.IsValid()) {
         std::ostringstream s; s << "Invalid message built! (\"" << fString << "\")";
         throw Exception(__PRETTY_FUNCTION__, s.str().c_str(), JustWarning);
       }
-      key = MessageKeyToObject(fString.substr(0, end).c_str());
-      value = fString.substr(end+1);
-      std::cout << MessageKeyToString(key) << " -> " << value << std::endl;
-      return make_pair(key, value);
+      return make_pair(view.GetKey(), view.GetValue().str());
     }
     inline std::string String() const {
       std::string out = MessageKeyToString(fMessage.first);
@@ -0,0 +1,58 @@
+#ifndef StringRef_h
+#define StringRef_h
+
+#include <string>
+#include <cstring>
+#include <ostream>
+
+/**
+ * Non-owning reference to a range of characters (e.g. a message in a receive
+ * buffer), to inspect it without copying. The referenced characters are not
+ * null-terminated, and must outlive the reference.
+ * \brief Read-only view on a string
+ * \date 19 Oct 2026
+ */
+class StringRef
+{
+  public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    inline StringRef() : fData(0), fSize(0) {;}
+    inline StringRef(const char* data, size_t size) : fData(data), fSize(size) {;}
+    inline StringRef(const std::string& str) : fData(str.data()), fSize(str.size()) {;}
+
+    inline const char* data() const { return fData; }
+    inline size_t size() const { return fSize; }
+    inline bool empty() const { return fSize==0; }
+    inline char operator[](size_t i) const { return fData[i]; }
+
+    /// Position of the first occurence of a character (npos if not found)
+    inline size_t find(char c, size_t from=0) const {
+      if (from>=fSize) return npos;
+      const void* pos = memchr(fData+from, c, fSize-from);
+      return (pos) ? static_cast<const char*>(pos)-fData : npos;
+    }
+    inline StringRef substr(size_t pos, size_t length=npos) const {
+      if (pos>fSize) pos = fSize;
+      if (length>fSize-pos) length = fSize-pos;
+      return StringRef(fData+pos, length);
+    }
+    /// Lexicographic comparison with a string (negative if this one comes first)
+    inline int compare(const std::string& str) const {
+      const int cmp = memcmp(fData, str.data(), (fSize<str.size()) ? fSize : str.size());
+      if (cmp!=0) return cmp;
+      return (fSize<str.size()) ? -1 : (fSize>str.size()) ? 1 : 0;
+    }
+    inline bool operator==(const std::string& str) const { return compare(str)==0; }
+    inline bool operator!=(const std::string& str) const { return compare(str)!=0; }
+    /// Copy of the referenced characters
+    inline std::string str() const { return std::string(fData, fSize); }
+
+  private:
+    const char* fData;
+    size_t fSize;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const StringRef& ref) { return os.write(ref.data(), ref.size()); }
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef TimeDifference_h
+#define TimeDifference_h
+
+#include "Histogram.h"
+
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/// Duration of one time measurement count (in ns)
+#define DQM_TIME_LSB 0.025
+/// Number of bits of the edge time measurements
+#define DQM_TIME_BITS 19
+/// Default number of bins and range (in ns) of the time difference distributions
+#define DQM_DT_NUM_BINS 400
+#define DQM_DT_RANGE 10.
+
+namespace DQM
+{
+  /**
+   * \brief Leading edge time correction for the amplitude-dependent time walk
+   * \note The correction applied is \f$ t\to t-c_0-c_1/\sqrt{\rm ToT} \f$ (times in ns)
+   */
+  struct WalkCorrection {
+    WalkCorrection(double off=0., double coef=0.) : offset(off), coefficient(coef) {;}
+    inline float operator()(double tot) const { return (tot>0.) ? offset+coefficient/sqrt(tot) : offset; }
+    double offset, coefficient;
+  };
+
+  /**
+   * \brief Corrected leading times of all hits of one channel in one trigger, stored as arrays
+   */
+  struct ChannelTimes {
+    inline void Clear() { leading.clear(); walk.clear(); }
+    inline void Add(uint32_t leading_time, uint32_t tot, const WalkCorrection& wc) {
+      leading.push_back(leading_time);
+      walk.push_back(wc(tot*DQM_TIME_LSB));
+    }
+    inline size_t size() const { return leading.size(); }
+    /// Raw leading times (in counts)
+    std::vector<int32_t> leading;
+    /// Time walk corrections (in ns)
+    std::vector<float> walk;
+  };
+
+  /**
+   * Accumulates the distribution of the time difference between the hits of
+   * two channels (possibly on different boards) recorded for the same
+   * trigger. All hit combinations of a trigger are computed at once, four at
+   * a time if SSE2 instructions are available.
+   * \brief Time difference between two channels
+   * \date 19 Oct 2026
+   */
+  class TimeDifference
+  {
+    public:
+      inline TimeDifference(unsigned int num_bins=DQM_DT_NUM_BINS, double min=-DQM_DT_RANGE, double max=DQM_DT_RANGE) :
+        fHist(num_bins, min, max), fNum(0), fSum(0.), fSum2(0.) {;}
+
+      /**
+       * \brief Compute all corrected time differences t2-t1 (in ns) between the hits of two channels
+       * \note The edge time counter rollover is accounted for
+       */
+      static inline void Compute(const ChannelTimes& t1, const ChannelTimes& t2, std::vector<float>* out) {
+        const int32_t half = 1<<(DQM_TIME_BITS-1), mask = (1<<DQM_TIME_BITS)-1;
+        const size_t n1 = t1.size(), n2 = t2.size();
+        out->resize(n1*n2);
+        if (n1*n2==0) return;
+        float* dt = &(*out)[0];
+        for (size_t i=0; i<n1; i++) {
+          size_t j = 0;
+#ifdef __SSE2__
+          const __m128i l1 = _mm_set1_epi32(t1.leading[i]), vhalf = _mm_set1_epi32(half), vmask = _mm_set1_epi32(mask);
+          const __m128 w1 = _mm_set1_ps(t1.walk[i]), lsb = _mm_set1_ps(DQM_TIME_LSB);
+          for (; j+4<=n2; j+=4, dt+=4) {
+            __m128i d = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&t2.leading[j])), l1);
+            d = _mm_sub_epi32(_mm_and_si128(_mm_add_epi32(d, vhalf), vmask), vhalf);
+            const __m128 w = _mm_sub_ps(_mm_loadu_ps(&t2.walk[j]), w1);
+            _mm_storeu_ps(dt, _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(d), lsb), w));
+          }
+#endif
+          for (; j<n2; j++, dt++) {
+            const int32_t d = ((t2.leading[j]-t1.leading[i]+half)&mask)-half;
+            *dt = d*static_cast<float>(DQM_TIME_LSB)-(t2.walk[j]-t1.walk[i]);
+          }
+        }
+      }
+      /// Add all time differences of one trigger to the distribution
+      inline void Fill(const ChannelTimes& t1, const ChannelTimes& t2) {
+        Compute(t1, t2, &fBuffer);
+        for (std::vector<float>::const_iterator dt=fBuffer.begin(); dt!=fBuffer.end(); dt++) {
+          fHist.Fill(*dt);
+          if (*dt<fHist.GetMin() or *dt>=fHist.GetMax()) continue; // outliers are left out of the moments
+          fNum++; fSum += *dt; fSum2 += (*dt)*(*dt);
+        }
+      }
+      inline void Reset() { fHist.Reset(); fNum = 0; fSum = fSum2 = 0.; }
+
+      inline const Histogram1D& GetHistogram() const { return fHist; }
+      /// Number of time differences within the distribution range
+      inline unsigned long GetNumEntries() const { return fNum; }
+      /// Mean time difference (in ns)
+      inline double GetMean() const { return (fNum>0) ? fSum/fNum : 0.; }
+      /// Standard deviation of the time difference (in ns)
+      inline double GetSigma() const {
+        if (fNum<2) return 0.;
+        const double mean = GetMean(), var = fSum2/fNum-mean*mean;
+        return (var>0.) ? sqrt(var) : 0.;
+      }
+
+    private:
+      Histogram1D fHist;
+      unsigned long fNum;
+      double fSum, fSum2;
+      std::vector<float> fBuffer;
+  };
+}
+
+#endif
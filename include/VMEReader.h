@@ -148,6 +148,8 @@ class VMEReader : public Client
     }
     /// Send the path to the output file through the socket
     void SendOutputFile(uint32_t tdc_address) const;
+    /// Send the path to the output file still being written through the socket
+    void SendLiveOutputFile(uint32_t tdc_address) const;
     void BroadcastNewBurst(unsigned int burst_id) const;
     void BroadcastTriggerRate(unsigned int burst_id, unsigned long num_triggers) const;
     void BroadcastHVStatus(unsigned short channel_id, const NIM::HVModuleN470ChannelValues& val) const;
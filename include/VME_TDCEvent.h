@@ -179,6 +179,7 @@ namespace VME
       }
       /// Total number of events
       inline uint32_t GetEventCount() const {
+        if (GetType()==GlobalHeader) return static_cast<uint32_t>((fWord>>5)&0x3FFFFF);
         if (GetType()!=TDCTrailer) return 0;
         return static_cast<uint32_t>((fWord>>5)&0x3FFFF);
       }
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <string>
+#include <cstring>
 #include <vector>
 
 /**
@@ -31,6 +32,51 @@ inline std::vector<std::string> sar(const char* a, const char* b)
   return out;
 }
 
+/**
+ * Names of all message keys, split once from the list given to the keys
+ * builder, and sorted for the keys to be retrieved from their names without
+ * building any string.
+ * \brief Lookup table of the message keys
+ * \date 19 Oct 2026
+ */
+class MessageKeyTable
+{
+  public:
+    inline MessageKeyTable(const char* a, const char* b) : fNames(sar(a, b)) {
+      for (size_t i=0; i<fNames.size(); i++) fSorted.push_back(i);
+      std::sort(fSorted.begin(), fSorted.end(), CompareIndices(fNames));
+    }
+    /// Name of a key (the first one if out of range)
+    inline const std::string& Name(int key) const {
+      return (key>=0 and static_cast<size_t>(key)<fNames.size()) ? fNames[key] : fNames[0];
+    }
+    /// Key with this name (-1 if unknown)
+    inline int Find(const char* name, size_t length) const {
+      size_t low = 0, high = fSorted.size();
+      while (low<high) {
+        const size_t mid = (low+high)/2;
+        const int cmp = Compare(fNames[fSorted[mid]], name, length);
+        if (cmp==0) return fSorted[mid];
+        if (cmp<0) low = mid+1;
+        else high = mid;
+      }
+      return -1;
+    }
+
+  private:
+    static inline int Compare(const std::string& a, const char* b, size_t length) {
+      const int cmp = a.compare(0, std::string::npos, b, length);
+      return (cmp<0) ? -1 : (cmp>0) ? 1 : 0;
+    }
+    struct CompareIndices {
+      CompareIndices(const std::vector<std::string>& names) : n(names) {;}
+      bool operator()(size_t a, size_t b) const { return n[a]<n[b]; }
+      const std::vector<std::string>& n;
+    };
+    std::vector<std::string> fNames;
+    std::vector<size_t> fSorted;
+};
+
 /**
  * Generate a list of message types (with a struct / string matching), given a
  * set of computer-readable names provided as an argument.
@@ -41,13 +87,15 @@ inline std::vector<std::string> sar(const char* a, const char* b)
  */
 #define MESSAGES_ENUM(m1, ...)\
   enum MessageKey { m1=0, __VA_ARGS__  };\
-  inline std::string MessageKeyToString(MessageKey value) {\
-    std::vector<std::string> s=sar(#m1, #__VA_ARGS__);\
-    return (((unsigned int)value<s.size())&&(value>=0)) ? s[value] : s[0]; } \
+  inline const MessageKeyTable& MessageKeys() {\
+    static const MessageKeyTable table(#m1, #__VA_ARGS__);\
+    return table; }\
+  inline const std::string& MessageKeyToString(MessageKey value) {\
+    return MessageKeys().Name(value); } \
+  inline const MessageKey MessageKeyToObject(const char* value, size_t length) {\
+    return (MessageKey)MessageKeys().Find(value, length); }\
   inline const MessageKey MessageKeyToObject(const char* value) {\
-    std::vector<std::string> s=sar(#m1, #__VA_ARGS__);\
-    for (size_t i=0; i<s.size(); i++) { if (s[i]==std::string(value)) return (MessageKey)i; }\
-    return (MessageKey)(-1); }
+    return MessageKeyToObject(value, strlen(value)); }
 
 #endif
 
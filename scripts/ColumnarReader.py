@@ -0,0 +1,64 @@
+#!/usr/bin/env python
+
+# Memory-mapped reader for the chunked columnar files produced by test/write_columns
+# (format described in include/ColumnarFile.h)
+
+import sys, struct
+import numpy as np
+
+class ColumnarReader:
+    MAGIC = 0x43535050
+    MAX_COLUMNS = 8
+    NAME_LENGTH = 16
+
+    def __init__(self, filename):
+        self.data = np.memmap(filename, dtype=np.uint8, mode='r')
+        header = struct.unpack_from('<7I', self.data, 0)
+        if header[0] != self.MAGIC:
+            raise IOError("Invalid columnar file \"%s\"" % filename)
+        (self.magic, self.version, self.run_id, self.spill_id, self.board_address, self.acq_mode, _) = header
+        self.time_lsb, num_columns = struct.unpack_from('<fI', self.data, 24)
+        self.columns = []
+        for i in range(num_columns):
+            name = struct.unpack_from('%ds' % self.NAME_LENGTH, self.data, 32+i*self.NAME_LENGTH)[0]
+            self.columns.append(name.split(b'\0')[0].decode())
+        self.header_size = 32+self.MAX_COLUMNS*self.NAME_LENGTH
+        self.chunk_size = 8+2*4*self.MAX_COLUMNS
+
+        num_chunks, magic = struct.unpack_from('<2I', self.data, len(self.data)-8)
+        if magic != self.MAGIC:
+            raise IOError("Incomplete columnar file \"%s\"" % filename)
+        self.offsets = np.frombuffer(self.data, dtype='<u8', count=num_chunks, offset=len(self.data)-8-8*num_chunks)
+
+    def num_chunks(self):
+        return len(self.offsets)
+
+    def chunk_range(self, chunk, column):
+        """Smallest and largest values of a column in one chunk"""
+        i = self.columns.index(column)
+        off = int(self.offsets[chunk])
+        return struct.unpack_from('<I', self.data, off+8+4*i)[0], struct.unpack_from('<I', self.data, off+8+4*(self.MAX_COLUMNS+i))[0]
+
+    def chunk(self, chunk, column):
+        """Array of all values of a column in one chunk (no copy)"""
+        i = self.columns.index(column)
+        off = int(self.offsets[chunk])
+        num_rows = struct.unpack_from('<I', self.data, off+4)[0]
+        return np.frombuffer(self.data, dtype='<u4', count=num_rows, offset=off+self.chunk_size+4*i*num_rows)
+
+    def column(self, column):
+        """All values of a column in the file"""
+        if self.num_chunks() == 0:
+            return np.zeros(0, dtype='<u4')
+        return np.concatenate([self.chunk(c, column) for c in range(self.num_chunks())])
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print("Usage: %s <columnar file>" % sys.argv[0])
+        sys.exit(0)
+    reader = ColumnarReader(sys.argv[1])
+    print("Run %d, burst %d, board 0x%08x: %d chunk(s)" % (reader.run_id, reader.spill_id, reader.board_address, reader.num_chunks()))
+    for name in reader.columns:
+        values = reader.column(name)
+        if len(values) > 0:
+            print("  %-16s %d values in [%d, %d]" % (name, len(values), values.min(), values.max()))
@@ -11,6 +11,10 @@ import pylab as P
 import matplotlib as mpl
 import matplotlib.mlab as mlab
 import matplotlib.pyplot as plt
+try:
+    import PPSDecoder
+except ImportError:
+    PPSDecoder = None
 
 class DQMReader:
     def __init__(self,input):
@@ -108,8 +112,53 @@ class DQMReader:
 
     #############################################################
     # Main method for analyzing a single binary HPTDC output file
-    #############################################################                                                                                                                                  
+    #############################################################
     def ReadFile(self):
+        # Decoding is delegated to the C++ reader whenever its library is available
+        if PPSDecoder is not None:
+            try:
+                self.ReadFileNative()
+                return
+            except ImportError as e:
+                print "Native decoder unavailable (" + str(e) + "), falling back to python decoding"
+        self.ReadFilePython()
+
+    def ReadFileNative(self):
+        dec = PPSDecoder.Decoder(self.inputbinaryfile)
+        hits = dec.hits()
+        stats = dec.stats()
+        dec.close()
+        if(self.verbose == 1):
+            print "File header"
+            print "\trun_id = " + str(dec.info.run_id)
+            print "\tspill_id = " + str(dec.info.spill_id)
+            print "\tnum_hptdc = " + str(dec.info.num_hptdc)
+            print "\tAcquisitionMode = " + str(hex(dec.info.acq_mode))
+            print "\tDetectionMode = " + str(hex(dec.info.det_mode))
+            print "Decoded " + str(len(hits['tot'])) + " hits in " + str(stats.num_triggers) + " triggers"
+
+        # as in the python decoding, all trailing edges are counted, paired or not
+        occupancy = list(stats.trailing_edges)+[0]*(self.nchannels-PPSDecoder.NUM_CHANNELS)
+        tot = np.bincount(hits['channel_id'], weights=hits['tot']*25./1024., minlength=self.nchannels)
+        k = 0
+        while k < self.nchannels:
+            self.occupancy[k] = self.occupancy[k]+int(occupancy[k])
+            self.toverthreshold[k] = self.toverthreshold[k]+float(tot[k])
+            k=k+1
+        self.ntriggers[0] = self.ntriggers[0]+stats.num_triggers
+
+        self.nerrors[0] = self.nerrors[0]+stats.num_errors
+        self.eventsizelimiterrors[0] = self.eventsizelimiterrors[0]+stats.error_flags[12]
+        self.triggerfifooverflowerrors[0] = self.triggerfifooverflowerrors[0]+stats.error_flags[13]
+        self.internalchiperrors[0] = self.internalchiperrors[0]+stats.error_flags[14]
+        j = 0
+        while j < self.ngroups:
+            self.grouperrors[j] = self.grouperrors[j]+stats.error_flags[2+3*j]
+            self.l1bufferoverflowerrors[j] = self.l1bufferoverflowerrors[j]+stats.error_flags[1+3*j]
+            self.readoutfifooverflowerrors[j] = self.readoutfifooverflowerrors[j]+stats.error_flags[3*j]
+            j=j+1
+
+    def ReadFilePython(self):
 
         with open(self.inputbinaryfile, 'rb') as f:
             # First read and unpack the file header
@@ -131,12 +180,13 @@ class DQMReader:
                 print "\tAcquisitionMode = " + str(hex(AcquisitionMode))
                 print "\tDetectionMode = " + str(hex(DetectionMode))
 
-            # Lookup dictionary of time measurements: time = {Channel ID, Leading/Trailing edge}
+            # Lookup dictionary of time measurements: time = {Channel ID, Leading/Trailing edge/Leading edge pending}
             channeltimemeasurements={}
             k = 0
             while k < self.nchannels:
                 channeltimemeasurements[k,1]=0
                 channeltimemeasurements[k,2]=0
+                channeltimemeasurements[k,3]=0
                 k=k+1
 
             ###########################                                                                                                                               
@@ -160,6 +210,7 @@ class DQMReader:
                     while k < self.nchannels:
                         channeltimemeasurements[k,1]=0
                         channeltimemeasurements[k,2]=0
+                        channeltimemeasurements[k,3]=0
                         k=k+1
 
                 # This word is a global trailer - calculate summary timing information for all channels in this event
@@ -175,8 +226,7 @@ class DQMReader:
                     while channelflag < self.nchannels:
                         tleading = channeltimemeasurements[channelflag,1] * 25./1024.
                         ttrailing = channeltimemeasurements[channelflag,2] * 25./1024.
-                        tdifference = (channeltimemeasurements[channelflag,1] - channeltimemeasurements[channelflag,2]) * 25./1024.
-                        self.toverthreshold[channelflag] = self.toverthreshold[channelflag] + tdifference
+                        tdifference = (channeltimemeasurements[channelflag,2] - channeltimemeasurements[channelflag,1]) * 25./1024.
 
                         if(self.verbose == 1):
                             print "\t\t" + str(channelflag) + ":\t" + str(tleading) + ",\t" + str(ttrailing) + ",\t" + str(tdifference)
@@ -224,9 +274,15 @@ class DQMReader:
 
                     if(istrailing == 0):
                         channeltimemeasurements[channelid,1] = time
+                        channeltimemeasurements[channelid,3] = 1
                     if(istrailing == 1):
                         channeltimemeasurements[channelid,2] = time
                         self.occupancy[channelid] = self.occupancy[channelid]+1
+                        # as in the native decoding, each trailing edge paired with a leading edge of this trigger adds its ToT
+                        if(channeltimemeasurements[channelid,3] == 1):
+                            tot = (time - channeltimemeasurements[channelid,1]) & (0x7FFFF)
+                            self.toverthreshold[channelid] = self.toverthreshold[channelid] + tot * 25./1024.
+                            channeltimemeasurements[channelid,3] = 0
 
                     if(self.verbose == 1):
                         print "\tTDCMeasurement (trailing = " + str(istrailing) + ", time = " + str(time) + ", width = " + str(width) + ", (channel ID = " + str(channelid) + ")"
@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+
+# ctypes wrapper around the libppsdecoder C interface (see include/PPSDecoder.h).
+# Hits are decoded by the C++ reader directly into NumPy arrays.
+
+import os, sys, ctypes
+import numpy as np
+
+API_VERSION = 2
+NUM_ERROR_FLAGS = 15
+NUM_CHANNELS = 32
+CHUNK_HITS = 1<<20
+COLUMNS = ['trigger', 'event_count', 'channel_id', 'leading_time', 'tot']
+
+class FileInfo(ctypes.Structure):
+    _fields_ = [('run_id', ctypes.c_uint32), ('spill_id', ctypes.c_uint32), ('num_hptdc', ctypes.c_uint32),
+                ('acq_mode', ctypes.c_uint32), ('det_mode', ctypes.c_uint32)]
+
+class Hits(ctypes.Structure):
+    _fields_ = [(name, ctypes.POINTER(ctypes.c_uint32)) for name in COLUMNS]
+
+class Stats(ctypes.Structure):
+    _fields_ = [('num_words', ctypes.c_uint64), ('num_triggers', ctypes.c_uint64), ('num_hits', ctypes.c_uint64),
+                ('num_errors', ctypes.c_uint64), ('error_flags', ctypes.c_uint64*NUM_ERROR_FLAGS),
+                ('trailing_edges', ctypes.c_uint64*NUM_CHANNELS)]
+
+def LoadLibrary():
+    """Search the decoder library in the build directory, then in the system paths"""
+    paths = []
+    if os.getenv('PPS_PATH'): paths.append(os.path.join(os.getenv('PPS_PATH'), 'libppsdecoder.so'))
+    paths.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'build', 'libppsdecoder.so'))
+    paths.append('libppsdecoder.so')
+    for path in paths:
+        try: lib = ctypes.CDLL(path)
+        except OSError: continue
+        lib.pps_decoder_api_version.restype = ctypes.c_int
+        if lib.pps_decoder_api_version() != API_VERSION:
+            raise ImportError('Incompatible decoder library version in %s' % path)
+        lib.pps_decoder_open.restype = ctypes.c_void_p
+        lib.pps_decoder_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t]
+        lib.pps_decoder_close.argtypes = [ctypes.c_void_p]
+        lib.pps_decoder_get_info.argtypes = [ctypes.c_void_p, ctypes.POINTER(FileInfo)]
+        lib.pps_decoder_read_hits.restype = ctypes.c_long
+        lib.pps_decoder_read_hits.argtypes = [ctypes.c_void_p, ctypes.POINTER(Hits), ctypes.c_size_t]
+        lib.pps_decoder_get_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(Stats)]
+        return lib
+    raise ImportError('Decoder library libppsdecoder.so not found')
+
+_lib = None
+
+class Decoder:
+    def __init__(self, filename):
+        global _lib
+        if _lib is None: _lib = LoadLibrary()
+        error = ctypes.create_string_buffer(256)
+        self.handle = _lib.pps_decoder_open(filename.encode(), error, len(error))
+        if not self.handle:
+            raise IOError(error.value.decode())
+        self.info = FileInfo()
+        _lib.pps_decoder_get_info(self.handle, ctypes.byref(self.info))
+
+    def __del__(self):
+        self.close()
+
+    def close(self):
+        if getattr(self, 'handle', None):
+            _lib.pps_decoder_close(self.handle)
+            self.handle = None
+
+    def hits(self, chunk=CHUNK_HITS):
+        """Decode all hits of the file, returned as a dictionary of arrays"""
+        chunks = []
+        while True:
+            arrays = dict((name, np.empty(chunk, dtype=np.uint32)) for name in COLUMNS)
+            buffers = Hits(*[arrays[name].ctypes.data_as(ctypes.POINTER(ctypes.c_uint32)) for name in COLUMNS])
+            num = _lib.pps_decoder_read_hits(self.handle, ctypes.byref(buffers), chunk)
+            if num < 0:
+                raise IOError('Failed to decode the file')
+            if num > 0:
+                chunks.append(dict((name, arrays[name][:num]) for name in COLUMNS))
+            if num < chunk: break
+        if len(chunks) == 1: return chunks[0]
+        if len(chunks) == 0: return dict((name, np.zeros(0, dtype=np.uint32)) for name in COLUMNS)
+        return dict((name, np.concatenate([c[name] for c in chunks])) for name in COLUMNS)
+
+    def stats(self):
+        """Counters of all words decoded so far"""
+        stats = Stats()
+        _lib.pps_decoder_get_stats(self.handle, ctypes.byref(stats))
+        return stats
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('Usage: %s <raw file>' % sys.argv[0])
+        sys.exit(0)
+    dec = Decoder(sys.argv[1])
+    hits = dec.hits()
+    stats = dec.stats()
+    print('Run %d, burst %d: %d hits in %d triggers, %d errors' % (dec.info.run_id, dec.info.spill_id, len(hits['tot']), stats.num_triggers, stats.num_errors))
+    print('Hits per channel: %s' % np.bincount(hits['channel_id'], minlength=32).tolist())
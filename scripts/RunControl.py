@@ -192,6 +192,10 @@ class DAQgui:
     try:
       self.socket_handler = SocketHandler('localhost', 1987) 
       self.socket_handler.Handshake(5) # 5=DAQ
+      # only what is displayed is to be received
+      self.socket_handler.Unsubscribe('NEW_DQM_PLOT')
+      self.socket_handler.Unsubscribe('UPDATED_DQM_PLOT')
+      self.socket_handler.Subscribe('HV_STATUS', [0, 3])
       self.bind_button.set_sensitive(False)
       self.unbind_button.set_sensitive(True)
       self.start_button.set_sensitive(not self.acquisition_started)
@@ -3,7 +3,36 @@ import asyncore
 import socket
 import sys
 import os, re
-from cStringIO import StringIO
+import struct
+
+# Framing of the socket messages (see include/MessageFrame.h)
+FRAME_MAGIC = (0xFE, 0x50)
+FRAME_HEADER = '>BBBBI'
+FRAME_HEADER_SIZE = struct.calcsize(FRAME_HEADER)
+FRAME_BINARY = 0x1
+FRAME_REQUEST = 0x2
+FRAME_REQUEST_ID_SIZE = 4
+FRAME_SEQUENCE = 0x4
+FRAME_SEQUENCE_SIZE = 8
+
+def EncodeFrame(payload):
+  flags = FRAME_BINARY if '\0' in payload else 0
+  return struct.pack(FRAME_HEADER, FRAME_MAGIC[0], FRAME_MAGIC[1], flags, 0, len(payload))+payload
+
+def DecodeFrames(buf):
+  """Split a buffer into the payloads of its complete frames, and the remaining bytes"""
+  payloads = []
+  while len(buf)>=FRAME_HEADER_SIZE:
+    magic0, magic1, flags, _, length = struct.unpack(FRAME_HEADER, buf[:FRAME_HEADER_SIZE])
+    if (magic0, magic1)!=FRAME_MAGIC:
+      raise ValueError('Invalid frame header received')
+    start = FRAME_HEADER_SIZE
+    if flags & FRAME_REQUEST: start += FRAME_REQUEST_ID_SIZE # request identifier, not used here
+    if flags & FRAME_SEQUENCE: start += FRAME_SEQUENCE_SIZE # sequence number of a published message, not used here
+    if len(buf)<start+length: break
+    payloads.append(buf[start:start+length])
+    buf = buf[start+length:]
+  return payloads, buf
 
 class AsyncClient(asyncore.dispatcher):
   def __init__(self, host, port):
@@ -12,7 +41,8 @@ class AsyncClient(asyncore.dispatcher):
     address = (host, port)
     self.connect(address)
     self.write_buffer = ''
-    self.read_buffer = StringIO()
+    self.read_buffer = ''
+    self.messages = []
 
   def handle_connect(self):
     print 'handle_connect()'
@@ -35,24 +65,25 @@ class AsyncClient(asyncore.dispatcher):
     #print 'handle_read()'
     data = self.recv(8192)
     if data:
-      self.read_buffer.write(data)
-      raise asyncore.ExitNow('Message fetched!')
+      self.read_buffer += data
+      payloads, self.read_buffer = DecodeFrames(self.read_buffer)
+      for payload in payloads:
+        out = payload.split(':')
+        self.messages.append((out[0], ':'.join(out[1:])))
+      if len(self.messages)>0:
+        raise asyncore.ExitNow('Message fetched!')
 
   def fileno(self):
     return self.socket.fileno()
 
   def serve_until_message(self):
-    try:
-      asyncore.loop(1, 5)
-    except asyncore.ExitNow, e:
-      #_split = re.compile(r'[\0%s]' % re.escape(''.join([os.path.sep, os.path.altsep or ''])))
-      msgs = []
-      for msg in self.read_buffer.getvalue().split('\0'):
-        out = msg.split(':')
-        msgs.append((out[0], ':'.join(out[1:]).replace('\0', '')))
-      self.read_buffer = StringIO()
-      #return (out[0], _split.sub('', ':'.join(out[1:])))
-      return msgs
+    if len(self.messages)==0:
+      try:
+        asyncore.loop(1, 5)
+      except asyncore.ExitNow, e:
+        pass
+    msgs, self.messages = self.messages, []
+    return msgs
 
 class SocketHandler:
   class SocketError(Exception):
@@ -102,6 +133,15 @@ class SocketHandler:
 
   def GetClientId(self): return self.client_id
 
+  def Subscribe(self, key, attributes=[]):
+    """Receive the messages of this key (only the ones whose value starts with one of the attributes, if given)"""
+    value = key
+    if len(attributes)>0: value += ':'+','.join([str(a) for a in attributes])
+    return self.Send('SUBSCRIBE', value)
+
+  def Unsubscribe(self, key):
+    return self.Send('UNSUBSCRIBE', key)
+
   def Disconnect(self):
     try:
       self.Send('REMOVE_CLIENT', self.client_id)
@@ -120,15 +160,20 @@ class SocketHandler:
       num_trials += 1
       out = self.socket.serve_until_message()
       if not out: continue
-      if not key: return out[0] #FIXME what about the others?
+      if not key:
+        # other messages received along are kept for the next calls
+        self.socket.messages = out[1:]+self.socket.messages
+        return out[0]
       print out
-      for msg in out:
-        if len(msg)>1 and msg[0]==key: return msg
+      for i in range(len(out)):
+        if len(out[i])>1 and out[i][0]==key:
+          self.socket.messages = out[i+1:]+self.socket.messages
+          return out[i]
       if num_trials>max_num_trials: return None
 
   def Send(self, key, value):
     try:
-      self.socket.sendall(key+':'+str(value))
+      self.socket.sendall(EncodeFrame(key+':'+str(value)))
     except socket.error:
       raise self.SendingError
     return True
@@ -9,5 +9,6 @@ if [ -z "$2" ] ; then
   exit
 fi
 
-python $PPS_BASE_PATH/scripts/run_over_all_files.py $1 $2 && hadd -f "run"$1"_board"$2".root" $PPS_DATA_PATH/events_$1_*_board$2.root 
+# all spills are converted in parallel (with the write_tree layout), and merged in order
+$PPS_PATH/test/write_tree_run $2 $1 "run"$1"_board"$2".root" 
 
@@ -1,12 +1,26 @@
 #include "Client.h"
 
 Client::Client(int port) :
-  Socket(port), fClientId(-1), fIsConnected(false)
-{}
+  Socket(port), fClientId(-1), fIsConnected(false), fLastRequestId(0)
+{
+  InitConnectionLock();
+  SetLocalPath(GetLocalPath());
+}
 
 Client::~Client()
 {
   if (fIsConnected) Disconnect();
+  pthread_mutex_destroy(&fConnectionMutex);
+}
+
+void
+Client::InitConnectionLock()
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&fConnectionMutex, &attr);
+  pthread_mutexattr_destroy(&attr);
 }
 
 bool
@@ -14,8 +28,7 @@ Client::Connect(const SocketType& type)
 {
   fType = type;
   try {
-    Start();
-    PrepareConnection();
+    Open(Fatal);
     Announce();
   } catch (Exception& e) { 
     e.Dump();
@@ -25,34 +38,114 @@ Client::Connect(const SocketType& type)
   fIsConnected = true;
   return true;
 }
+
+void
+Client::Open(const ExceptionType& type)
+{
+  if (IsLocal()) {
+    // the local socket is preferred, TCP being kept as a fallback (e.g. for an older master)
+    try {
+      Start();
+      PrepareConnection();
+      return;
+    } catch (Exception& e) {
+      std::ostringstream os; os << "Failed to reach the master through the local socket " << fLocalPath << ", trying TCP";
+      PrintInfo(os.str());
+      SetLocalPath("");
+    }
+  }
+  Start();
+  PrepareConnection(type);
+}
   
 void
 Client::Announce()
 {
-  try {
-    // Once connected we send our request for connection
-    SendMessage(SocketMessage(ADD_CLIENT, static_cast<int>(GetType())));
-    
-    // Then we wait for to the server to send us a connection acknowledgement
-    // + an id
-    SocketMessage ack(FetchMessage());
-    
-    switch (ack.GetKey()) {
-      case SET_CLIENT_ID:
-        fClientId = ack.GetIntValue();
-        break;
-      case INVALID_KEY:
-      default:
-        throw Exception(__PRETTY_FUNCTION__, "Received an invalid answer from server", JustWarning);
+  // Once connected we send our request for connection, along with the
+  // subscriptions and the messages to replay
+  std::string frames = MessageFramer::Encode(SocketMessage(ADD_CLIENT, static_cast<int>(GetType())).GetString());
+  for (std::map<MessageKey, std::vector<std::string> >::const_iterator sub=fSubscriptions.begin(); sub!=fSubscriptions.end(); sub++) {
+    frames += MessageFramer::Encode(SubscriptionMessage(sub->first, sub->second).GetString());
+  }
+  for (std::set<MessageKey>::const_iterator unsub=fUnsubscriptions.begin(); unsub!=fUnsubscriptions.end(); unsub++) {
+    frames += MessageFramer::Encode(SocketMessage(UNSUBSCRIBE, MessageKeyToString(*unsub)).GetString());
+  }
+  if (!fLastSequences.empty()) {
+    std::ostringstream os;
+    for (std::map<MessageKey,uint64_t>::const_iterator seq=fLastSequences.begin(); seq!=fLastSequences.end(); seq++) {
+      if (seq!=fLastSequences.begin()) os << ";";
+      os << MessageKeyToString(seq->first) << ":" << seq->second;
     }
+    frames += MessageFramer::Encode(SocketMessage(RESUME, os.str()).GetString());
+  }
+  SendFrames(frames);
     
-  } catch (Exception& e) {
-    e.Dump();
+  // Then we wait for to the server to send us a connection acknowledgement
+  // + an id
+  SocketMessage ack(FetchMessage());
+  if (ack.GetKey()!=SET_CLIENT_ID) {
+    throw Exception(__PRETTY_FUNCTION__, "Received an invalid answer from server", JustWarning);
   }
+  fClientId = ack.GetIntValue();
   
   std::cout << __PRETTY_FUNCTION__ << " connected to socket at port " << GetPort() << ", received id \"" << fClientId << "\""<< std::endl;
 }
 
+void
+Client::Reconnect()
+{
+  PrintInfo("Connection to the master lost, reconnecting...");
+  // no other thread may send until the connection is reopened
+  LockConnection();
+  Stop();
+  fInput = MessageFramer(); // the end of the previous connection is lost
+  SetLocalPath(GetLocalPath());
+  for (unsigned int i=0; i<CLIENT_RECONNECT_ATTEMPTS; i++) {
+    sleep(CLIENT_RECONNECT_DELAY);
+    try {
+      Open(JustWarning);
+      Announce();
+      UnlockConnection();
+      return;
+    } catch (Exception& e) {
+      Stop();
+      fInput = MessageFramer();
+    }
+  }
+  fIsConnected = false;
+  UnlockConnection();
+  std::ostringstream os; os << "Master not reachable after " << CLIENT_RECONNECT_ATTEMPTS << " attempts!";
+  throw Exception(__PRETTY_FUNCTION__, os.str(), Fatal);
+}
+
+bool
+Client::IsDisconnection(const Exception& e)
+{
+  return (e.ErrorNumber()==11000 or e.ErrorNumber()==SOCKET_ERROR(ECONNRESET));
+}
+
+bool
+Client::Acknowledge(const SocketMessage& m)
+{
+  if (m.GetKey()==RESUMED) {
+    const std::string& value = m.GetValue();
+    const size_t end = value.find(':');
+    const unsigned long num_lost = (end!=std::string::npos) ? strtoul(value.c_str()+end+1, NULL, 10) : 0;
+    std::ostringstream os; os << "Session resumed, " << atoi(value.c_str()) << " messages replayed";
+    if (num_lost>0) {
+      os << ", " << num_lost << " messages no longer available!";
+      Exception(__PRETTY_FUNCTION__, os.str(), JustWarning).Dump();
+    }
+    else PrintInfo(os.str());
+    return false;
+  }
+  if (m.GetSequence()==0) return true;
+  uint64_t& last = fLastSequences[m.GetKey()];
+  if (m.GetSequence()<=last) return false; // already received before reconnecting
+  last = m.GetSequence();
+  return true;
+}
+
 void
 Client::Disconnect()
 {
@@ -75,6 +168,37 @@ Client::Disconnect()
   }
 }
 
+SocketMessage
+Client::SubscriptionMessage(const MessageKey& key, const std::vector<std::string>& attributes)
+{
+  std::ostringstream os; os << MessageKeyToString(key);
+  for (std::vector<std::string>::const_iterator a=attributes.begin(); a!=attributes.end(); a++) {
+    os << ((a==attributes.begin()) ? ":" : ",") << *a;
+  }
+  return SocketMessage(SUBSCRIBE, os.str());
+}
+
+void
+Client::Subscribe(const MessageKey& key, const std::vector<std::string>& attributes) const
+{
+  // before connecting, the subscription is only sent along with the announcement
+  LockConnection();
+  try { if (fIsConnected) SendMessage(SubscriptionMessage(key, attributes)); } catch (Exception& e) { UnlockConnection(); throw e; }
+  fSubscriptions[key] = attributes;
+  fUnsubscriptions.erase(key);
+  UnlockConnection();
+}
+
+void
+Client::Unsubscribe(const MessageKey& key) const
+{
+  LockConnection();
+  try { if (fIsConnected) SendMessage(SocketMessage(UNSUBSCRIBE, MessageKeyToString(key))); } catch (Exception& e) { UnlockConnection(); throw e; }
+  fSubscriptions.erase(key);
+  fUnsubscriptions.insert(key);
+  UnlockConnection();
+}
+
 void
 Client::Receive()
 {
@@ -82,11 +206,11 @@ Client::Receive()
   try {
     msg = FetchMessage();
   } catch (Exception& e) {
-    if (e.ErrorNumber()==11000) // client has been disconnected
-      throw Exception(__PRETTY_FUNCTION__, "Some other socket asked for this client's disconnection. Obtemperating...", Fatal);
+    if (IsDisconnection(e)) { Reconnect(); return; }
   }
+  if (!Acknowledge(msg)) return;
   if (msg.GetKey()==MASTER_DISCONNECT) {
-    throw Exception(__PRETTY_FUNCTION__, "Master disconnected!", Fatal);
+    Reconnect();
   }
   else if (msg.GetKey()==OTHER_CLIENT_DELETED) {
     throw Exception(__PRETTY_FUNCTION__, "Some other socket asked for this client's disconnection. Obtemperating...", Fatal);
@@ -96,7 +220,9 @@ Client::Receive()
   } 
   else if (msg.GetKey()==PING_CLIENT) {
     std::ostringstream os; os << "Pong. My name is " << GetSocketId() << " and I feel fine, thank you!";
-    Send(SocketMessage(PING_ANSWER, os.str()));
+    SocketMessage answer(PING_ANSWER, os.str());
+    answer.SetRequestId(msg.GetRequestId());
+    Send(answer);
     PrintInfo("Got a ping, answering...");
   } 
   else if (msg.GetKey()==CLIENTS_LIST) {
@@ -117,13 +243,49 @@ SocketMessage
 Client::Receive(const MessageKey& key)
 {
   SocketMessage msg;
-  try {
-    msg = FetchMessage();
-    if (msg.GetKey()==key) { return msg; }
-  } catch (Exception& e) {
-    if (e.ErrorNumber()==11000) // client has been disconnected
-      throw Exception(__PRETTY_FUNCTION__, "Some other socket asked for this client's disconnection. Obtemperating...", Fatal);
-    e.Dump();
+  while (true) {
+    try {
+      msg = FetchMessage();
+    } catch (Exception& e) {
+      if (IsDisconnection(e)) { Reconnect(); continue; }
+      e.Dump();
+      return msg;
+    }
+    // the messages missed while disconnected are received once reconnected
+    if (msg.GetKey()==MASTER_DISCONNECT) { Reconnect(); continue; }
+    if (Acknowledge(msg)) return msg;
   }
-  return msg;
+}
+
+SocketMessage
+Client::SendAndReceive(const SocketMessage& m, const MessageKey& a) const
+{
+  LockConnection();
+  SocketMessage request(m);
+  if (++fLastRequestId==0) fLastRequestId++; // 0 is for messages outside of any request
+  request.SetRequestId(fLastRequestId);
+  try {
+    SendMessage(request);
+    struct timeval now, deadline, left;
+    gettimeofday(&deadline, NULL);
+    deadline.tv_sec += CLIENT_REQUEST_TIMEOUT;
+    while (true) {
+      if (!HasBufferedMessage()) {
+        gettimeofday(&now, NULL);
+        if (timercmp(&now, &deadline, <)) timersub(&deadline, &now, &left);
+        else timerclear(&left);
+        fd_set fds; FD_ZERO(&fds); FD_SET(GetSocketId(), &fds);
+        const int ret = select(GetSocketId()+1, &fds, NULL, NULL, &left);
+        if (ret<0 and errno==EINTR) continue;
+        if (ret<0) throw Exception(__PRETTY_FUNCTION__, "Failed to wait for the answer!", JustWarning, SOCKET_ERROR(errno));
+        if (ret==0) {
+          std::ostringstream o; o << "No answer received to " << MessageKeyToString(m.GetKey()) << " after " << CLIENT_REQUEST_TIMEOUT << " s";
+          throw Exception(__PRETTY_FUNCTION__, o.str(), JustWarning, 11020);
+        }
+      }
+      // the other messages received meanwhile (e.g. broadcasts of the same key) are skipped
+      SocketMessage msg(FetchMessage());
+      if (msg.GetKey()==a and msg.GetRequestId()==request.GetRequestId()) { UnlockConnection(); return msg; }
+    }
+  } catch (Exception& e) { UnlockConnection(); e.Dump(); throw e; }
 }
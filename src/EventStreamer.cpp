@@ -0,0 +1,288 @@
+#include "EventStreamer.h"
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sstream>
+
+EventStreamer::EventStreamer(int port) :
+  fPort(port), fSocketId(-1), fEpollFd(-1), fTap(SharedMemoryTap::SkipToLatest)
+{}
+
+EventStreamer::~EventStreamer()
+{
+  Disconnect();
+}
+
+bool
+EventStreamer::Connect()
+{
+  try {
+    if ((fSocketId=socket(AF_INET, SOCK_STREAM, 0))<0) {
+      throw Exception(__PRETTY_FUNCTION__, "Cannot create the stream socket!", JustWarning, 44100);
+    }
+    const int on = 1;
+    setsockopt(fSocketId, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(fPort);
+    if (bind(fSocketId, (struct sockaddr*)&address, sizeof(address))<0 or listen(fSocketId, 20)<0) {
+      std::ostringstream os; os << "Cannot listen on the stream port " << fPort << ": " << strerror(errno);
+      throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 44100);
+    }
+    fcntl(fSocketId, F_SETFL, fcntl(fSocketId, F_GETFL, 0)|O_NONBLOCK);
+    if ((fEpollFd=epoll_create(STREAM_MAX_EVENTS))<0) {
+      throw Exception(__PRETTY_FUNCTION__, "Cannot create the events polling instance!", JustWarning, 44100);
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN|EPOLLET;
+    ev.data.fd = fSocketId;
+    if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fSocketId, &ev)<0) {
+      throw Exception(__PRETTY_FUNCTION__, "Cannot register the stream socket for polling!", JustWarning, 44100);
+    }
+  } catch (Exception& e) {
+    e.Dump();
+    Disconnect();
+    return false;
+  }
+  std::ostringstream os; os << "Streaming the live events on port " << fPort;
+  PrintInfo(os.str());
+  return true;
+}
+
+void
+EventStreamer::Disconnect()
+{
+  while (!fConsumers.empty()) RemoveConsumer(fConsumers.begin()->first);
+  if (fEpollFd>=0) { close(fEpollFd); fEpollFd = -1; }
+  if (fSocketId>=0) { close(fSocketId); fSocketId = -1; }
+}
+
+void
+EventStreamer::AddConsumers()
+{
+  while (true) {
+    const int sid = accept(fSocketId, NULL, NULL);
+    if (sid<0) {
+      if (errno==EINTR) continue;
+      if (errno==EAGAIN or errno==EWOULDBLOCK) break;
+      throw Exception(__PRETTY_FUNCTION__, "Cannot accept consumer!", JustWarning, 44101);
+    }
+    fcntl(sid, F_SETFL, fcntl(sid, F_GETFL, 0)|O_NONBLOCK);
+    struct epoll_event ev;
+    ev.events = EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET;
+    ev.data.fd = sid;
+    if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, sid, &ev)<0) {
+      close(sid);
+      throw Exception(__PRETTY_FUNCTION__, "Cannot register the consumer for polling!", JustWarning, 44101);
+    }
+    fConsumers[sid] = Consumer();
+    std::ostringstream os; os << "New stream consumer with # " << sid;
+    PrintInfo(os.str());
+  }
+}
+
+void
+EventStreamer::RemoveConsumer(int sid)
+{
+  std::map<int,Consumer>::iterator c = fConsumers.find(sid);
+  if (c==fConsumers.end()) return;
+  std::ostringstream os; os << "Stream consumer # " << sid << " disconnected after " << c->second.sequence << " blocks sent ("
+                            << c->second.num_dropped << " events dropped)";
+  PrintInfo(os.str());
+  epoll_ctl(fEpollFd, EPOLL_CTL_DEL, sid, NULL);
+  close(sid);
+  fConsumers.erase(c);
+  fBrokenConsumers.erase(sid);
+}
+
+void
+EventStreamer::Process()
+{
+  struct epoll_event events[STREAM_MAX_EVENTS];
+  const int num_events = epoll_wait(fEpollFd, events, STREAM_MAX_EVENTS, STREAM_POLL_MS);
+  if (num_events<0 and errno!=EINTR) {
+    throw Exception(__PRETTY_FUNCTION__, "Impossible to poll the stream connections!", JustWarning, 44102);
+  }
+  for (int i=0; i<num_events; i++) {
+    const int sid = events[i].data.fd;
+    if (sid==fSocketId) {
+      try { AddConsumers(); } catch (Exception& e) { e.Dump(); }
+      continue;
+    }
+    if (fConsumers.find(sid)==fConsumers.end()) continue;
+    if ((events[i].events & (EPOLLIN|EPOLLRDHUP|EPOLLHUP|EPOLLERR)) and !ReadConsumer(sid)) { fBrokenConsumers.insert(sid); continue; }
+    if ((events[i].events & EPOLLOUT) and !FlushConsumer(sid)) fBrokenConsumers.insert(sid);
+  }
+  PollTap();
+  while (!fBrokenConsumers.empty()) RemoveConsumer(*fBrokenConsumers.begin());
+}
+
+bool
+EventStreamer::ReadConsumer(int sid)
+{
+  Consumer& c = fConsumers[sid];
+  while (true) {
+    const ssize_t num_bytes = recv(sid, fBuffer, STREAM_MAX_INPUT, 0);
+    if (num_bytes>0) {
+      c.input.Append(fBuffer, num_bytes);
+      std::string payload;
+      try {
+        while (c.input.Next(&payload)) ProcessMessage(SocketMessage(payload), sid);
+      } catch (Exception& e) { e.Dump(); return false; }
+      if (c.input.GetBufferedSize()>STREAM_MAX_INPUT) return false;
+      continue;
+    }
+    if (num_bytes<0 and errno==EINTR) continue;
+    if (num_bytes<0 and (errno==EAGAIN or errno==EWOULDBLOCK)) return true;
+    return false; // disconnection or failure
+  }
+}
+
+void
+EventStreamer::ProcessMessage(const SocketMessage& m, int sid)
+{
+  Consumer& c = fConsumers[sid];
+  if (m.GetKey()==STREAM_CREDIT) {
+    const int credits = m.GetIntValue();
+    if (credits>0) c.credits += credits;
+    return;
+  }
+  if (m.GetKey()==STREAM_SUBSCRIBE) {
+    const std::string value = m.GetCleanedValue();
+    const size_t end = value.find(':');
+    const int prescale = atoi(value.substr(0, end).c_str());
+    c.prescale = (prescale>1) ? prescale : 1;
+    c.boards.clear();
+    c.num_seen.clear();
+    if (end!=std::string::npos) {
+      size_t start = end+1, pos;
+      do {
+        pos = value.find(',', start);
+        const std::string board = value.substr(start, (pos==std::string::npos) ? std::string::npos : pos-start);
+        if (!board.empty()) c.boards.insert(strtoul(board.c_str(), NULL, 0));
+        start = pos+1;
+      } while (pos!=std::string::npos);
+    }
+    c.subscribed = true;
+    std::ostringstream os; os << "Stream consumer # " << sid << " subscribed to " << (c.boards.empty() ? "all boards" : "the boards ");
+    for (std::set<uint32_t>::const_iterator b=c.boards.begin(); b!=c.boards.end(); b++) os << ((b!=c.boards.begin()) ? "," : "") << *b;
+    os << " with a prescaling factor of " << c.prescale;
+    PrintInfo(os.str());
+    return;
+  }
+  std::ostringstream os; os << "Invalid message received from stream consumer # " << sid << ": " << m.GetString();
+  throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 44103);
+}
+
+bool
+EventStreamer::FlushConsumer(int sid)
+{
+  Consumer& c = fConsumers[sid];
+  while (!c.output.empty()) {
+    const std::string& frame = c.output.front();
+    const ssize_t num_bytes = send(sid, frame.data()+c.output_offset, frame.size()-c.output_offset, MSG_NOSIGNAL);
+    if (num_bytes<0) {
+      if (errno==EINTR) continue;
+      if (errno==EAGAIN or errno==EWOULDBLOCK) return true; // the rest is sent once writable
+      return false;
+    }
+    c.output_offset += num_bytes;
+    c.output_size -= num_bytes;
+    if (c.output_offset==frame.size()) { c.output.pop_front(); c.output_offset = 0; }
+  }
+  return true;
+}
+
+void
+EventStreamer::PollTap()
+{
+  if (!fTap.IsAttached() or fTap.IsStale()) {
+    try {
+      if (!fTap.Attach()) return;
+    } catch (Exception& e) { e.Dump(); return; }
+    std::ostringstream os; os << "Attached to the live data tap with " << fTap.GetNumStreams() << " board(s)";
+    PrintInfo(os.str());
+  }
+  VME::TDCEventCollection events;
+  std::vector<size_t> ends;
+  for (unsigned int i=0; i<fTap.GetNumStreams(); i++) {
+    events.clear();
+    // the tap is always read, so that the consumers only get the newest events
+    if (fTap.Fetch(i, &events)==0) continue;
+    ends.clear();
+    if (fTap.GetFileHeader(i).acq_mode==VME::TRIG_MATCH) {
+      for (size_t j=0; j<events.size(); j++) {
+        if (events[j].GetType()==VME::TDCEvent::GlobalTrailer) ends.push_back(j+1);
+      }
+    }
+    else ends.push_back(events.size());
+    const uint32_t board_address = fTap.GetBoardAddress(i);
+    for (std::map<int,Consumer>::iterator c=fConsumers.begin(); c!=fConsumers.end(); c++) {
+      if (!c->second.subscribed or fBrokenConsumers.count(c->first)>0) continue;
+      if (!c->second.boards.empty() and c->second.boards.count(board_address)==0) continue;
+      SendEvents(c->first, c->second, i, events, ends);
+    }
+  }
+}
+
+void
+EventStreamer::SendEvents(int sid, Consumer& c, unsigned int stream, const VME::TDCEventCollection& events, const std::vector<size_t>& ends)
+{
+  const file_header_t header = fTap.GetFileHeader(stream);
+  stream_block_t block;
+  memset(&block, 0, sizeof(stream_block_t));
+  block.magic = STREAM_MAGIC;
+  block.board_address = fTap.GetBoardAddress(stream);
+  block.run_id = header.run_id;
+  block.spill_id = header.spill_id;
+  block.acq_mode = header.acq_mode;
+  block.det_mode = header.det_mode;
+  block.num_lost_words = fTap.GetNumLostWords(stream);
+
+  uint64_t& num_seen = c.num_seen[block.board_address];
+  std::vector<uint32_t> words;
+  size_t begin = 0;
+  for (std::vector<size_t>::const_iterator end=ends.begin(); end!=ends.end(); begin=*end, end++) {
+    if ((num_seen++)%c.prescale!=0) continue;
+    if (!words.empty() and words.size()+(*end-begin)>STREAM_MAX_BLOCK_WORDS) {
+      SendBlock(c, block, words);
+      words.clear(); block.num_events = 0;
+    }
+    for (size_t i=begin; i<*end; i++) words.push_back(events[i].GetWord());
+    block.num_events++;
+  }
+  if (block.num_events>0) SendBlock(c, block, words);
+  if (!FlushConsumer(sid)) fBrokenConsumers.insert(sid);
+}
+
+void
+EventStreamer::SendBlock(Consumer& c, stream_block_t& block, const std::vector<uint32_t>& words)
+{
+  // the slow consumers lose the events instead of delaying the others
+  if (c.credits==0 or c.output_size>=STREAM_MAX_OUTPUT) {
+    c.num_dropped += block.num_events;
+    return;
+  }
+  block.num_words = words.size();
+  block.sequence = c.sequence++;
+  block.num_dropped = c.num_dropped;
+  std::string payload(reinterpret_cast<const char*>(&block), sizeof(stream_block_t));
+  if (!words.empty()) payload.append(reinterpret_cast<const char*>(&words[0]), words.size()*sizeof(uint32_t));
+  try {
+    c.output.push_back(MessageFramer::EncodeBinary(payload.data(), payload.size()));
+  } catch (Exception& e) {
+    e.Dump();
+    c.num_dropped += block.num_events;
+    return;
+  }
+  c.output_size += c.output.back().size();
+  c.credits--;
+}
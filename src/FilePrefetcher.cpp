@@ -0,0 +1,161 @@
+#include "FilePrefetcher.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+FilePrefetcher::FilePrefetcher(unsigned int max_mb) :
+  fMaxBytes((size_t)max_mb*1024*1024), fBytesInFlight(0), fBytesPooled(0),
+  fStarted(false), fStop(false), fNumQueued(0), fNumDelivered(0)
+{
+  pthread_mutex_init(&fMutex, NULL);
+  pthread_cond_init(&fCondition, NULL);
+}
+
+FilePrefetcher::~FilePrefetcher()
+{
+  pthread_mutex_lock(&fMutex);
+  fStop = true;
+  pthread_cond_broadcast(&fCondition);
+  pthread_mutex_unlock(&fMutex);
+  if (fStarted) pthread_join(fThread, NULL);
+
+  for (std::deque<PrefetchedFile>::iterator f=fReady.begin(); f!=fReady.end(); f++) free(f->data);
+  for (std::vector<PrefetchedFile>::iterator f=fPool.begin(); f!=fPool.end(); f++) free(f->data);
+  pthread_cond_destroy(&fCondition);
+  pthread_mutex_destroy(&fMutex);
+}
+
+void
+FilePrefetcher::AddFile(const std::string& path)
+{
+  pthread_mutex_lock(&fMutex);
+  fPending.push_back(path);
+  fNumQueued++;
+  pthread_cond_broadcast(&fCondition);
+  pthread_mutex_unlock(&fMutex);
+}
+
+void
+FilePrefetcher::Start()
+{
+  if (fStarted) return;
+  if (pthread_create(&fThread, NULL, FilePrefetcher::Process, this)!=0) {
+    throw Exception(__PRETTY_FUNCTION__, "Failed to launch the prefetching thread!", JustWarning, 40100);
+  }
+  fStarted = true;
+}
+
+bool
+FilePrefetcher::Next(PrefetchedFile* file)
+{
+  if (!fStarted) Start();
+  pthread_mutex_lock(&fMutex);
+  while (fReady.empty() and fNumDelivered<fNumQueued) pthread_cond_wait(&fCondition, &fMutex);
+  if (fReady.empty()) { pthread_mutex_unlock(&fMutex); return false; }
+  *file = fReady.front();
+  fReady.pop_front();
+  fNumDelivered++;
+  pthread_mutex_unlock(&fMutex);
+  return true;
+}
+
+void
+FilePrefetcher::Release(PrefetchedFile* file)
+{
+  if (!file->data) return;
+  pthread_mutex_lock(&fMutex);
+  fBytesInFlight -= file->capacity;
+  fBytesPooled += file->capacity;
+  fPool.push_back(*file);
+  pthread_cond_broadcast(&fCondition);
+  pthread_mutex_unlock(&fMutex);
+  *file = PrefetchedFile();
+}
+
+void*
+FilePrefetcher::Process(void* arg)
+{
+  FilePrefetcher* pf = static_cast<FilePrefetcher*>(arg);
+  while (true) {
+    std::string path;
+    PrefetchedFile file;
+    struct stat st;
+
+    pthread_mutex_lock(&pf->fMutex);
+    while (!pf->fStop and pf->fPending.empty()) pthread_cond_wait(&pf->fCondition, &pf->fMutex);
+    if (pf->fStop) { pthread_mutex_unlock(&pf->fMutex); break; }
+    path = pf->fPending.front();
+    pf->fPending.pop_front();
+    const size_t size = (stat(path.c_str(), &st)==0) ? st.st_size : 0;
+    // wait for the decoder to release enough memory (but always keep one file ahead)
+    while (!pf->fStop and pf->fBytesInFlight>0 and pf->fBytesInFlight+size>pf->fMaxBytes) {
+      pthread_cond_wait(&pf->fCondition, &pf->fMutex);
+    }
+    if (pf->fStop) { pthread_mutex_unlock(&pf->fMutex); break; }
+    // recycle the smallest buffer of the pool large enough for this file
+    std::vector<PrefetchedFile>::iterator best = pf->fPool.end();
+    for (std::vector<PrefetchedFile>::iterator b=pf->fPool.begin(); b!=pf->fPool.end(); b++) {
+      if (b->capacity>=size and (best==pf->fPool.end() or b->capacity<best->capacity)) best = b;
+    }
+    if (best!=pf->fPool.end()) {
+      file = *best;
+      pf->fPool.erase(best);
+      pf->fBytesPooled -= file.capacity;
+    }
+    else {
+      // a new buffer is needed: the smallest ones of the pool are freed to keep within the budget
+      const size_t capacity = GetCapacity(size);
+      while (!pf->fPool.empty() and pf->fBytesInFlight+pf->fBytesPooled+capacity>pf->fMaxBytes) {
+        std::vector<PrefetchedFile>::iterator smallest = pf->fPool.begin();
+        for (std::vector<PrefetchedFile>::iterator b=pf->fPool.begin(); b!=pf->fPool.end(); b++) {
+          if (b->capacity<smallest->capacity) smallest = b;
+        }
+        free(smallest->data);
+        pf->fBytesPooled -= smallest->capacity;
+        pf->fPool.erase(smallest);
+      }
+    }
+    pthread_mutex_unlock(&pf->fMutex);
+
+    file.path = path;
+    file.size = size;
+    pf->ReadFile(&file);
+
+    pthread_mutex_lock(&pf->fMutex);
+    pf->fBytesInFlight += file.capacity;
+    pf->fReady.push_back(file);
+    pthread_cond_broadcast(&pf->fCondition);
+    pthread_mutex_unlock(&pf->fMutex);
+  }
+  return 0;
+}
+
+void
+FilePrefetcher::ReadFile(PrefetchedFile* file)
+{
+  file->error = 0;
+  if (file->capacity<file->size) {
+    free(file->data);
+    file->data = 0; file->capacity = 0;
+    void* ptr = 0;
+    const size_t capacity = GetCapacity(file->size);
+    if (posix_memalign(&ptr, PREFETCH_ALIGNMENT, capacity)!=0) { file->error = ENOMEM; return; }
+    file->data = static_cast<char*>(ptr);
+    file->capacity = capacity;
+  }
+  int fd = open(file->path.c_str(), O_RDONLY);
+  if (fd<0) { file->error = errno; file->size = 0; return; }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  size_t offset = 0;
+  while (offset<file->size) {
+    ssize_t num_bytes = read(fd, file->data+offset, file->size-offset);
+    if (num_bytes<0) { if (errno==EINTR) continue; file->error = errno; break; }
+    if (num_bytes==0) break;
+    offset += num_bytes;
+  }
+  file->size = offset;
+  close(fd);
+}
@@ -1,18 +1,68 @@
 #include "FileReader.h"
 
-FileReader::FileReader(std::string file)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/select.h>
+#include <algorithm>
+
+FileReader::FileReader() :
+  fPrefetcher(0), fStream(0), fNumEvents(0), fFollow(false), fWriterDone(true),
+  fFollowWait(FOLLOW_WAIT_MS), fFollowIdle(FOLLOW_IDLE_S),
+  fScanFd(-1), fNotifyFd(-1), fWatchFd(-1), fScannedSize(0), fCompleteSize(0), fLastGrowth(0),
+  fSampling(1), fNumSeen(0), fNumSampled(0), fNumWords(0), fKeepTrigger(true)
+{}
+
+FileReader::FileReader(std::string file) :
+  fPrefetcher(0), fStream(0), fNumEvents(0), fFollow(false), fWriterDone(true),
+  fFollowWait(FOLLOW_WAIT_MS), fFollowIdle(FOLLOW_IDLE_S),
+  fScanFd(-1), fNotifyFd(-1), fWatchFd(-1), fScannedSize(0), fCompleteSize(0), fLastGrowth(0),
+  fSampling(1), fNumSeen(0), fNumSampled(0), fNumWords(0), fKeepTrigger(true)
 {
   Open(file);
 }
 
 FileReader::~FileReader()
+{
+  Close();
+}
+
+void
+FileReader::Close()
 {
   if (fFile.is_open()) fFile.close();
+  fFile.clear();
+  if (fPrefetcher) fPrefetcher->Release(&fImage);
+  fPrefetcher = 0;
+  fStream.rdbuf(0);
+  if (fScanFd>=0) { close(fScanFd); fScanFd = -1; }
+  if (fNotifyFd>=0) { close(fNotifyFd); fNotifyFd = fWatchFd = -1; }
+}
+
+void
+FileReader::SetFollowMode(bool follow, unsigned int wait_ms, unsigned int idle_s)
+{
+  if (IsOpen())
+    throw Exception(__PRETTY_FUNCTION__, "Follow mode is to be set before opening the file!", JustWarning, 40010);
+  fFollow = follow;
+  fFollowWait = wait_ms;
+  fFollowIdle = idle_s;
 }
 
 void
 FileReader::Open(std::string file)
 {
+  Close();
+  fFilename = file;
+  if (fFollow) {
+    // the acquisition may not have flushed the header yet
+    struct stat st;
+    const time_t start = time(0);
+    while (stat(file.c_str(), &st)!=0 or st.st_size<(off_t)sizeof(file_header_t)) {
+      if (difftime(time(0), start)>fFollowIdle) break;
+      usleep(10000);
+    }
+  }
   fFile.open(file.c_str(), std::ios::in|std::ios::binary);
   
   if (!fFile.is_open()) {
@@ -31,18 +81,127 @@ FileReader::Open(std::string file)
     throw Exception(__PRETTY_FUNCTION__, s.str(), JustWarning, 40001);
   }
   
-  if (!fFile.good()) {
-    fFile.close();
+  fStream.rdbuf(fFile.rdbuf());
+  fStream.clear();
+  ReadHeader(file, st.st_size);
+  fWriteTime = st.st_mtime;
+
+  if (!fFollow) return;
+
+  fWriterDone = false;
+  fLastGrowth = time(0);
+  fScannedSize = fCompleteSize = sizeof(file_header_t);
+  fNumEvents = 0;
+  if ((fScanFd=open(file.c_str(), O_RDONLY))<0) {
+    Close();
+    throw Exception(__PRETTY_FUNCTION__, "Failed to open the file for boundaries scanning!", JustWarning, 40011);
+  }
+  // inotify tells us when words are appended and when the writer closes the
+  // file ; fall back on size polling if it is not available
+  if ((fNotifyFd=inotify_init())>=0) {
+    fWatchFd = inotify_add_watch(fNotifyFd, file.c_str(), IN_MODIFY|IN_CLOSE_WRITE);
+    if (fWatchFd<0) { close(fNotifyFd); fNotifyFd = -1; }
+  }
+  Sync();
+}
+
+bool
+FileReader::Open(FilePrefetcher& prefetcher)
+{
+  if (fFollow)
+    throw Exception(__PRETTY_FUNCTION__, "Prefetched files cannot be followed!", JustWarning, 40012);
+  Close();
+  if (!prefetcher.Next(&fImage)) return false;
+  fPrefetcher = &prefetcher;
+  fFilename = fImage.path;
+  if (fImage.error!=0) {
+    std::stringstream s;
+    s << "Error while trying to open the file \""
+      << fFilename << "\" for reading! (errno=" << fImage.error << ")";
+    Close();
+    throw Exception(__PRETTY_FUNCTION__, s.str(), JustWarning, 40000);
+  }
+  fMemory.Set(fImage.data, fImage.size);
+  fStream.rdbuf(&fMemory);
+  fStream.clear();
+  ReadHeader(fFilename, fImage.size);
+  fWriteTime = time(0);
+  return true;
+}
+
+void
+FileReader::ReadHeader(const std::string& name, off_t size)
+{
+  if (size<(off_t)sizeof(file_header_t) or !fStream.good()) {
+    Close();
     throw Exception(__PRETTY_FUNCTION__, "Can not read file header!", JustWarning, 40002);
   }
-  fFile.read((char*)&fHeader, sizeof(file_header_t));
-  fNumEvents = (st.st_size-sizeof(file_header_t))/sizeof(uint32_t);
+  fStream.read((char*)&fHeader, sizeof(file_header_t));
+  fNumEvents = (size-sizeof(file_header_t))/sizeof(uint32_t);
   if (fHeader.magic!=0x30535050) {
-    fFile.close();
+    Close();
     throw Exception(__PRETTY_FUNCTION__, "Wrong magic number!", JustWarning, 40003);
   }
-  fWriteTime = st.st_mtime;
   fReadoutMode = fHeader.acq_mode;
+  ResetSampling();
+}
+
+bool
+FileReader::Sync()
+{
+  struct stat st;
+  if (fstat(fScanFd, &st)!=0) return false;
+  // only consider fully written words
+  const off_t size = st.st_size-(st.st_size-sizeof(file_header_t))%sizeof(uint32_t);
+  if (size<=fScannedSize) return false;
+  fLastGrowth = time(0);
+
+  const off_t old_complete = fCompleteSize;
+  uint32_t buffer[1024];
+  while (fScannedSize<size) {
+    size_t to_read = std::min((size_t)(size-fScannedSize), sizeof(buffer));
+    ssize_t num_bytes = pread(fScanFd, buffer, to_read, fScannedSize);
+    if (num_bytes<=0) break;
+    const size_t num_words = num_bytes/sizeof(uint32_t);
+    for (size_t i=0; i<num_words; i++) {
+      const off_t end = fScannedSize+(i+1)*sizeof(uint32_t);
+      // an event is only complete once its global trailer is written
+      if (fReadoutMode!=VME::TRIG_MATCH
+       or VME::TDCEvent(buffer[i]).GetType()==VME::TDCEvent::GlobalTrailer) fCompleteSize = end;
+    }
+    fScannedSize += num_words*sizeof(uint32_t);
+  }
+  fNumEvents = (fCompleteSize-sizeof(file_header_t))/sizeof(uint32_t);
+  return (fCompleteSize>old_complete);
+}
+
+bool
+FileReader::WaitForData()
+{
+  if (Sync()) return true;
+  if (fWriterDone) return false;
+
+  if (fNotifyFd>=0) {
+    fd_set fds; FD_ZERO(&fds); FD_SET(fNotifyFd, &fds);
+    struct timeval tv;
+    tv.tv_sec = fFollowWait/1000;
+    tv.tv_usec = (fFollowWait%1000)*1000;
+    if (select(fNotifyFd+1, &fds, NULL, NULL, &tv)>0) {
+      char buf[4096];
+      ssize_t len = read(fNotifyFd, buf, sizeof(buf));
+      for (char* ptr=buf; len>0 and ptr<buf+len; ) {
+        const struct inotify_event* ev = (const struct inotify_event*)ptr;
+        if (ev->mask&IN_CLOSE_WRITE) fWriterDone = true;
+        ptr += sizeof(struct inotify_event)+ev->len;
+      }
+    }
+  }
+  else usleep(fFollowWait*1000);
+
+  if (Sync()) return true;
+  if (difftime(time(0), fLastGrowth)>fFollowIdle) fWriterDone = true;
+  // the writer may have appended its last words before closing the file
+  return (fWriterDone and Sync());
 }
 
 void
@@ -61,8 +220,41 @@ FileReader::Dump() const
 bool
 FileReader::GetNextEvent(VME::TDCEvent* ev)
 {
+  while (ReadWord(ev)) {
+    if (fSampling==1 or IsSampled(*ev)) return true;
+  }
+  return false;
+}
+
+bool
+FileReader::IsSampled(const VME::TDCEvent& ev)
+{
+  if (fReadoutMode==VME::TRIG_MATCH) {
+    // the decision is taken once for all words of the trigger
+    if (ev.GetType()==VME::TDCEvent::GlobalHeader) {
+      fKeepTrigger = (fNumSeen%fSampling==0);
+      fNumSeen++;
+      if (fKeepTrigger) fNumSampled++;
+    }
+    return fKeepTrigger;
+  }
+  if (fNumWords%SAMPLING_SLICE_WORDS==0) {
+    fKeepTrigger = (fNumSeen%fSampling==0);
+    fNumSeen++;
+    if (fKeepTrigger) fNumSampled++;
+  }
+  fNumWords++;
+  return fKeepTrigger;
+}
+
+bool
+FileReader::ReadWord(VME::TDCEvent* ev)
+{
+  if (fFollow and fStream.tellg()>=(std::streampos)fCompleteSize) {
+    if (!WaitForData()) return false;
+  }
   uint32_t buffer;
-  fFile.read((char*)&buffer, sizeof(uint32_t));
+  fStream.read((char*)&buffer, sizeof(uint32_t));
   ev->SetWord(buffer);
 #ifdef DEBUG
   std::cerr << "Event type: " << ev->GetType();
@@ -70,7 +262,7 @@ FileReader::GetNextEvent(VME::TDCEvent* ev)
     std::cerr << "  channel " << std::setw(2) << ev->GetChannelId() << "  trail? " << ev->IsTrailing();
   std::cerr << std::endl;
 #endif
-  if (fFile.eof()) return false;
+  if (fStream.eof()) return false;
   return true;
 }
 
@@ -1,18 +1,32 @@
 #include "Messenger.h"
 
 Messenger::Messenger() :
-  Socket(-1), fNumAttempts(0), fPID(-1)
-{}
+  Socket(-1), fNumAttempts(0), fPID(-1), fEpollFd(-1), fLocalSocketId(-1), fLastRequestId(0), fLastSerial(0), fLastOrder(0),
+  fStopWorkers(false), fLastTicket(0), fNextTicket(1), fCompletionFd(-1)
+{
+  pthread_mutex_init(&fJobsMutex, NULL);
+  pthread_cond_init(&fJobsCondition, NULL);
+  struct timeval now; gettimeofday(&now, NULL);
+  fFirstSequence = static_cast<uint64_t>(now.tv_sec)<<32;
+}
 
 Messenger::Messenger(int port) :
-  Socket(port), fNumAttempts(0), fPID(-1)
+  Socket(port), fNumAttempts(0), fPID(-1), fEpollFd(-1), fLocalSocketId(-1), fLastRequestId(0), fLastSerial(0), fLastOrder(0),
+  fStopWorkers(false), fLastTicket(0), fNextTicket(1), fCompletionFd(-1)
 {
+  pthread_mutex_init(&fJobsMutex, NULL);
+  pthread_cond_init(&fJobsCondition, NULL);
+  struct timeval now; gettimeofday(&now, NULL);
+  fFirstSequence = static_cast<uint64_t>(now.tv_sec)<<32;
   std::cout << __PRETTY_FUNCTION__ << " new Messenger at port " << GetPort() << std::endl;
 }
 
 Messenger::~Messenger()
 {
   Disconnect();
+  StopWorkers();
+  pthread_cond_destroy(&fJobsCondition);
+  pthread_mutex_destroy(&fJobsMutex);
 }
 
 bool
@@ -22,10 +36,41 @@ Messenger::Connect()
     Start();
     Bind();
     Listen(50);
+    SetNonBlocking(GetSocketId());
+    if ((fEpollFd=epoll_create(MESSENGER_MAX_EVENTS))<0) {
+      throw Exception(__PRETTY_FUNCTION__, "Cannot create the events polling instance!", Fatal, SOCKET_ERROR(errno));
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN|EPOLLET;
+    ev.data.fd = GetSocketId();
+    if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, GetSocketId(), &ev)<0) {
+      throw Exception(__PRETTY_FUNCTION__, "Cannot register the messenger socket for polling!", Fatal, SOCKET_ERROR(errno));
+    }
+    StartWorkers();
   } catch (Exception& e) {
     e.Dump();
     return false;
   }
+  // the local socket is optional, the clients falling back to TCP without it
+  const std::string local_path = GetLocalPath();
+  if (!local_path.empty()) {
+    try {
+      fLocalSocketId = ListenLocal(local_path, 50);
+      SetNonBlocking(fLocalSocketId);
+      struct epoll_event ev;
+      ev.events = EPOLLIN|EPOLLET;
+      ev.data.fd = fLocalSocketId;
+      if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fLocalSocketId, &ev)<0) {
+        throw Exception(__PRETTY_FUNCTION__, "Cannot register the local socket for polling!", JustWarning, SOCKET_ERROR(errno));
+      }
+      SetLocalPath(local_path);
+      std::ostringstream os; os << "Local clients accepted on " << local_path;
+      PrintInfo(os.str());
+    } catch (Exception& e) {
+      e.Dump();
+      if (fLocalSocketId>=0) { close(fLocalSocketId); fLocalSocketId = -1; }
+    }
+  }
   return true;
 }
 
@@ -35,29 +80,44 @@ Messenger::Disconnect()
   if (fPort<0) return; // do not broadcast the death of a secondary messenger!
   try {
     Broadcast(SocketMessage(MASTER_DISCONNECT, ""));
+    FlushPendingClients();
   } catch (Exception& e) {
     e.Dump();
     throw Exception(__PRETTY_FUNCTION__, "Failed to broadcast the server disconnection status!", JustWarning, SOCKET_ERROR(errno));
   }
+  StopWorkers();
+  if (fEpollFd>=0) { close(fEpollFd); fEpollFd = -1; }
+  if (fLocalSocketId>=0) {
+    close(fLocalSocketId); fLocalSocketId = -1;
+    unlink(fLocalPath.c_str());
+  }
   Stop();
 }
 
 void
-Messenger::AddClient()
+Messenger::AddClients(int listener)
 {
-  Socket s;
-  try {
-    AcceptConnections(s);
-    Message message = FetchMessage(s.GetSocketId());
-    SocketMessage m(message);
-    if (m.GetKey()==ADD_CLIENT) {
-      SocketType type = static_cast<SocketType>(m.GetIntValue());
-      if (type!=CLIENT) SwitchClientType(s.GetSocketId(), type);
+  // all pending connections are to be accepted, as the listening socket is edge-triggered
+  while (true) {
+    const int sid = accept(listener, NULL, NULL);
+    if (sid<0) {
+      if (errno==EINTR) continue;
+      if (errno==EAGAIN or errno==EWOULDBLOCK) break;
+      throw Exception(__PRETTY_FUNCTION__, "Cannot accept client!", JustWarning, SOCKET_ERROR(errno));
     }
-    // Send the client's unique identifier
-    Send(SocketMessage(SET_CLIENT_ID, s.GetSocketId()), s.GetSocketId());
-  } catch (Exception& e) {
-    e.Dump();
+    std::ostringstream o; o << "New client with # " << sid << ((listener==fLocalSocketId) ? " (local socket)" : "");
+    PrintInfo(o.str());
+    try { SetNonBlocking(sid); } catch (Exception& e) { e.Dump(); close(sid); continue; }
+    struct epoll_event ev;
+    ev.events = EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET;
+    ev.data.fd = sid;
+    if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, sid, &ev)<0) {
+      close(sid);
+      throw Exception(__PRETTY_FUNCTION__, "Cannot register the client for polling!", JustWarning, SOCKET_ERROR(errno));
+    }
+    fSocketsConnected.insert(std::pair<int,SocketType>(sid, CLIENT));
+    fConnections[sid] = Connection();
+    fConnections[sid].serial = ++fLastSerial;
   }
 }
 
@@ -72,12 +132,17 @@ Messenger::DisconnectClient(int sid, MessageKey key, bool force)
   std::ostringstream o; o << "Disconnecting client # " << sid;
   PrintInfo(o.str());
   
+  epoll_ctl(fEpollFd, EPOLL_CTL_DEL, sid, NULL);
   Socket s;
   s.SetSocketId(sid);
   s.Stop();
 
   fSocketsConnected.erase(std::pair<int,SocketType>(sid, type));
-  FD_CLR(sid, &fMaster);
+  fConnections.erase(sid);
+  fBrokenClients.erase(sid);
+  fPendingOutput.erase(sid);
+
+  CancelRequests(sid);
 }
 
 void
@@ -90,54 +155,209 @@ Messenger::SwitchClientType(int sid, SocketType type)
 }
 
 void
-Messenger::Send(const Message& m, int sid) const
+Messenger::Send(const SocketMessageView& m, int sid)
 {
-  try {
-    SendMessage(m, sid);
-  } catch (Exception& e) { e.Dump(); }
+  std::map<int,Connection>::iterator conn = fConnections.find(sid);
+  if (conn==fConnections.end()) {
+    std::ostringstream o; o << "Client # " << sid << " not found in listeners list";
+    Exception(__PRETTY_FUNCTION__, o.str(), JustWarning).Dump();
+    return;
+  }
+  if (fBrokenClients.count(sid)>0) return; // to be closed anyway
+  Connection& c = conn->second;
+
+  // slow consumers first lose the monitoring updates, then their connection
+  if (c.OutputSize()>MESSENGER_OUTPUT_HIGH_WATER and IsDroppable(m)) {
+    if (c.num_dropped==0) {
+      std::ostringstream o; o << "Client # " << sid << " is too slow to follow the updates (" << c.OutputSize() << " bytes pending), dropping them";
+      Exception(__PRETTY_FUNCTION__, o.str(), JustWarning).Dump();
+    }
+    c.num_dropped++;
+    return;
+  }
+  if (c.OutputSize()+m.GetString().size()+FRAME_HEADER_SIZE+FRAME_REQUEST_ID_SIZE+FRAME_SEQUENCE_SIZE>MESSENGER_MAX_OUTPUT) {
+    std::ostringstream o; o << "Client # " << sid << " is not reading its messages (" << c.OutputSize() << " bytes pending), disconnecting it";
+    Exception(__PRETTY_FUNCTION__, o.str(), JustWarning).Dump();
+    fBrokenClients.insert(sid);
+    return;
+  }
+
+  // the message is encoded directly at the end of the pending output
+  if (c.output_offset>0 and c.output_offset>=c.output.size()/2) { c.output.erase(0, c.output_offset); c.output_offset = 0; }
+  // clients without framing receive null-terminated messages
+  if (c.input.GetMode()==MessageFramer::Legacy) {
+    c.output.append(m.GetString().data(), m.GetString().size());
+    c.output += '\0';
+  }
+  else {
+    try { MessageFramer::EncodeTo(&c.output, m.GetString(), m.GetRequestId(), m.GetSequence()); } catch (Exception& e) { e.Dump(); return; }
+  }
+  // all messages queued during this loop iteration are written together
+  fPendingOutput.insert(sid);
+}
+
+bool
+Messenger::IsDroppable(const SocketMessageView& m) const
+{
+  const MessageKey key = m.GetKey();
+  return (key==NUM_TRIGGERS or key==HV_STATUS or key==DQM_QUEUE_STATUS or key==UPDATED_DQM_PLOT);
 }
 
 void
-Messenger::Receive()
+Messenger::FlushClient(int sid)
 {
-  Message msg;
-  SocketMessage m;
-  
-  // We start by copying the master file descriptors list to the
-  // temporary list for readout
-  fReadFds = fMaster;
-  
-  try { SelectConnections(); } catch (Exception& e) {
-    e.Dump();
-    throw Exception(__PRETTY_FUNCTION__, "Impossible to select the connections!", Fatal);
+  std::map<int,Connection>::iterator conn = fConnections.find(sid);
+  if (conn==fConnections.end()) return;
+  Connection& c = conn->second;
+  while (c.OutputSize()>0) {
+    // all pending messages are contiguous, and sent in one call
+    const ssize_t num_bytes = send(sid, c.output.data()+c.output_offset, c.OutputSize(), MSG_NOSIGNAL);
+    if (num_bytes<0) {
+      if (errno==EINTR) continue;
+      if (errno==EAGAIN or errno==EWOULDBLOCK) break; // the rest is sent once writable
+      // the connection is broken ; it is closed outside of any loop on the clients
+      fBrokenClients.insert(sid);
+      c.output.clear(); c.output_offset = 0;
+      return;
+    }
+    c.output_offset += num_bytes;
   }
-  
-  // Looking for something to read!
-  for (SocketCollection::const_iterator s=fSocketsConnected.begin(); s!=fSocketsConnected.end(); s++) {
-    if (!FD_ISSET(s->first, &fReadFds)) continue;
-    
-    // First check if we need to handle new connections
-    if (s->first==GetSocketId()) { AddClient(); return; }
-    
-    // Handle data from a client
-    try { msg = FetchMessage(s->first); } catch (Exception& e) {
-      //std::cout << "exception found..." << e.OneLine() << ", "<< e.ErrorNumber() << std::endl;
-      e.Dump();
-      if (e.ErrorNumber()==11000) { DisconnectClient(s->first, THIS_CLIENT_DELETED); return; }
+  if (c.OutputSize()==0) { c.output.clear(); c.output_offset = 0; } // the capacity is kept
+  if (c.num_dropped>0 and c.OutputSize()<MESSENGER_OUTPUT_HIGH_WATER/2) {
+    std::ostringstream o; o << "Client # " << sid << " caught up after " << c.num_dropped << " updates were dropped";
+    Exception(__PRETTY_FUNCTION__, o.str(), Info).Dump();
+    c.num_dropped = 0;
+  }
+}
+
+void
+Messenger::FlushPendingClients()
+{
+  std::set<int> pending;
+  pending.swap(fPendingOutput);
+  for (std::set<int>::const_iterator sid=pending.begin(); sid!=pending.end(); sid++) FlushClient(*sid);
+}
+
+bool
+Messenger::ReadClient(int sid)
+{
+  while (true) {
+    std::map<int,Connection>::iterator conn = fConnections.find(sid);
+    if (conn==fConnections.end()) return true; // removed while processing its messages
+    const ssize_t num_bytes = recv(sid, fBuffer, MAX_WORD_LENGTH, 0);
+    if (num_bytes>0) {
+      conn->second.input.Append(fBuffer, num_bytes);
+      // messages are processed as they arrive, not to buffer a whole burst
+      if (!ProcessInput(sid, false)) return false;
+      continue;
     }
-    m = SocketMessage(msg.GetString());
+    if (num_bytes<0 and errno==EINTR) continue;
+    if (num_bytes<0 and (errno==EAGAIN or errno==EWOULDBLOCK)) return ProcessInput(sid, true); // everything was read
+    // disconnection or failure
+    ProcessInput(sid, true);
+    return false;
+  }
+}
+
+bool
+Messenger::ProcessInput(int sid, bool drained)
+{
+  // each message is parsed in place in the receive buffer of the client, and
+  // processed before the next one is extracted ; for clients without framing,
+  // any data left unterminated once the socket is drained is treated as one
+  // message
+  StringRef payload;
+  uint32_t request_id;
+  while (true) {
+    std::map<int,Connection>::iterator conn = fConnections.find(sid);
+    if (conn==fConnections.end()) return true; // removed while processing its messages
+    MessageFramer& in = conn->second.input;
+    try {
+      if (!in.Next(&payload, &request_id)) break;
+    } catch (Exception& e) { e.Dump(); return false; }
     // Message was successfully decoded
     fNumAttempts = 0;
-    
-    try { ProcessMessage(m, s->first); } catch (Exception& e) {
-      if (e.ErrorNumber()==11001) break;
+    try { ProcessMessage(SocketMessageView(payload, request_id), sid); } catch (Exception& e) {
+      if (e.ErrorNumber()==11001) return true;
+      e.Dump();
+    }
+  }
+  std::map<int,Connection>::iterator conn = fConnections.find(sid);
+  if (conn==fConnections.end()) return true;
+  std::string unterminated;
+  if (drained and conn->second.input.FlushLegacy(&unterminated)) {
+    try { ProcessMessage(SocketMessageView(StringRef(unterminated)), sid); } catch (Exception& e) {
+      if (e.ErrorNumber()==11001) return true;
+      e.Dump();
     }
+    conn = fConnections.find(sid);
+    if (conn==fConnections.end()) return true;
+  }
+  if (conn->second.input.GetBufferedSize()>MESSENGER_MAX_INPUT+FRAME_MAX_LENGTH) {
+    std::ostringstream o; o << "Client # " << sid << " sent too much unparsed data!";
+    Exception(__PRETTY_FUNCTION__, o.str(), JustWarning).Dump();
+    return false;
   }
+  return true;
 }
 
 void
-Messenger::ProcessMessage(SocketMessage m, int sid)
+Messenger::CloseBrokenClients()
+{
+  while (!fBrokenClients.empty()) {
+    const int sid = *fBrokenClients.begin();
+    fBrokenClients.erase(fBrokenClients.begin());
+    DisconnectClient(sid, THIS_CLIENT_DELETED, true);
+  }
+}
+
+void
+Messenger::Receive()
 {
+  struct epoll_event events[MESSENGER_MAX_EVENTS];
+  // wake up in time to notify the requesters of the missing answers
+  const int num_events = epoll_wait(fEpollFd, events, MESSENGER_MAX_EVENTS, GetRequestsTimeout());
+  if (num_events<0) {
+    if (errno==EINTR) return;
+    throw Exception(__PRETTY_FUNCTION__, "Impossible to poll the connections!", Fatal, SOCKET_ERROR(errno));
+  }
+
+  for (int i=0; i<num_events; i++) {
+    const int sid = events[i].data.fd;
+    // First check if we need to handle new connections
+    if (sid==GetSocketId() or sid==fLocalSocketId) {
+      try { AddClients(sid); } catch (Exception& e) { e.Dump(); }
+      continue;
+    }
+    if (sid==fCompletionFd) {
+      ProcessCompletions();
+      continue;
+    }
+    if (fConnections.find(sid)==fConnections.end()) continue; // already disconnected
+
+    // Handle data from a client
+    if (events[i].events & (EPOLLIN|EPOLLRDHUP|EPOLLHUP|EPOLLERR)) {
+      if (!ReadClient(sid) and fConnections.find(sid)!=fConnections.end()) {
+        CloseBrokenClients();
+        std::ostringstream o; o << "Socket " << sid << " just got disconnected";
+        PrintInfo(o.str());
+        if (fConnections.find(sid)!=fConnections.end()) DisconnectClient(sid, THIS_CLIENT_DELETED);
+        continue;
+      }
+    }
+    if (events[i].events & EPOLLOUT) FlushClient(sid);
+  }
+  ExpireRequests();
+  FlushPendingClients();
+  CloseBrokenClients();
+}
+
+void
+Messenger::ProcessMessage(const SocketMessageView& m, int sid)
+{
+  // answers to the requests forwarded to this client go back to their requester
+  if (RouteAnswer(m, sid)) return;
+
   if (m.GetKey()==REMOVE_CLIENT) {
     if (m.GetIntValue()==GetSocketId()) {
       std::ostringstream o;
@@ -150,12 +370,26 @@ Messenger::ProcessMessage(SocketMessage m, int sid)
     DisconnectClient(m.GetIntValue(), key);
     throw Exception(__PRETTY_FUNCTION__, "Removing socket client", Info, 11001);
   }
+  else if (m.GetKey()==ADD_CLIENT) {
+    SocketType type = static_cast<SocketType>(m.GetIntValue());
+    if (type!=CLIENT) SwitchClientType(sid, type);
+    // Send the client's unique identifier
+    Send(SocketMessage(SET_CLIENT_ID, sid), sid);
+  }
   else if (m.GetKey()==PING_CLIENT) {
+    // the answer is forwarded to the requester once received from the pinged client
     const int toping = m.GetIntValue();
-    Send(SocketMessage(PING_CLIENT), toping);
-    SocketMessage msg; int i=0;
-    do { msg = FetchMessage(toping); i++; } while (msg.GetKey()!=PING_ANSWER && i<MAX_SOCKET_ATTEMPTS);
-    try { Send(SocketMessage(PING_ANSWER, msg.GetValue()), sid); } catch (Exception& e) { e.Dump(); }
+    if (fConnections.find(toping)==fConnections.end()) {
+      Reply(m, SocketMessage(PING_ANSWER, "Client not found"), sid);
+      return;
+    }
+    ForwardRequest(SocketMessage(PING_CLIENT), PING_ANSWER, sid, m.GetRequestId(), toping);
+  }
+  else if (m.GetKey()==SUBSCRIBE or m.GetKey()==UNSUBSCRIBE) {
+    try { Subscribe(m, sid); } catch (Exception& e) { e.Dump(); }
+  }
+  else if (m.GetKey()==RESUME) {
+    try { Resume(m, sid); } catch (Exception& e) { e.Dump(); }
   }
   else if (m.GetKey()==GET_CLIENTS) {
     int i = 0; std::ostringstream os;
@@ -163,7 +397,7 @@ Messenger::ProcessMessage(SocketMessage m, int sid)
       if (i!=0) os << ";";
       os << it->first << " (type " << static_cast<int>(it->second) << ")";
     }
-    try { Send(SocketMessage(CLIENTS_LIST, os.str()), sid); } catch (Exception& e) { e.Dump(); }
+    try { Reply(m, SocketMessage(CLIENTS_LIST, os.str()), sid); } catch (Exception& e) { e.Dump(); }
   }
   else if (m.GetKey()==WEB_GET_CLIENTS) {
     int i = 0; SocketType type; std::ostringstream os;
@@ -175,7 +409,7 @@ Messenger::ProcessMessage(SocketMessage m, int sid)
       else os << "Client" << it->first << ",";
       os << static_cast<int>(type) << "\0";
     }
-    try { Send(SocketMessage(CLIENTS_LIST, os.str()), sid); } catch (Exception& e) { e.Dump(); }
+    try { Reply(m, SocketMessage(CLIENTS_LIST, os.str()), sid); } catch (Exception& e) { e.Dump(); }
   }
   else if (m.GetKey()==START_ACQUISITION) {
     try { StartAcquisition(); } catch (Exception& e) {
@@ -189,27 +423,22 @@ Messenger::ProcessMessage(SocketMessage m, int sid)
       SendAll(DAQ, e);
     }
   }
-  else if (m.GetKey()==NEW_RUN) {
-    try {
-      OnlineDBHandler().NewRun();
-      int last_run = OnlineDBHandler().GetLastRun();
-      SendAll(DQM, SocketMessage(RUN_NUMBER, last_run)); SendAll(DAQ, SocketMessage(RUN_NUMBER, last_run));
-    } catch (Exception& e) {
-      e.Dump();
-    }
-  }
-  else if (m.GetKey()==GET_RUN_NUMBER) {
-    int last_run = 0;
-    try { last_run = OnlineDBHandler().GetLastRun(); } catch (Exception& e) { last_run = -1; }
-    try { Send(SocketMessage(RUN_NUMBER, last_run), sid); } catch (Exception& e) { e.Dump(); }
+  else if (m.GetKey()==NEW_RUN or m.GetKey()==GET_RUN_NUMBER) {
+    // the database is accessed by the workers, the answer being sent once retrieved
+    Submit(m.GetKey(), sid, m.GetRequestId());
   }
   else if (m.GetKey()==SET_NEW_FILENAME) {
     try {
       std::cout << "---> " << m.GetValue() << std::endl;
-      SendAll(DQM, SocketMessage(NEW_FILENAME, m.GetValue().c_str()));
+      SendAll(DQM, SocketMessage(NEW_FILENAME, m.GetValue().str()));
     } catch (Exception& e) { e.Dump(); }
   }
-  else if (m.GetKey()==NUM_TRIGGERS or m.GetKey()==HV_STATUS) {
+  else if (m.GetKey()==SET_LIVE_FILENAME) {
+    try {
+      SendAll(DQM, SocketMessage(LIVE_FILENAME, m.GetValue().str()));
+    } catch (Exception& e) { e.Dump(); }
+  }
+  else if (m.GetKey()==NUM_TRIGGERS or m.GetKey()==HV_STATUS or m.GetKey()==DQM_QUEUE_STATUS) {
     try {
       SendAll(DAQ, m);
     } catch (Exception& e) { e.Dump(); }
@@ -234,7 +463,225 @@ Messenger::ProcessMessage(SocketMessage m, int sid)
 }
 
 void
-Messenger::Broadcast(const Message& m) const
+Messenger::SendAll(const Socket::SocketType& type, const SocketMessageView& m)
+{
+  const MessageKey key = m.GetKey();
+  const StringRef attribute = GetAttribute(m);
+  SocketMessageView msg(m);
+  if (IsReplayable(key)) {
+    std::map<MessageKey,uint64_t>::iterator last = fLastSequences.find(key);
+    if (last==fLastSequences.end()) last = fLastSequences.insert(std::pair<MessageKey,uint64_t>(key, fFirstSequence)).first;
+    Publication pub;
+    pub.sequence = ++last->second;
+    pub.order = ++fLastOrder;
+    pub.key = key;
+    pub.type = type;
+    pub.message = m.GetString().str();
+    ReplayLog& log = fReplayLogs[key];
+    log.push_back(pub);
+    if (log.size()>MESSENGER_REPLAY_SIZE) log.pop_front();
+    msg.SetSequence(pub.sequence);
+  }
+  for (SocketCollection::const_iterator it=fSocketsConnected.begin(); it!=fSocketsConnected.end(); it++) {
+    std::map<int,Connection>::const_iterator conn = fConnections.find(it->first);
+    if (conn==fConnections.end()) continue;
+    if (IsRecipient(conn->second, it->second, type, key, attribute)) Send(msg, it->first);
+  }
+}
+
+bool
+Messenger::IsRecipient(const Connection& c, const SocketType& client_type, const SocketType& type, const MessageKey& key, const StringRef& attribute)
+{
+  Subscriptions::const_iterator sub = c.subscriptions.find(key);
+  // no subscription for this key: delivered according to the client type
+  if (sub==c.subscriptions.end()) return (client_type==type);
+  return sub->second.Accepts(attribute);
+}
+
+bool
+Messenger::IsReplayable(const MessageKey& key) const
+{
+  return (key==NEW_FILENAME or key==LIVE_FILENAME or key==RUN_NUMBER);
+}
+
+void
+Messenger::Resume(const SocketMessageView& m, int sid)
+{
+  std::map<int,Connection>::const_iterator conn = fConnections.find(sid);
+  if (conn==fConnections.end()) return;
+  const SocketType client_type = GetSocketType(sid);
+  std::vector<StringRef> topics;
+  m.GetVectorValue(&topics);
+  unsigned long num_replayed = 0, num_lost = 0;
+  std::vector<const Publication*> missed;
+  for (std::vector<StringRef>::const_iterator t=topics.begin(); t!=topics.end(); t++) {
+    const size_t end = t->find(':');
+    const MessageKey key = (end==StringRef::npos) ? INVALID_KEY : MessageKeyToObject(t->data(), end);
+    if (static_cast<int>(key)<0 or !IsReplayable(key)) {
+      std::ostringstream o; o << "Client # " << sid << " tried to resume an invalid message key: " << *t;
+      throw Exception(__PRETTY_FUNCTION__, o.str(), JustWarning);
+    }
+    uint64_t last = strtoull(t->substr(end+1).str().c_str(), NULL, 10);
+    std::map<MessageKey,ReplayLog>::const_iterator log = fReplayLogs.find(key);
+    if (log==fReplayLogs.end()) continue;
+    // all messages of a previous master were published before the ones of this master
+    if (last<fFirstSequence) last = fFirstSequence;
+    if (log->second.front().sequence>last+1) num_lost += log->second.front().sequence-last-1;
+    for (ReplayLog::const_iterator pub=log->second.begin(); pub!=log->second.end(); pub++) {
+      if (pub->sequence>last) missed.push_back(&(*pub));
+    }
+  }
+  // the keys are merged back in their publication order (e.g. a run number before its files)
+  std::sort(missed.begin(), missed.end(), PublishedBefore);
+  for (std::vector<const Publication*>::const_iterator pub=missed.begin(); pub!=missed.end(); pub++) {
+    SocketMessageView msg((StringRef((*pub)->message)));
+    if (!IsRecipient(conn->second, client_type, (*pub)->type, (*pub)->key, GetAttribute(msg))) continue;
+    msg.SetSequence((*pub)->sequence);
+    Send(msg, sid);
+    num_replayed++;
+  }
+  std::ostringstream os; os << num_replayed << ":" << num_lost;
+  Send(SocketMessage(RESUMED, os.str()), sid);
+  std::ostringstream o; o << "Client # " << sid << " resumed its session (" << num_replayed << " messages replayed, " << num_lost << " lost)";
+  PrintInfo(o.str());
+}
+
+void
+Messenger::Subscribe(const SocketMessageView& m, int sid)
+{
+  std::map<int,Connection>::iterator conn = fConnections.find(sid);
+  if (conn==fConnections.end()) return;
+  const std::string value = m.GetValue().str();
+  const size_t end = value.find(':');
+  const MessageKey key = MessageKeyToObject(value.data(), (end==std::string::npos) ? value.size() : end);
+  if (static_cast<int>(key)<0) {
+    std::ostringstream o; o << "Client # " << sid << " tried to subscribe to an invalid message key: " << value;
+    throw Exception(__PRETTY_FUNCTION__, o.str(), JustWarning);
+  }
+  std::set<std::string> attributes;
+  if (end!=std::string::npos) {
+    size_t start = end+1, next;
+    while ((next=value.find(',', start))!=std::string::npos) {
+      if (next>start) attributes.insert(value.substr(start, next-start));
+      start = next+1;
+    }
+    if (start<value.size()) attributes.insert(value.substr(start));
+  }
+
+  Subscription& sub = conn->second.subscriptions[key];
+  if (m.GetKey()==SUBSCRIBE) {
+    // a new list of attributes replaces the previous one
+    sub.all = (end==std::string::npos);
+    sub.attributes.assign(attributes.begin(), attributes.end());
+  }
+  else {
+    if (end==std::string::npos) { sub.all = false; sub.attributes.clear(); }
+    else if (!sub.all) {
+      for (std::set<std::string>::const_iterator a=attributes.begin(); a!=attributes.end(); a++) {
+        std::vector<std::string>::iterator it = std::lower_bound(sub.attributes.begin(), sub.attributes.end(), *a);
+        if (it!=sub.attributes.end() and *it==*a) sub.attributes.erase(it);
+      }
+    }
+  }
+}
+
+StringRef
+Messenger::GetAttribute(const SocketMessageView& m)
+{
+  return m.GetValue().substr(0, m.GetValue().find(':'));
+}
+
+void
+Messenger::Reply(const SocketMessageView& request, SocketMessage answer, int sid)
+{
+  answer.SetRequestId(request.GetRequestId());
+  Send(answer, sid);
+}
+
+void
+Messenger::ForwardRequest(SocketMessage m, const MessageKey& answer, int requester, uint32_t requester_id, int target)
+{
+  if (++fLastRequestId==0) fLastRequestId++; // 0 is for messages outside of any request
+  Request req;
+  req.requester = requester;
+  req.requester_id = requester_id;
+  req.target = target;
+  req.answer = answer;
+  gettimeofday(&req.deadline, NULL);
+  req.deadline.tv_sec += MESSENGER_REQUEST_TIMEOUT;
+  fRequests[fLastRequestId] = req;
+  m.SetRequestId(fLastRequestId);
+  Send(m, target);
+}
+
+bool
+Messenger::RouteAnswer(const SocketMessageView& m, int sid)
+{
+  if (fRequests.empty()) return false;
+  std::map<uint32_t,Request>::iterator req = fRequests.end();
+  if (m.GetRequestId()!=0) req = fRequests.find(m.GetRequestId());
+  else {
+    // clients without request identifiers answer to their oldest request
+    for (req=fRequests.begin(); req!=fRequests.end(); req++) {
+      if (req->second.target==sid and req->second.answer==m.GetKey()) break;
+    }
+  }
+  if (req==fRequests.end() or req->second.target!=sid or req->second.answer!=m.GetKey()) return false;
+
+  const int requester = req->second.requester;
+  SocketMessageView answer(m);
+  answer.SetRequestId(req->second.requester_id);
+  fRequests.erase(req);
+  if (fConnections.find(requester)!=fConnections.end()) Send(answer, requester);
+  return true;
+}
+
+void
+Messenger::ExpireRequests()
+{
+  if (fRequests.empty()) return;
+  struct timeval now; gettimeofday(&now, NULL);
+  for (std::map<uint32_t,Request>::iterator req=fRequests.begin(); req!=fRequests.end();) {
+    if (timercmp(&now, &req->second.deadline, <)) { req++; continue; }
+    std::ostringstream o; o << "No answer from client # " << req->second.target << " after " << MESSENGER_REQUEST_TIMEOUT << " s";
+    PrintInfo(o.str());
+    SocketMessage answer(req->second.answer, o.str());
+    answer.SetRequestId(req->second.requester_id);
+    if (fConnections.find(req->second.requester)!=fConnections.end()) Send(answer, req->second.requester);
+    fRequests.erase(req++);
+  }
+}
+
+void
+Messenger::CancelRequests(int sid)
+{
+  for (std::map<uint32_t,Request>::iterator req=fRequests.begin(); req!=fRequests.end();) {
+    if (req->second.requester==sid) { fRequests.erase(req++); continue; }
+    if (req->second.target!=sid) { req++; continue; }
+    std::ostringstream o; o << "Client # " << sid << " disconnected before answering";
+    SocketMessage answer(req->second.answer, o.str());
+    answer.SetRequestId(req->second.requester_id);
+    if (fConnections.find(req->second.requester)!=fConnections.end()) Send(answer, req->second.requester);
+    fRequests.erase(req++);
+  }
+}
+
+int
+Messenger::GetRequestsTimeout() const
+{
+  if (fRequests.empty()) return -1;
+  struct timeval now, left; gettimeofday(&now, NULL);
+  const struct timeval* deadline = &fRequests.begin()->second.deadline;
+  for (std::map<uint32_t,Request>::const_iterator req=fRequests.begin(); req!=fRequests.end(); req++) {
+    if (timercmp(&req->second.deadline, deadline, <)) deadline = &req->second.deadline;
+  }
+  if (!timercmp(&now, deadline, <)) return 0;
+  timersub(deadline, &now, &left);
+  return left.tv_sec*1000+left.tv_usec/1000+1;
+}
+
+void
+Messenger::Broadcast(const Message& m)
 {
   try {
     for (SocketCollection::const_iterator sid=fSocketsConnected.begin(); sid!=fSocketsConnected.end(); sid++) {
@@ -249,38 +696,13 @@ Messenger::Broadcast(const Message& m) const
 void
 Messenger::StartAcquisition()
 {
-  fPID = fork();
-  std::ostringstream os; int ret;
-
-  try {
-    switch (fPID) {
-      case -1:
-        throw Exception(__PRETTY_FUNCTION__, "Failed to fork the current process!", JustWarning);
-      case 0:
-        PrintInfo("Launching the daughter acquisition process");
-        ret = execl("ppsFetch", "", (char*)NULL);
-        os.str("");
-        os << "Failed to launch the daughter process!" << "\n\t"
-           << "Return value: " << ret << "\n\t"
-           << "Errno: " << errno;
-        throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning);
-      default:
-        break;
-    }
-    SendAll(DAQ, SocketMessage(ACQUISITION_STARTED));
-    
-    // Send the run number to DQMonitors
-    int last_run = -1;
-    try { last_run = OnlineDBHandler().GetLastRun(); } catch (Exception& e) { last_run = -1; }
-    try { SendAll(DQM, SocketMessage(RUN_NUMBER, last_run)); } catch (Exception& e) { e.Dump(); }
-
-    throw Exception(__PRETTY_FUNCTION__, "Acquisition started!", Info, 30000);
-  } catch (Exception& e) { e.Dump(); }
+  Submit(START_ACQUISITION);
 }
 
 void
 Messenger::StopAcquisition()
 {
+  if (fPID<=0) throw Exception(__PRETTY_FUNCTION__, "No acquisition process to stop!", JustWarning);
   signal(SIGCHLD, SIG_IGN);
   int ret = kill(fPID, SIGINT);
   if (ret<0) {
@@ -289,6 +711,204 @@ Messenger::StopAcquisition()
        << "Return value: " << ret << " (errno=" << errno << ")";
     throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning);
   }
+  fPID = -1;
   SendAll(DAQ, SocketMessage(ACQUISITION_STOPPED));
   throw Exception(__PRETTY_FUNCTION__, "Acquisition stop signal sent!", Info, 30001);
 }
+
+bool
+Messenger::StartWorkers()
+{
+  if (!fWorkers.empty()) return true;
+  if ((fCompletionFd=eventfd(0, EFD_NONBLOCK))<0) {
+    throw Exception(__PRETTY_FUNCTION__, "Cannot create the jobs completion notifier!", Fatal, SOCKET_ERROR(errno));
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = fCompletionFd;
+  if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fCompletionFd, &ev)<0) {
+    throw Exception(__PRETTY_FUNCTION__, "Cannot register the jobs completion notifier for polling!", Fatal, SOCKET_ERROR(errno));
+  }
+  fStopWorkers = false;
+  for (unsigned int i=0; i<MESSENGER_NUM_WORKERS; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, Messenger::ProcessJobs, this)!=0) {
+      throw Exception(__PRETTY_FUNCTION__, "Failed to launch a worker thread!", Fatal);
+    }
+    fWorkers.push_back(thread);
+  }
+  return true;
+}
+
+void
+Messenger::StopWorkers()
+{
+  if (fWorkers.empty()) return;
+  pthread_mutex_lock(&fJobsMutex);
+  fStopWorkers = true;
+  pthread_cond_broadcast(&fJobsCondition);
+  pthread_mutex_unlock(&fJobsMutex);
+  for (std::vector<pthread_t>::iterator w=fWorkers.begin(); w!=fWorkers.end(); w++) pthread_join(*w, NULL);
+  fWorkers.clear();
+  // the jobs not performed yet are abandoned
+  fJobs.clear(); fCompletedJobs.clear();
+  fNextTicket = fLastTicket+1;
+  if (fCompletionFd>=0) { close(fCompletionFd); fCompletionFd = -1; }
+}
+
+void
+Messenger::Submit(const MessageKey& type, int sid, uint32_t request_id)
+{
+  Job job;
+  job.type = type;
+  job.requester = sid;
+  job.request_id = request_id;
+  std::map<int,Connection>::const_iterator conn = fConnections.find(sid);
+  if (conn!=fConnections.end()) job.requester_serial = conn->second.serial;
+  pthread_mutex_lock(&fJobsMutex);
+  job.ticket = ++fLastTicket;
+  fJobs.push_back(job);
+  pthread_cond_signal(&fJobsCondition);
+  pthread_mutex_unlock(&fJobsMutex);
+}
+
+void*
+Messenger::ProcessJobs(void* arg)
+{
+  Messenger* m = static_cast<Messenger*>(arg);
+  while (true) {
+    pthread_mutex_lock(&m->fJobsMutex);
+    while (!m->fStopWorkers and m->fJobs.empty()) pthread_cond_wait(&m->fJobsCondition, &m->fJobsMutex);
+    if (m->fStopWorkers) { pthread_mutex_unlock(&m->fJobsMutex); break; }
+    Job job = m->fJobs.front();
+    m->fJobs.pop_front();
+    pthread_mutex_unlock(&m->fJobsMutex);
+
+    m->RunJob(job);
+
+    pthread_mutex_lock(&m->fJobsMutex);
+    m->fCompletedJobs.push_back(job);
+    pthread_mutex_unlock(&m->fJobsMutex);
+    const uint64_t one = 1;
+    if (write(m->fCompletionFd, &one, sizeof(one))<0) {;} // only fails if the counter is saturated
+  }
+  return 0;
+}
+
+void
+Messenger::RunJob(Job& job)
+{
+  // the acquisition process is launched before waiting for the database
+  const bool launched = (job.type!=START_ACQUISITION or Spawn("ppsFetch", &job.pid, &job.error));
+  // every job takes its turn, not to block the following ones
+  WaitDatabaseTurn(job);
+  if (launched) {
+    try {
+      if (job.type==NEW_RUN) OnlineDBHandler().NewRun();
+      job.run_number = OnlineDBHandler().GetLastRun();
+    } catch (Exception& e) {
+      if (job.type==NEW_RUN) job.error = e.Description();
+      job.run_number = -1;
+    }
+  }
+  EndDatabaseTurn();
+}
+
+void
+Messenger::WaitDatabaseTurn(const Job& job)
+{
+  pthread_mutex_lock(&fJobsMutex);
+  while (fNextTicket!=job.ticket) pthread_cond_wait(&fJobsCondition, &fJobsMutex);
+  pthread_mutex_unlock(&fJobsMutex);
+}
+
+void
+Messenger::EndDatabaseTurn()
+{
+  pthread_mutex_lock(&fJobsMutex);
+  fNextTicket++;
+  pthread_cond_broadcast(&fJobsCondition);
+  pthread_mutex_unlock(&fJobsMutex);
+}
+
+bool
+Messenger::Spawn(const char* path, pid_t* pid, std::string* error)
+{
+  // the child reports through this pipe if it could not execute the program
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC)<0) {
+    std::ostringstream os; os << "Failed to create the daughter process pipe (errno=" << errno << ")";
+    *error = os.str();
+    return false;
+  }
+  *pid = fork();
+  if (*pid==0) {
+    // only async-signal-safe calls in the child of a multi-threaded process
+    close(fds[0]);
+    execl(path, "", (char*)NULL);
+    const int err = errno;
+    if (write(fds[1], &err, sizeof(err))<0) {;}
+    _exit(127);
+  }
+  const int fork_errno = errno;
+  close(fds[1]);
+  if (*pid<0) {
+    close(fds[0]);
+    std::ostringstream os; os << "Failed to fork the current process! (errno=" << fork_errno << ")";
+    *error = os.str();
+    return false;
+  }
+  int err = 0;
+  ssize_t num_bytes;
+  while ((num_bytes=read(fds[0], &err, sizeof(err)))<0 and errno==EINTR) {;}
+  close(fds[0]);
+  if (num_bytes==sizeof(err)) {
+    waitpid(*pid, NULL, 0);
+    std::ostringstream os; os << "Failed to launch the daughter process " << path << "! (errno=" << err << ")";
+    *error = os.str();
+    *pid = -1;
+    return false;
+  }
+  return true; // the pipe was closed by a successful exec
+}
+
+void
+Messenger::ProcessCompletions()
+{
+  uint64_t count;
+  if (read(fCompletionFd, &count, sizeof(count))<0) {;} // resets the notification
+  std::deque<Job> completed;
+  pthread_mutex_lock(&fJobsMutex);
+  completed.swap(fCompletedJobs);
+  pthread_mutex_unlock(&fJobsMutex);
+
+  for (std::deque<Job>::const_iterator job=completed.begin(); job!=completed.end(); job++) {
+    try {
+      if (job->type==NEW_RUN) {
+        if (!job->error.empty()) throw Exception(__PRETTY_FUNCTION__, job->error, JustWarning);
+        SendAll(DQM, SocketMessage(RUN_NUMBER, job->run_number)); SendAll(DAQ, SocketMessage(RUN_NUMBER, job->run_number));
+      }
+      else if (job->type==GET_RUN_NUMBER) {
+        // the requester may have disconnected meanwhile, and its descriptor been reused
+        std::map<int,Connection>::const_iterator conn = fConnections.find(job->requester);
+        if (conn==fConnections.end() or conn->second.serial!=job->requester_serial) continue;
+        SocketMessage answer(RUN_NUMBER, job->run_number);
+        answer.SetRequestId(job->request_id);
+        Send(answer, job->requester);
+      }
+      else if (job->type==START_ACQUISITION) {
+        if (!job->error.empty()) {
+          Exception e(__PRETTY_FUNCTION__, job->error, JustWarning);
+          e.Dump();
+          SendAll(DAQ, e);
+          continue;
+        }
+        fPID = job->pid;
+        SendAll(DAQ, SocketMessage(ACQUISITION_STARTED));
+        // Send the run number to DQMonitors
+        SendAll(DQM, SocketMessage(RUN_NUMBER, job->run_number));
+        throw Exception(__PRETTY_FUNCTION__, "Acquisition started!", Info, 30000);
+      }
+    } catch (Exception& e) { e.Dump(); }
+  }
+}
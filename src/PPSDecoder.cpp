@@ -0,0 +1,120 @@
+#include "PPSDecoder.h"
+#include "FileReader.h"
+
+#include <cstring>
+#include <cstdio>
+
+/**
+ * \brief Decoding state of one file, kept between two buffer fills
+ */
+struct pps_decoder {
+  pps_decoder() : trigger(0), event_count(0), trigger_matching(true) {
+    memset(&stats, 0, sizeof(pps_stats));
+    for (unsigned int i=0; i<PPS_DECODER_NUM_CHANNELS; i++) { leading[i] = 0; has_leading[i] = false; }
+  }
+  FileReader reader;
+  pps_stats stats;
+  uint32_t trigger, event_count;
+  bool trigger_matching;
+  uint32_t leading[PPS_DECODER_NUM_CHANNELS];
+  bool has_leading[PPS_DECODER_NUM_CHANNELS];
+};
+
+int
+pps_decoder_api_version(void)
+{
+  return PPS_DECODER_API_VERSION;
+}
+
+pps_decoder*
+pps_decoder_open(const char* filename, char* error, size_t error_size)
+{
+  pps_decoder* dec = new pps_decoder;
+  try {
+    dec->reader.Open(filename);
+  } catch (Exception& e) {
+    if (error and error_size>0) snprintf(error, error_size, "%s", e.Description().c_str());
+    delete dec;
+    return NULL;
+  }
+  dec->trigger_matching = (dec->reader.GetAcquisitionMode()==VME::TRIG_MATCH);
+  return dec;
+}
+
+void
+pps_decoder_close(pps_decoder* dec)
+{
+  delete dec;
+}
+
+int
+pps_decoder_get_info(const pps_decoder* dec, pps_file_info* info)
+{
+  if (!dec or !info) return -1;
+  const file_header_t& header = dec->reader.GetHeader();
+  info->run_id = header.run_id;
+  info->spill_id = header.spill_id;
+  info->num_hptdc = header.num_hptdc;
+  info->acq_mode = header.acq_mode;
+  info->det_mode = header.det_mode;
+  return 0;
+}
+
+long
+pps_decoder_read_hits(pps_decoder* dec, pps_hits* hits, size_t capacity)
+{
+  if (!dec or !hits) return -1;
+  size_t num_hits = 0;
+  VME::TDCEvent ev;
+  try {
+    // stops before decoding a word which could overflow the caller buffers
+    while (num_hits<capacity and dec->reader.GetNextEvent(&ev)) {
+      dec->stats.num_words++;
+      switch (ev.GetType()) {
+        case VME::TDCEvent::GlobalHeader:
+          if (dec->trigger_matching) dec->trigger++;
+          dec->event_count = ev.GetEventCount();
+          for (unsigned int i=0; i<PPS_DECODER_NUM_CHANNELS; i++) dec->has_leading[i] = false;
+          break;
+        case VME::TDCEvent::Trigger:
+          if (!dec->trigger_matching) dec->trigger++;
+          break;
+        case VME::TDCEvent::ETTT:
+          dec->stats.num_triggers++;
+          break;
+        case VME::TDCEvent::TDCMeasurement: {
+          const unsigned int ch = ev.GetChannelId();
+          if (ch>=PPS_DECODER_NUM_CHANNELS) break;
+          if (!ev.IsTrailing()) { dec->leading[ch] = ev.GetTime(); dec->has_leading[ch] = true; break; }
+          dec->stats.trailing_edges[ch]++;
+          if (!dec->has_leading[ch]) break;
+          hits->trigger[num_hits] = dec->trigger;
+          hits->event_count[num_hits] = dec->event_count;
+          hits->channel_id[num_hits] = ch;
+          hits->leading_time[num_hits] = dec->leading[ch];
+          hits->tot[num_hits] = (ev.GetTime()-dec->leading[ch])&0x7FFFF; // handles the counter rollover
+          dec->has_leading[ch] = false;
+          dec->stats.num_hits++;
+          num_hits++;
+        } break;
+        case VME::TDCEvent::TDCError: {
+          const uint16_t flags = ev.GetErrorFlags().GetWord();
+          dec->stats.num_errors++;
+          for (unsigned int i=0; i<PPS_DECODER_NUM_ERROR_FLAGS; i++) {
+            if ((flags>>i)&0x1) dec->stats.error_flags[i]++;
+          }
+        } break;
+        default: break;
+      }
+    }
+  } catch (Exception& e) { return -1; }
+  return num_hits;
+}
+
+int
+pps_decoder_get_stats(const pps_decoder* dec, pps_stats* stats)
+{
+  if (!dec or !stats) return -1;
+  *stats = dec->stats;
+  return 0;
+}
@@ -0,0 +1,232 @@
+#include "SharedMemoryTap.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sstream>
+#include <algorithm>
+
+SharedMemoryTap::SharedMemoryTap(OverrunPolicy policy) :
+  fPolicy(policy), fWriter(false), fFd(-1), fBase(0), fSize(0), fHeader(0), fStaleHeader(false)
+{}
+
+SharedMemoryTap::~SharedMemoryTap()
+{
+  Unmap();
+  // withdraw the segment so that the consumers know no more data will come
+  if (fWriter) shm_unlink(fName.c_str());
+}
+
+void
+SharedMemoryTap::Create(unsigned int num_streams, uint64_t capacity, const char* name)
+{
+  Unmap();
+  fName = name;
+  // any segment left over by a previous acquisition is made stale for its consumers
+  shm_unlink(fName.c_str());
+  fFd = shm_open(fName.c_str(), O_CREAT|O_EXCL|O_RDWR, 0644);
+  if (fFd<0) {
+    std::ostringstream os; os << "Failed to create the shared memory segment " << fName << ": " << strerror(errno);
+    throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 44000);
+  }
+  fWriter = true;
+  fSize = sizeof(tap_header_t)+num_streams*(sizeof(tap_stream_t)+capacity*sizeof(uint32_t));
+  if (ftruncate(fFd, fSize)!=0) {
+    std::ostringstream os; os << "Failed to allocate " << fSize << " bytes of shared memory: " << strerror(errno);
+    Unmap();
+    throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 44001);
+  }
+  Map(PROT_READ|PROT_WRITE);
+  memset(fBase, 0, fSize);
+  fHeader->num_streams = num_streams;
+  fHeader->capacity = capacity;
+  // the segment is only declared valid once fully initialised
+  __atomic_store_n(&fHeader->magic, TAP_MAGIC, __ATOMIC_RELEASE);
+}
+
+void
+SharedMemoryTap::SetStream(unsigned int stream, uint32_t board_address, const file_header_t& header)
+{
+  if (!fWriter or !fHeader or stream>=fHeader->num_streams) return;
+  tap_stream_t* s = Stream(stream);
+  s->board_address = board_address;
+  __atomic_store_n(&s->header_seq, s->header_seq+1, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  s->header = header;
+  __atomic_store_n(&s->header_seq, s->header_seq+1, __ATOMIC_RELEASE);
+}
+
+void
+SharedMemoryTap::Write(unsigned int stream, const VME::TDCEventCollection& events)
+{
+  if (!fWriter or !fHeader or stream>=fHeader->num_streams or events.size()==0) return;
+  tap_stream_t* s = Stream(stream);
+  uint32_t* ring = Ring(stream);
+  const uint64_t capacity = fHeader->capacity;
+  uint64_t index = s->write_index;
+  __atomic_store_n(&s->reserve_index, index+events.size(), __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (VME::TDCEventCollection::const_iterator e=events.begin(); e!=events.end(); e++, index++) {
+    ring[index%capacity] = e->GetWord();
+  }
+  // publish all words at once
+  __atomic_store_n(&s->write_index, index, __ATOMIC_RELEASE);
+}
+
+void
+SharedMemoryTap::Write(unsigned int stream, uint32_t word)
+{
+  if (!fWriter or !fHeader or stream>=fHeader->num_streams) return;
+  tap_stream_t* s = Stream(stream);
+  __atomic_store_n(&s->reserve_index, s->write_index+1, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  Ring(stream)[s->write_index%fHeader->capacity] = word;
+  __atomic_store_n(&s->write_index, s->write_index+1, __ATOMIC_RELEASE);
+}
+
+bool
+SharedMemoryTap::Attach(const char* name)
+{
+  Unmap();
+  fName = name;
+  fWriter = false;
+  fFd = shm_open(fName.c_str(), O_RDONLY, 0);
+  if (fFd<0) return false; // no acquisition running
+  struct stat st;
+  if (fstat(fFd, &st)!=0 or (size_t)st.st_size<sizeof(tap_header_t)) { Unmap(); return false; }
+  fSize = st.st_size;
+  Map(PROT_READ);
+  if (__atomic_load_n(&fHeader->magic, __ATOMIC_ACQUIRE)!=TAP_MAGIC) { Unmap(); return false; } // still being initialised
+  if (sizeof(tap_header_t)+fHeader->num_streams*StreamSize()>fSize) {
+    Unmap();
+    throw Exception(__PRETTY_FUNCTION__, "Shared memory segment is smaller than its declared content!", JustWarning, 44002);
+  }
+  // start reading from the current position of the writer, which may be in the middle of an event
+  fCursor.clear(); fLost.clear(); fResync.clear();
+  for (unsigned int i=0; i<fHeader->num_streams; i++) {
+    fCursor.push_back(__atomic_load_n(&Stream(i)->write_index, __ATOMIC_ACQUIRE));
+    fLost.push_back(0);
+    fResync.push_back(true);
+  }
+  return true;
+}
+
+bool
+SharedMemoryTap::IsStale() const
+{
+  if (fFd<0 or fStaleHeader) return true;
+  struct stat st;
+  if (fstat(fFd, &st)!=0) return true;
+  return (st.st_nlink==0);
+}
+
+uint32_t
+SharedMemoryTap::GetBoardAddress(unsigned int stream) const
+{
+  if (!fHeader or stream>=fHeader->num_streams) return 0;
+  return Stream(stream)->board_address;
+}
+
+file_header_t
+SharedMemoryTap::GetFileHeader(unsigned int stream) const
+{
+  file_header_t header;
+  memset(&header, 0, sizeof(file_header_t));
+  if (!fHeader or stream>=fHeader->num_streams) return header;
+  const tap_stream_t* s = Stream(stream);
+  uint32_t seq;
+  for (unsigned int i=0; i<TAP_HEADER_MAX_ATTEMPTS; i++) {
+    seq = __atomic_load_n(&s->header_seq, __ATOMIC_ACQUIRE);
+    if (seq%2==0) {
+      header = s->header;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&s->header_seq, __ATOMIC_ACQUIRE)==seq) return header;
+    }
+    sched_yield();
+  }
+  // the writer died while updating the header
+  fStaleHeader = true;
+  memset(&header, 0, sizeof(file_header_t));
+  return header;
+}
+
+size_t
+SharedMemoryTap::Fetch(unsigned int stream, VME::TDCEventCollection* events)
+{
+  if (!fHeader or stream>=fHeader->num_streams) return 0;
+  const tap_stream_t* s = Stream(stream);
+  const uint32_t* ring = Ring(stream);
+  const uint64_t capacity = fHeader->capacity;
+  uint64_t& cursor = fCursor[stream];
+  bool resync = fResync[stream];
+
+  uint64_t index = __atomic_load_n(&s->write_index, __ATOMIC_ACQUIRE);
+  if (index<cursor) cursor = index;
+  if (index-cursor>capacity) { // the writer already overwrote some unread words
+    const uint64_t restart = (fPolicy==SkipToOldest) ? index-capacity : index;
+    fLost[stream] += restart-cursor;
+    cursor = restart;
+    resync = true;
+  }
+  if (index==cursor) return 0;
+
+  const size_t num_words = index-cursor, first = cursor%capacity;
+  const size_t num_first = std::min<size_t>(num_words, capacity-first);
+  fBuffer.resize(num_words);
+  memcpy(&fBuffer[0], ring+first, num_first*sizeof(uint32_t));
+  if (num_words>num_first) memcpy(&fBuffer[num_first], ring, (num_words-num_first)*sizeof(uint32_t));
+
+  // words overwritten by the writer while being copied are discarded
+  size_t begin = 0, end = num_words;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  const uint64_t new_index = __atomic_load_n(&s->reserve_index, __ATOMIC_ACQUIRE);
+  if (new_index-cursor>capacity) {
+    begin = std::min<uint64_t>(new_index-capacity-cursor, num_words);
+    resync = true;
+  }
+
+  // only deliver complete events
+  const bool trigger_matching = (GetFileHeader(stream).acq_mode==VME::TRIG_MATCH);
+  if (fStaleHeader) return 0;
+  if (trigger_matching) {
+    if (resync) {
+      while (begin<end and VME::TDCEvent(fBuffer[begin]).GetType()!=VME::TDCEvent::GlobalHeader) begin++;
+    }
+    while (end>begin and VME::TDCEvent(fBuffer[end-1]).GetType()!=VME::TDCEvent::GlobalTrailer) end--;
+    if (end==begin) {
+      if (resync) { fLost[stream] += begin; cursor += begin; fResync[stream] = true; } // no event boundary found yet
+      return 0;
+    }
+  }
+  fResync[stream] = false;
+  fLost[stream] += begin;
+  for (size_t i=begin; i<end; i++) events->push_back(VME::TDCEvent(fBuffer[i]));
+  cursor += end;
+  return end-begin;
+}
+
+void
+SharedMemoryTap::Map(int prot)
+{
+  void* ptr = mmap(0, fSize, prot, MAP_SHARED, fFd, 0);
+  if (ptr==MAP_FAILED) {
+    std::ostringstream os; os << "Failed to map the shared memory segment " << fName << ": " << strerror(errno);
+    Unmap();
+    throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, 44003);
+  }
+  fBase = static_cast<char*>(ptr);
+  fHeader = reinterpret_cast<tap_header_t*>(fBase);
+}
+
+void
+SharedMemoryTap::Unmap()
+{
+  if (fBase) munmap(fBase, fSize);
+  if (fFd>=0) close(fFd);
+  fBase = 0; fHeader = 0; fFd = -1; fSize = 0;
+  fStaleHeader = false;
+}
@@ -39,7 +39,7 @@ Socket::Stop()
 void
 Socket::Create()
 {
-  fSocketId = socket(AF_INET, SOCK_STREAM, 0);
+  fSocketId = socket(IsLocal() ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
   if (fSocketId==-1) {
     throw Exception(__PRETTY_FUNCTION__, "Cannot create socket!", Fatal, SOCKET_ERROR(errno));
   }
@@ -75,8 +75,26 @@ Socket::Bind()
 }
 
 void
-Socket::PrepareConnection()
+Socket::PrepareConnection(const ExceptionType& type)
 {
+  if (IsLocal()) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (fLocalPath.size()>=sizeof(address.sun_path)) {
+      Stop();
+      throw Exception(__PRETTY_FUNCTION__, "Local socket path is too long!", JustWarning);
+    }
+    strncpy(address.sun_path, fLocalPath.c_str(), sizeof(address.sun_path)-1);
+    if (connect(fSocketId, (struct sockaddr*)&address, sizeof(address))!=0) {
+      // not fatal, as the client may still reach the master through TCP
+      Stop();
+      std::ostringstream os; os << "Cannot connect to local socket " << fLocalPath << "!";
+      throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, SOCKET_ERROR(errno));
+    }
+    return;
+  }
+
   fAddress.sin_family = AF_INET;
   fAddress.sin_port = htons(fPort);
 
@@ -87,9 +105,9 @@ Socket::PrepareConnection()
       os << "Messenger is not reachable through sockets!" << std::endl
          << "\tCheck that it is properly launched on the central" << std::endl
          << "\tmachine!";
-      throw Exception(__PRETTY_FUNCTION__, os.str(), Fatal, SOCKET_ERROR(errno));
+      throw Exception(__PRETTY_FUNCTION__, os.str(), type, SOCKET_ERROR(errno));
     }
-    throw Exception(__PRETTY_FUNCTION__, "Cannot connect to socket!", Fatal, SOCKET_ERROR(errno));
+    throw Exception(__PRETTY_FUNCTION__, "Cannot connect to socket!", type, SOCKET_ERROR(errno));
   }
 }
 
@@ -133,14 +151,57 @@ Socket::Listen(int maxconn)
   fSocketsConnected.insert(std::pair<int,SocketType>(fSocketId, MASTER));
 }
 
+int
+Socket::ListenLocal(const std::string& path, int maxconn) const
+{
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size()>=sizeof(address.sun_path)) {
+    throw Exception(__PRETTY_FUNCTION__, "Local socket path is too long!", JustWarning);
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path)-1);
+
+  const int sid = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sid<0) {
+    throw Exception(__PRETTY_FUNCTION__, "Cannot create local socket!", JustWarning, SOCKET_ERROR(errno));
+  }
+  unlink(path.c_str());
+  if (bind(sid, (struct sockaddr*)&address, sizeof(address))!=0 or listen(sid, maxconn)!=0) {
+    close(sid);
+    std::ostringstream os; os << "Cannot listen on local socket " << path << "!";
+    throw Exception(__PRETTY_FUNCTION__, os.str(), JustWarning, SOCKET_ERROR(errno));
+  }
+  return sid;
+}
+
+void
+Socket::SetNonBlocking(int sid) const
+{
+  const int flags = fcntl(sid, F_GETFL, 0);
+  if (flags<0 or fcntl(sid, F_SETFL, flags|O_NONBLOCK)<0) {
+    throw Exception(__PRETTY_FUNCTION__, "Cannot switch the socket to non-blocking mode!", JustWarning, SOCKET_ERROR(errno));
+  }
+}
+
 void
 Socket::SendMessage(Message message, int id) const
+{
+  SendFrames(MessageFramer::Encode(message.GetString(), message.GetRequestId(), message.GetSequence()), id);
+}
+
+void
+Socket::SendFrames(const std::string& frames, int id) const
 {
   if (id<0) id = fSocketId;
-  std::string message_s = message.GetString();
-  usleep(1000);
-  if (send(id, message_s.c_str(), message_s.size(), MSG_NOSIGNAL)<=0) {
-    throw Exception(__PRETTY_FUNCTION__, "Cannot send message!", JustWarning, SOCKET_ERROR(errno));
+  size_t sent = 0;
+  while (sent<frames.size()) {
+    const ssize_t num_bytes = send(id, frames.data()+sent, frames.size()-sent, MSG_NOSIGNAL);
+    if (num_bytes<0 and errno==EINTR) continue;
+    if (num_bytes<=0) {
+      throw Exception(__PRETTY_FUNCTION__, "Cannot send message!", JustWarning, SOCKET_ERROR(errno));
+    }
+    sent += num_bytes;
   }
 }
 
@@ -149,22 +210,30 @@ Socket::FetchMessage(int id) const
 {
   // At first we prepare the buffer to be filled
   char buf[MAX_WORD_LENGTH];
-  memset(buf, 0, MAX_WORD_LENGTH);
   
   if (id<0) id = fSocketId;
- 
-  size_t num_bytes = recv(id, buf, MAX_WORD_LENGTH, 0);
-  if (num_bytes<0) {
-    throw Exception(__PRETTY_FUNCTION__, "Cannot read answer from receiver!", JustWarning, SOCKET_ERROR(errno));
-    //...
-  }
-  else if (num_bytes==0) {
-    std::ostringstream o; o << "Socket " << id << " just got disconnected";
-    throw Exception(__PRETTY_FUNCTION__, o.str(), JustWarning, 11000);
-  }
- 
-  std::string out(buf);
-  return Message(out.substr(0, num_bytes));
+
+  std::string payload;
+  uint32_t request_id = 0;
+  uint64_t sequence = 0;
+  while (!fInput.Next(&payload, &request_id, &sequence)) {
+    const ssize_t num_bytes = recv(id, buf, MAX_WORD_LENGTH, 0);
+    if (num_bytes<0) {
+      if (errno==EINTR) continue;
+      throw Exception(__PRETTY_FUNCTION__, "Cannot read answer from receiver!", JustWarning, SOCKET_ERROR(errno));
+    }
+    else if (num_bytes==0) {
+      std::ostringstream o; o << "Socket " << id << " just got disconnected";
+      throw Exception(__PRETTY_FUNCTION__, o.str(), JustWarning, 11000);
+    }
+    fInput.Append(buf, num_bytes);
+    // a peer without framing sends one message per packet
+    if (!fInput.HasMessage() and fInput.FlushLegacy(&payload)) break;
+  }
+  Message message(payload);
+  message.SetRequestId(request_id);
+  message.SetSequence(sequence);
+  return message;
 }
 
 void
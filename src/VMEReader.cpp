@@ -346,6 +346,18 @@ VMEReader::SendOutputFile(uint32_t tdc_address) const
   }
 }
 
+void
+VMEReader::SendLiveOutputFile(uint32_t tdc_address) const
+{
+  if (!fOnSocket) return;
+  OutputFiles::const_iterator it = fOutputFiles.find(tdc_address);
+  if (it!=fOutputFiles.end()) {
+    std::ostringstream os;
+    os << tdc_address << ":" << it->second;
+    Client::Send(SocketMessage(SET_LIVE_FILENAME, os.str()));
+  }
+}
+
 void
 VMEReader::BroadcastNewBurst(unsigned int burst_id) const
 {
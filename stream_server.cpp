@@ -0,0 +1,40 @@
+#include "EventStreamer.h"
+
+#include <iostream>
+#include <signal.h>
+
+using namespace std;
+
+EventStreamer* s = 0;
+int gEnd = 0;
+
+void CtrlC(int aSig) {
+  if (gEnd==0) {
+    cout << endl << "[C-c] Trying a clean exit!" << endl;
+    if (s) { cout << "Trying to disconnect the stream consumers" << endl; delete s; }
+    exit(0);
+  }
+  else if (gEnd>=5) {
+    cout << endl << "[C-c > 5 times] ... Forcing exit!" << endl;
+    exit(0);
+  }
+  gEnd++;
+}
+
+int main(int argc, char* argv[])
+{
+  signal(SIGINT, CtrlC);
+
+  const int port = (argc>1) ? atoi(argv[1]) : STREAM_PORT;
+  s = new EventStreamer(port);
+  if (!s->Connect()) {
+    cout << "Failed to start the event streamer!" << endl;
+    return -1;
+  }
+  while (true) {
+    try { s->Process(); } catch (Exception& e) { e.Dump(); }
+  }
+
+  delete s;
+  return 0;
+}
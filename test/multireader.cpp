@@ -42,10 +42,16 @@ int main(int argc, char* argv[]) {
   cqu[kLeadingTime] = new DQM::QuarticCanvas("multiread_quartic_mean_leading_time", "Mean leading time (ns)");
   //cqu[kNumEvents] = new DQM::QuarticCanvas("multiread_quartic_num_events_per_channel", "Number of events per channel");
 
+  // next files are read in the background while the current one is decoded
+  FilePrefetcher prefetcher;
+  for (vector<string>::iterator f=files.begin(); f!=files.end(); f++) prefetcher.AddFile(*f);
+  prefetcher.Start();
+
   VME::TDCMeasurement m;
-  for (vector<string>::iterator f=files.begin(); f!=files.end(); f++) {
+  FileReader fr;
+  while (true) {
     try {
-      FileReader fr(*f);
+      if (!fr.Open(prefetcher)) break;
       cout << "Opening file with burst train " << fr.GetBurstId() << endl;
       h_num_words->Fill(fr.GetNumEvents());
       for (unsigned int ch=0; ch<32; ch++) {
@@ -0,0 +1,100 @@
+#include "EventStreamer.h"
+
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+
+/// Number of blocks the consumer is ready to receive at any time
+#define CONSUMER_WINDOW 16
+
+bool Send(int sid, const SocketMessage& m) {
+  const string frame = MessageFramer::Encode(m.GetString());
+  return (send(sid, frame.data(), frame.size(), MSG_NOSIGNAL)==(ssize_t)frame.size());
+}
+
+int main(int argc, char* argv[]) {
+  if (argc<2) {
+    cerr << "Usage: " << argv[0] << " <streamer host> [port] [prescaling factor] [comma-separated board addresses] [processing time per block (ms)]" << endl;
+    return -1;
+  }
+  const int port = (argc>2) ? atoi(argv[2]) : STREAM_PORT;
+  const int prescale = (argc>3) ? atoi(argv[3]) : 1;
+  const string boards = (argc>4) ? argv[4] : "";
+  const unsigned int delay_ms = (argc>5) ? atoi(argv[5]) : 0;
+
+  struct hostent* host = gethostbyname(argv[1]);
+  if (!host) { cerr << "Unknown host " << argv[1] << endl; return -1; }
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  memcpy(&address.sin_addr, host->h_addr, host->h_length);
+  const int sid = socket(AF_INET, SOCK_STREAM, 0);
+  if (sid<0 or connect(sid, (struct sockaddr*)&address, sizeof(address))<0) {
+    cerr << "Failed to connect to the streamer at " << argv[1] << ":" << port << endl;
+    return -1;
+  }
+
+  ostringstream subscription; subscription << prescale;
+  if (!boards.empty()) subscription << ":" << boards;
+  if (!Send(sid, SocketMessage(STREAM_SUBSCRIBE, subscription.str()))
+   or !Send(sid, SocketMessage(STREAM_CREDIT, CONSUMER_WINDOW))) {
+    cerr << "Failed to subscribe to the stream" << endl;
+    return -1;
+  }
+
+  MessageFramer input;
+  char buffer[65536];
+  string payload;
+  uint64_t expected_sequence = 0, num_blocks = 0, num_events = 0, num_words = 0, num_dropped = 0, num_lost = 0;
+  unsigned int num_broken = 0;
+  struct timeval last, now;
+  gettimeofday(&last, 0);
+  while (true) {
+    const ssize_t num_bytes = recv(sid, buffer, sizeof(buffer), 0);
+    if (num_bytes<=0) { cout << "Streamer disconnected" << endl; break; }
+    input.Append(buffer, num_bytes);
+    try {
+      while (input.Next(&payload)) {
+        if (payload.size()<sizeof(stream_block_t)) { cerr << "Truncated block received!" << endl; return -1; }
+        stream_block_t block;
+        memcpy(&block, payload.data(), sizeof(stream_block_t));
+        if (block.magic!=STREAM_MAGIC or payload.size()!=sizeof(stream_block_t)+block.num_words*sizeof(uint32_t)) {
+          cerr << "Invalid block received!" << endl;
+          return -1;
+        }
+        if (block.sequence!=expected_sequence) cerr << "Block " << block.sequence << " received instead of " << expected_sequence << "!" << endl;
+        expected_sequence = block.sequence+1;
+        const uint32_t* words = reinterpret_cast<const uint32_t*>(payload.data()+sizeof(stream_block_t));
+        // in trigger matching mode, each block holds complete events only
+        if (block.acq_mode==VME::TRIG_MATCH and block.num_words>0
+         and (VME::TDCEvent(words[0]).GetType()!=VME::TDCEvent::GlobalHeader
+           or VME::TDCEvent(words[block.num_words-1]).GetType()!=VME::TDCEvent::GlobalTrailer)) num_broken++;
+        num_blocks++;
+        num_events += block.num_events;
+        num_words += block.num_words;
+        num_dropped = block.num_dropped;
+        num_lost = block.num_lost_words;
+        if (delay_ms>0) usleep(delay_ms*1000);
+        // the block is processed, the streamer may send another one
+        if (!Send(sid, SocketMessage(STREAM_CREDIT, 1))) { cerr << "Failed to send the credits" << endl; return -1; }
+      }
+    } catch (Exception& e) { e.Dump(); return -1; }
+    gettimeofday(&now, 0);
+    if (now.tv_sec>last.tv_sec) {
+      cout << num_blocks << " blocks, " << num_events << " events, " << num_words << " words received ; "
+           << num_dropped << " events dropped, " << num_lost << " words lost by the streamer, "
+           << num_broken << " incomplete blocks" << endl;
+      last = now;
+    }
+  }
+  close(sid);
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "FileReader.h"
+#include "BurstSummary.h"
+#include "OnlineDBHandler.h"
+#include "PPSCanvas.h"
+
+#include "TGraph.h"
+#include "TH2.h"
+
+#include <dirent.h>
+#include <set>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+  if (argc<3) { cerr << "Usage: " << argv[0] << " <board id> <run id>" << endl; exit(0); }
+  const unsigned int num_channels = SUMMARY_NUM_CHANNELS;
+  int board_id = atoi(argv[1]);
+  int run_id = atoi(argv[2]);
+
+  // the output files of a run are indexed by the rank of their board's address
+  uint32_t board_address = 0;
+  try {
+    set<unsigned long> addresses;
+    OnlineDBHandler::TDCConditionsCollection cc = OnlineDBHandler().GetTDCConditions(run_id);
+    for (OnlineDBHandler::TDCConditionsCollection::const_iterator c=cc.begin(); c!=cc.end(); c++) addresses.insert(c->tdc_address);
+    set<unsigned long>::const_iterator addr = addresses.begin();
+    for (int i=0; i<board_id and addr!=addresses.end(); i++) addr++;
+    if (addr!=addresses.end()) board_address = *addr;
+  } catch (Exception& e) { e.Dump(); }
+  if (board_address==0) cerr << "Address of board " << board_id << " not found in the conditions of run " << run_id << endl;
+
+  ostringstream search1, search2, file;
+  search2 << "_board" << board_id << ".dat";
+  DIR* dir; struct dirent* ent;
+  cout << "Search in directory: " << getenv("PPS_DATA_PATH") << endl;
+
+  vector<burst_summary_t> summaries;
+  unsigned int num_built = 0;
+  for (int sp=1; sp<10000000; sp++) { // we loop over all spills
+    search1.str(""); search1 << "events_" << run_id << "_" << sp << "_";
+    bool file_found = false; string filename;
+    if ((dir=opendir(getenv("PPS_DATA_PATH")))==NULL) return -1;
+    while ((ent=readdir(dir))!=NULL) {
+      const string name(ent->d_name);
+      if (name.find(search1.str())!=string::npos and name.find(search2.str())!=string::npos
+       and name.find(SUMMARY_EXTENSION)==string::npos) {
+        file_found = true;
+        filename = name;
+        break;
+      }
+    }
+    closedir(dir);
+    if (!file_found) {
+      cout << "Found " << (sp-1) << " files in this run" << endl;
+      break;
+    }
+    file.str(""); file << getenv("PPS_DATA_PATH") << "/" << filename;
+    BurstSummary summary;
+    if (!summary.Read(file.str())) {
+      // no summary stored for this burst ; we build it once from the raw data
+      try {
+        FileReader f(file.str());
+        summary.Reset(f.GetHeader(), board_address);
+        VME::TDCEvent e;
+        while (f.GetNextEvent(&e)) summary.Add(e);
+        summary.Write(file.str());
+        num_built++;
+      } catch (Exception& e) { e.Dump(); continue; }
+    }
+    summaries.push_back(summary.Get());
+  }
+  if (summaries.size()==0) return 0;
+  cout << "Summaries built for " << num_built << " burst(s)" << endl;
+
+  const unsigned int num_bursts = summaries.size();
+  TGraph* triggers = new TGraph, *errors = new TGraph;
+  TH2D* hits = new TH2D("hits", "", num_bursts, 0.5, num_bursts+0.5, num_channels, -0.5, num_channels-0.5);
+  unsigned int i = 0;
+  for (vector<burst_summary_t>::const_iterator s=summaries.begin(); s!=summaries.end(); s++, i++) {
+    triggers->SetPoint(i, s->spill_id, s->num_triggers);
+    errors->SetPoint(i, s->spill_id, s->num_errors);
+    if (s->num_triggers==0) continue;
+    for (unsigned int ch=0; ch<num_channels; ch++) {
+      hits->Fill(i+1, ch, (double)s->num_hits[ch]/s->num_triggers);
+    }
+  }
+
+  DQM::PPSCanvas c_trig(Form("triggers_vs_burst_run%d_board%d", run_id, board_id), "Triggers / burst");
+  c_trig.Grid()->cd();
+  triggers->SetMarkerStyle(20);
+  triggers->Draw("alp");
+  triggers->GetXaxis()->SetTitle("Burst id");
+  triggers->GetYaxis()->SetTitle("Triggers");
+  c_trig.SetRunInfo(run_id, Form("%d bursts", num_bursts));
+  c_trig.Save("png");
+
+  DQM::PPSCanvas c_err(Form("errors_vs_burst_run%d_board%d", run_id, board_id), "TDC errors / burst");
+  c_err.Grid()->cd();
+  errors->SetMarkerStyle(20);
+  errors->Draw("alp");
+  errors->GetXaxis()->SetTitle("Burst id");
+  errors->GetYaxis()->SetTitle("Errors");
+  c_err.SetRunInfo(run_id, Form("%d bursts", num_bursts));
+  c_err.Save("png");
+
+  DQM::PPSCanvas c_hits(Form("hits_vs_burst_run%d_board%d", run_id, board_id), "Hits / trigger");
+  c_hits.Grid()->cd();
+  hits->Draw("colz");
+  hits->GetXaxis()->SetTitle("Burst");
+  hits->GetYaxis()->SetTitle("Channel id");
+  c_hits.SetRunInfo(run_id, Form("%d bursts", num_bursts));
+  c_hits.Save("png");
+
+  return 0;
+}
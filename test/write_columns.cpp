@@ -0,0 +1,77 @@
+#include "FileReader.h"
+#include "ColumnarFile.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+/// Columns stored for each hit
+enum { kTrigger, kEventCount, kChannel, kLeadingTime, kToT, kNumColumns };
+
+int main(int argc, char* argv[]) {
+  if (argc<2) {
+    cerr << "Usage: " << argv[0] << " <input raw file> [output columnar file] [board address]" << endl;
+    return -1;
+  }
+
+  string output = "output.col";
+  if (argc>2) output = argv[2];
+  uint32_t board_address = (argc>3) ? strtoul(argv[3], NULL, 0) : 0;
+
+  ColumnarWriter writer;
+  writer.AddColumn("trigger");
+  writer.AddColumn("event_count");
+  writer.AddColumn("channel_id");
+  writer.AddColumn("leading_time");
+  writer.AddColumn("tot");
+
+  try {
+    FileReader fr(argv[1]);
+    cout << "Opening file with burst train " << fr.GetBurstId() << endl;
+    const bool trigger_matching = (fr.GetAcquisitionMode()==VME::TRIG_MATCH);
+    writer.SetRunInfo(fr.GetRunId(), fr.GetBurstId(), board_address, fr.GetAcquisitionMode(), 25./1.e3);
+    writer.Open(output);
+
+    // hits are written as soon as their trailing edge is decoded ; triggers are
+    // numbered from 1 (0 for the hits recorded before the first trigger word)
+    uint32_t row[kNumColumns], leading[32];
+    bool has_leading[32];
+    for (unsigned int i=0; i<32; i++) { leading[i] = 0; has_leading[i] = false; }
+    row[kTrigger] = row[kEventCount] = 0;
+    unsigned int num_triggers = 0;
+    VME::TDCEvent e;
+    while (fr.GetNextEvent(&e)) {
+      switch (e.GetType()) {
+        case VME::TDCEvent::GlobalHeader:
+          if (trigger_matching) row[kTrigger] = ++num_triggers;
+          row[kEventCount] = e.GetEventCount();
+          for (unsigned int i=0; i<32; i++) has_leading[i] = false;
+          break;
+        case VME::TDCEvent::Trigger:
+          if (!trigger_matching) row[kTrigger] = ++num_triggers;
+          break;
+        case VME::TDCEvent::TDCMeasurement: {
+          const unsigned int ch = e.GetChannelId();
+          if (ch>=32) break;
+          if (!e.IsTrailing()) { leading[ch] = e.GetTime(); has_leading[ch] = true; break; }
+          if (!has_leading[ch]) break;
+          row[kChannel] = ch;
+          row[kLeadingTime] = leading[ch];
+          row[kToT] = (e.GetTime()-leading[ch])&0x7FFFF;
+          writer.Fill(row);
+          has_leading[ch] = false;
+        } break;
+        default: break;
+      }
+    }
+    writer.Close();
+    cout << "Wrote " << writer.GetNumRows() << " hits in " << writer.GetNumChunks() << " chunk(s) for "
+         << num_triggers << " triggers" << endl;
+  } catch (Exception& e) {
+    e.Dump();
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,251 @@
+#include "FileReader.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TFileMerger.h"
+#include "RVersion.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+#include "TROOT.h"
+#else
+#include "TThread.h"
+#endif
+
+#define MAX_MEAS 10000
+/// Size of the branches buffers (in bytes)
+#define BASKET_SIZE 256000
+/// Amount of data (in bytes) accumulated before the baskets are compressed and written
+#define AUTO_FLUSH_BYTES 32000000
+/// Fast zlib compression (algorithm*100+level)
+#define COMPRESSION_SETTINGS 101
+
+using namespace std;
+
+/**
+ * \brief Spills of the run, converted into one temporary file each
+ */
+struct Job {
+  vector<string> inputs, outputs;
+  vector<char> success;
+  /// Index of the next spill to be converted
+  unsigned int next;
+  /// One entry per trigger instead of one per channel measurement
+  bool per_trigger;
+};
+
+/// Convert all channel measurements of one spill into its own tree (same layout as write_tree)
+bool
+ConvertSpillMeasurements(const string& input, const string& output)
+{
+  unsigned int fNumMeasurements, fNumErrors;
+  unsigned int fRunId;
+  unsigned long fETTT;
+  unsigned int fEventID;
+  unsigned int fChannelId[MAX_MEAS];
+  double fLeadingEdge[MAX_MEAS], fTrailingEdge[MAX_MEAS], fToT[MAX_MEAS];
+
+  FileReader fr;
+  try { fr.Open(input); } catch (Exception& e) { e.Dump(); return false; }
+  fRunId = fr.GetRunId();
+
+  TFile f(output.c_str(), "recreate");
+  f.SetCompressionSettings(COMPRESSION_SETTINGS);
+  TTree* t = new TTree("tdc", "List of TDC measurements");
+  t->Branch("num_measurements", &fNumMeasurements, "num_measurements/i", BASKET_SIZE);
+  t->Branch("num_errors", &fNumErrors, "num_errors/i", BASKET_SIZE);
+  t->Branch("run_id", &fRunId, "run_id/i", BASKET_SIZE);
+  t->Branch("channel_id", fChannelId, "channel_id[num_measurements]/I", BASKET_SIZE);
+  t->Branch("ettt", &fETTT, "ettt/l", BASKET_SIZE);
+  t->Branch("leading_edge", fLeadingEdge, "leading_edge[num_measurements]/D", BASKET_SIZE);
+  t->Branch("trailing_edge", fTrailingEdge, "trailing_edge[num_measurements]/D", BASKET_SIZE);
+  t->Branch("tot", fToT, "tot[num_measurements]/D", BASKET_SIZE);
+  t->Branch("event_id", &fEventID, "event_id/I", BASKET_SIZE);
+  t->SetAutoFlush(-AUTO_FLUSH_BYTES);
+
+  VME::TDCMeasurement m;
+  try {
+    for (unsigned int ch=0; ch<32; ch++) {
+      while (fr.GetNextMeasurement(ch, &m)) {
+        fNumMeasurements = (m.NumEvents()<MAX_MEAS) ? m.NumEvents() : MAX_MEAS;
+        fNumErrors = m.NumErrors();
+        fEventID = m.GetEventId();
+        fETTT = m.GetETTT();
+        for (unsigned int i=0; i<fNumMeasurements; i++) {
+          fLeadingEdge[i] = m.GetLeadingTime(i)*25./1024.;
+          fChannelId[i] = ch;
+          fTrailingEdge[i] = m.GetTrailingTime(i)*25./1024.;
+          fToT[i] = m.GetToT(i)*25./1024.;
+        }
+        t->Fill();
+      }
+      fr.Clear();
+    }
+  } catch (Exception& e) { e.Dump(); return false; }
+  f.cd();
+  t->Write();
+  f.Close();
+  return true;
+}
+
+/// Convert all triggers of one spill into its own tree
+bool
+ConvertSpillTriggers(const string& input, const string& output)
+{
+  int fNumMeasurements, fNumErrors;
+  int fRunId, fBurstId;
+  int fETTT, fTriggerNumber;
+  int fChannelId[MAX_MEAS];
+  double fLeadingEdge[MAX_MEAS], fTrailingEdge[MAX_MEAS], fToT[MAX_MEAS];
+
+  FileReader fr;
+  try { fr.Open(input); } catch (Exception& e) { e.Dump(); return false; }
+  fRunId = fr.GetRunId();
+  fBurstId = fr.GetBurstId();
+
+  TFile f(output.c_str(), "recreate");
+  f.SetCompressionSettings(COMPRESSION_SETTINGS);
+  TTree* t = new TTree("tdc", "List of TDC measurements");
+  t->Branch("num_measurements", &fNumMeasurements, "num_measurements/I", BASKET_SIZE);
+  t->Branch("num_errors", &fNumErrors, "num_errors/I", BASKET_SIZE);
+  t->Branch("run_id", &fRunId, "run_id/I", BASKET_SIZE);
+  t->Branch("burst_id", &fBurstId, "burst_id/I", BASKET_SIZE);
+  t->Branch("channel_id", fChannelId, "channel_id[num_measurements]/I", BASKET_SIZE);
+  t->Branch("leading_edge", fLeadingEdge, "leading_edge[num_measurements]/D", BASKET_SIZE);
+  t->Branch("trailing_edge", fTrailingEdge, "trailing_edge[num_measurements]/D", BASKET_SIZE);
+  t->Branch("tot", fToT, "tot[num_measurements]/D", BASKET_SIZE);
+  t->Branch("ettt", &fETTT, "ettt/I", BASKET_SIZE);
+  t->Branch("trigger_number", &fTriggerNumber, "trigger_number/I", BASKET_SIZE);
+  t->SetAutoFlush(-AUTO_FLUSH_BYTES);
+
+  const unsigned int num_channels = 32;
+  double leading[num_channels];
+  bool has_leading[num_channels];
+  for (unsigned int i=0; i<num_channels; i++) { leading[i] = 0.; has_leading[i] = false; }
+  fNumMeasurements = fNumErrors = fETTT = fTriggerNumber = 0;
+  VME::TDCEvent e;
+  while (fr.GetNextEvent(&e)) {
+    switch (e.GetType()) {
+      case VME::TDCEvent::GlobalHeader:
+        for (unsigned int i=0; i<num_channels; i++) has_leading[i] = false;
+        fNumMeasurements = fNumErrors = fETTT = 0;
+        fTriggerNumber++;
+        break;
+      case VME::TDCEvent::TDCMeasurement: {
+        const unsigned int ch_id = e.GetChannelId();
+        if (ch_id>=num_channels) break;
+        if (!e.IsTrailing()) { leading[ch_id] = e.GetTime()*25./1024.; has_leading[ch_id] = true; break; }
+        // a leading edge at time 0 is a valid one
+        if (!has_leading[ch_id] or fNumMeasurements>=MAX_MEAS) break;
+        fChannelId[fNumMeasurements] = ch_id;
+        fLeadingEdge[fNumMeasurements] = leading[ch_id];
+        fTrailingEdge[fNumMeasurements] = e.GetTime()*25./1024.;
+        fToT[fNumMeasurements] = fTrailingEdge[fNumMeasurements]-fLeadingEdge[fNumMeasurements];
+        fNumMeasurements++;
+        has_leading[ch_id] = false;
+      } break;
+      case VME::TDCEvent::TDCError: fNumErrors++; break;
+      case VME::TDCEvent::ETTT: fETTT = e.GetETTT()<<5; break;
+      case VME::TDCEvent::GlobalTrailer:
+        fETTT += e.GetGeo();
+        t->Fill();
+        break;
+      default: break;
+    }
+  }
+  f.cd();
+  t->Write();
+  f.Close();
+  return true;
+}
+
+void*
+Worker(void* arg)
+{
+  Job* job = static_cast<Job*>(arg);
+  while (true) {
+    const unsigned int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_SEQ_CST);
+    if (i>=job->inputs.size()) break;
+    cout << "Converting spill " << (i+1) << "/" << job->inputs.size() << ": " << job->inputs[i] << endl;
+    job->success[i] = (job->per_trigger) ? ConvertSpillTriggers(job->inputs[i], job->outputs[i]) : ConvertSpillMeasurements(job->inputs[i], job->outputs[i]);
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  // the per-trigger layout is only produced on demand
+  bool per_trigger = false;
+  vector<string> args;
+  for (int i=1; i<argc; i++) {
+    if (string(argv[i])=="--per-trigger") per_trigger = true;
+    else args.push_back(argv[i]);
+  }
+  if (args.size()<2) { cerr << "Usage: " << argv[0] << " [--per-trigger] <board id> <run id> [output root file] [number of threads]" << endl; exit(0); }
+  int board_id = atoi(args[0].c_str());
+  int run_id = atoi(args[1].c_str());
+  ostringstream default_output; default_output << "run" << run_id << "_board" << board_id << ".root";
+  string output = (args.size()>2) ? args[2] : default_output.str();
+  unsigned int num_threads = (args.size()>3) ? atoi(args[3].c_str()) : sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_threads<1) num_threads = 1;
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+  ROOT::EnableThreadSafety();
+#else
+  TThread::Initialize();
+#endif
+
+  // first we search for all the files of this run, in spill order
+  Job job;
+  job.next = 0;
+  job.per_trigger = per_trigger;
+  ostringstream search1, search2, file;
+  search2 << "_board" << board_id << ".dat";
+  DIR* dir; struct dirent* ent;
+  cout << "Search in directory: " << getenv("PPS_DATA_PATH") << endl;
+  for (int sp=1; sp<10000000; sp++) { // we loop over all spills
+    search1.str(""); search1 << "events_" << run_id << "_" << sp << "_";
+    bool file_found = false; string filename;
+    if ((dir=opendir(getenv("PPS_DATA_PATH")))==NULL) return -1;
+    while ((ent=readdir(dir))!=NULL) {
+      const string name(ent->d_name);
+      if (name.find(search1.str())!=string::npos and name.size()>search2.str().size() and name.compare(name.size()-search2.str().size(), string::npos, search2.str())==0) {
+        file_found = true;
+        filename = name;
+        break;
+      }
+    }
+    closedir(dir);
+    if (!file_found) break;
+    file.str(""); file << getenv("PPS_DATA_PATH") << "/" << filename;
+    job.inputs.push_back(file.str());
+    file.str(""); file << output << ".spill" << sp << ".tmp";
+    job.outputs.push_back(file.str());
+  }
+  cout << "Found " << job.inputs.size() << " files in this run" << endl;
+  if (job.inputs.size()==0) return 0;
+  job.success.assign(job.inputs.size(), false);
+
+  // then the spills are converted in parallel
+  if (num_threads>job.inputs.size()) num_threads = job.inputs.size();
+  vector<pthread_t> threads(num_threads);
+  for (unsigned int i=0; i<num_threads; i++) pthread_create(&threads[i], NULL, Worker, &job);
+  for (unsigned int i=0; i<num_threads; i++) pthread_join(threads[i], NULL);
+
+  // finally the trees are merged following the spills order, to keep the triggers ordering
+  // (baskets are copied without being recompressed)
+  TFileMerger merger(kFALSE);
+  merger.OutputFile(output.c_str(), "recreate", COMPRESSION_SETTINGS);
+  unsigned int num_merged = 0;
+  for (unsigned int i=0; i<job.inputs.size(); i++) {
+    if (!job.success[i]) { cerr << "Spill " << (i+1) << " could not be converted!" << endl; continue; }
+    merger.AddFile(job.outputs[i].c_str(), kFALSE);
+    num_merged++;
+  }
+  const bool merged = (num_merged>0 and merger.Merge());
+  for (unsigned int i=0; i<job.outputs.size(); i++) unlink(job.outputs[i].c_str());
+  if (!merged) { cerr << "Failed to merge the converted spills!" << endl; return -1; }
+  cout << "Merged " << num_merged << " spills into " << output << endl;
+
+  return 0;
+}
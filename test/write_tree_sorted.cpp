@@ -47,10 +47,11 @@ int main(int argc, char* argv[]) {
   int num_triggers = 0, num_channel_measurements[num_channels];
   double has_leading_per_trigger[num_channels];
 
+  // first we search for all the files of this run
+  FilePrefetcher prefetcher;
   for (int sp=1; sp<10000000; sp++) { // we loop over all spills
     search1.str(""); search1 << "events_" << run_id << "_" << sp << "_";
     bool file_found = false; string filename;
-    // first we search for the proper file to open
     if ((dir=opendir(getenv("PPS_DATA_PATH")))==NULL) return -1;
     while ((ent=readdir(dir))!=NULL) {
       if (string(ent->d_name).find(search1.str())!=string::npos and 
@@ -65,18 +66,23 @@ int main(int argc, char* argv[]) {
       cout << "Found " << sp << " files in this run" << endl;
       break;
     }
+    file.str(""); file << getenv("PPS_DATA_PATH") << "/" << filename;
+    prefetcher.AddFile(file.str());
+  }
+  // next files are read in the background while the current one is decoded
+  prefetcher.Start();
 
+  FileReader fr;
+  while (true) {
     for (unsigned int i=0; i<num_channels; i++) {
       num_channel_measurements[i] = 0;
       has_leading_per_trigger[i] = 0;
     }
-    // then we open it
-    file.str(""); file << getenv("PPS_DATA_PATH") << "/" << filename;
-    cout << "Opening file " << file.str() << endl;
     try {
-      FileReader f(file.str());
+      if (!fr.Open(prefetcher)) break;
+      cout << "Opening file with burst train " << fr.GetBurstId() << endl;
       while (true) {
-        if (!f.GetNextEvent(&e)) break;
+        if (!fr.GetNextEvent(&e)) break;
         if (e.GetType()==VME::TDCEvent::GlobalHeader) {
           for (unsigned int i=0; i<num_channels; i++) {
             num_channel_measurements[i] = 0;